@@ -0,0 +1,81 @@
+// Copyright (c) 2016 ucclkp <ucclkp@gmail.com>.
+// This file is part of utils project.
+//
+// This program is licensed under GPLv3 license that can be
+// found in the LICENSE file.
+
+#include "bench_collector.h"
+
+#include <cmath>
+#include <cstdio>
+
+
+namespace utl {
+namespace bench {
+
+    // static
+    BenchCollector* BenchCollector::getInstance() {
+        static BenchCollector collector;
+        return &collector;
+    }
+
+    void BenchCollector::add(const std::string& name, const Func& func) {
+        benches_.push_back({ name, func });
+    }
+
+    void BenchCollector::run(const std::string& filter) {
+        for (auto& b : benches_) {
+            if (!filter.empty() && b.name.find(filter) == std::string::npos) {
+                continue;
+            }
+
+            std::printf("Bench: %s\n", b.name.c_str());
+            cur_bench_ = b.name;
+            b.func();
+            cur_bench_.clear();
+            std::printf("\n");
+        }
+    }
+
+    void BenchCollector::report(const std::string& metric, double value, const std::string& unit) {
+        std::printf("  %-40s %12.2f %s\n", metric.c_str(), value, unit.c_str());
+        results_.push_back({ cur_bench_, metric, value, unit });
+    }
+
+    void BenchCollector::note(const std::string& text) {
+        std::printf("  %s\n", text.c_str());
+        notes_.push_back({ cur_bench_, text });
+    }
+
+    void BenchCollector::writeJSON(std::ostream& s) const {
+        // 名称均由基准测试自己给出，不含需要转义的字符。
+        s << "{\"results\":[";
+        for (size_t i = 0; i < results_.size(); ++i) {
+            const auto& r = results_[i];
+
+            char value[32];
+            if (std::isfinite(r.value)) {
+                std::snprintf(value, sizeof(value), "%.6g", r.value);
+            } else {
+                std::snprintf(value, sizeof(value), "null");
+            }
+
+            s << (i == 0 ? "\n" : ",\n")
+              << "{\"bench\":\"" << r.bench
+              << "\",\"metric\":\"" << r.metric
+              << "\",\"value\":" << value
+              << ",\"unit\":\"" << r.unit << "\"}";
+        }
+
+        s << "\n],\"notes\":[";
+        for (size_t i = 0; i < notes_.size(); ++i) {
+            const auto& n = notes_[i];
+            s << (i == 0 ? "\n" : ",\n")
+              << "{\"bench\":\"" << n.bench
+              << "\",\"text\":\"" << n.text << "\"}";
+        }
+        s << "\n]}\n";
+    }
+
+}
+}
@@ -0,0 +1,145 @@
+// Copyright (c) 2016 ucclkp <ucclkp@gmail.com>.
+// This file is part of utils project.
+//
+// This program is licensed under GPLv3 license that can be
+// found in the LICENSE file.
+
+#ifndef UTILS_BENCH_BENCH_COLLECTOR_H_
+#define UTILS_BENCH_BENCH_COLLECTOR_H_
+
+#include <chrono>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "utils/define_utils.hpp"
+
+#define BENCH_CASE(name)  \
+    static void name();  \
+    static utl::bench::BenchRegistrar ANONYMOUS_VAR(name##_reg)(#name, &name);  \
+    static void name()
+
+#define RUN_BENCHES(filter)  utl::bench::BenchCollector::getInstance()->run(filter);
+
+
+namespace utl {
+namespace bench {
+
+    class BenchCollector {
+    public:
+        using Func = std::function<void()>;
+
+        static BenchCollector* getInstance();
+
+        void add(const std::string& name, const Func& func);
+
+        /**
+         * 运行名称中包含 filter 的所有基准测试。filter 为空时运行全部。
+         */
+        void run(const std::string& filter);
+
+        /**
+         * 记录正在运行的基准测试的一项结果，同时打印到控制台。
+         * @param metric 结果的名称，例如 "post.single"。
+         * @param unit 单位，例如 "ns/op"。
+         */
+        void report(const std::string& metric, double value, const std::string& unit);
+
+        /**
+         * 记录正在运行的基准测试的一条说明，例如跳过了哪一项，同时打印到控制台。
+         */
+        void note(const std::string& text);
+
+        /**
+         * 以 JSON 格式输出所有已记录的结果和说明，便于跟踪性能的变化：
+         * {"results":[{"bench":..., "metric":..., "value":..., "unit":...}, ...],
+         *  "notes":[{"bench":..., "text":...}, ...]}
+         */
+        void writeJSON(std::ostream& s) const;
+
+    private:
+        struct Bench {
+            std::string name;
+            Func func;
+        };
+
+        struct Result {
+            std::string bench;
+            std::string metric;
+            double value;
+            std::string unit;
+        };
+
+        struct Note {
+            std::string bench;
+            std::string text;
+        };
+
+        std::vector<Bench> benches_;
+        std::vector<Result> results_;
+        std::vector<Note> notes_;
+        std::string cur_bench_;
+    };
+
+    inline void report(const std::string& metric, double value, const std::string& unit) {
+        BenchCollector::getInstance()->report(metric, value, unit);
+    }
+
+    inline void note(const std::string& text) {
+        BenchCollector::getInstance()->note(text);
+    }
+
+    class BenchRegistrar {
+    public:
+        BenchRegistrar(const char* name, void (*func)()) {
+            BenchCollector::getInstance()->add(name, func);
+        }
+    };
+
+    /**
+     * 计时器，从构造时开始计时。
+     */
+    class Stopwatch {
+    public:
+        using clock = std::chrono::steady_clock;
+
+        Stopwatch()
+            : start_(clock::now()) {}
+
+        void restart() {
+            start_ = clock::now();
+        }
+
+        double elapsedNs() const {
+            return double(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                clock::now() - start_).count());
+        }
+
+    private:
+        clock::time_point start_;
+    };
+
+    /**
+     * 防止编译器将基准测试中未被使用的结果优化掉。
+     * 编译器必须先算出 val，且不能把前后的内存访问移过此处。
+     */
+    template <typename Ty>
+    void doNotOptimize(const Ty& val) {
+#ifdef _MSC_VER
+        static volatile char sink;
+        sink = *reinterpret_cast<const volatile char*>(&val);
+        _ReadWriteBarrier();
+#else
+        asm volatile("" : : "r,m"(val) : "memory");
+#endif
+    }
+
+}
+}
+
+#endif  // UTILS_BENCH_BENCH_COLLECTOR_H_
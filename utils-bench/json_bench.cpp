@@ -0,0 +1,67 @@
+// Copyright (c) 2016 ucclkp <ucclkp@gmail.com>.
+// This file is part of utils project.
+//
+// This program is licensed under GPLv3 license that can be
+// found in the LICENSE file.
+
+#include <sstream>
+#include <string>
+
+#include "utils/json/json_parser.h"
+
+#include "bench_collector.h"
+
+
+namespace {
+
+    // 生成约 size 字节的文档，包含常见的各类值，少量字符串带有转义。
+    std::string makeDocument(size_t size) {
+        std::string doc = "[";
+        for (size_t i = 0; doc.size() < size; ++i) {
+            auto n = std::to_string(i);
+            if (i > 0) {
+                doc.append(",\n");
+            }
+            doc.append("  {\"id\": ").append(n)
+                .append(", \"name\": \"item-").append(n)
+                .append("\", \"score\": ").append(n).append(".25")
+                .append(", \"active\": true, \"parent\": null")
+                .append(", \"tags\": [\"alpha\", \"beta\", \"gamma\"]")
+                .append(", \"note\": \"");
+            if (i % 8 == 0) {
+                doc.append("line\\nbreak \\u00e9\\u4e2d");
+            } else {
+                doc.append("plain text without escapes");
+            }
+            doc.append("\"}");
+        }
+        doc.append("]");
+        return doc;
+    }
+
+}
+
+BENCH_CASE(JSONParserBench) {
+    constexpr int kRounds = 5;
+
+    auto doc = makeDocument(4 * 1024 * 1024);
+    double mb = double(doc.size()) / (1024 * 1024);
+
+    utl::JSONParser parser;
+    utl::JSONParser::ValuePtr value;
+
+    bool ok = true;
+    utl::bench::Stopwatch sw;
+    for (int i = 0; i < kRounds; ++i) {
+        std::istringstream iss(doc, std::ios::binary);
+        ok &= parser.parse(iss, &value);
+    }
+    utl::bench::report("json.parse.istream", mb * kRounds / (sw.elapsedNs() / 1e9), "MB/s");
+
+    sw.restart();
+    for (int i = 0; i < kRounds; ++i) {
+        ok &= parser.parse(doc, &value);
+    }
+    utl::bench::report("json.parse.buffer", mb * kRounds / (sw.elapsedNs() / 1e9), "MB/s");
+    utl::bench::doNotOptimize(ok);
+}
@@ -0,0 +1,43 @@
+// Copyright (c) 2016 ucclkp <ucclkp@gmail.com>.
+// This file is part of utils project.
+//
+// This program is licensed under GPLv3 license that can be
+// found in the LICENSE file.
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+#include "utils/assuming.hpp"
+
+#include "bench_collector.h"
+
+
+// 用法：utils-bench [filter] [--json=<file>]
+int main(int argc, char* argv[]) {
+    utl::assuming();
+
+    std::string filter;
+    std::string json_path;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--json=", 7) == 0) {
+            json_path = argv[i] + 7;
+        } else {
+            filter = argv[i];
+        }
+    }
+
+    RUN_BENCHES(filter);
+
+    if (!json_path.empty()) {
+        std::ofstream file(json_path, std::ios::out | std::ios::trunc);
+        if (!file) {
+            std::fprintf(stderr, "Cannot open %s\n", json_path.c_str());
+            return 1;
+        }
+        utl::bench::BenchCollector::getInstance()->writeJSON(file);
+    }
+
+    return 0;
+}
@@ -0,0 +1,391 @@
+// Copyright (c) 2016 ucclkp <ucclkp@gmail.com>.
+// This file is part of utils project.
+//
+// This program is licensed under GPLv3 license that can be
+// found in the LICENSE file.
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <future>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "utils/message/channel.hpp"
+#include "utils/message/cycler.h"
+#include "utils/message/message.h"
+#include "utils/message/message_pump.h"
+#include "utils/message/message_queue.h"
+#include "utils/message/pump_thread.h"
+
+#include "bench_collector.h"
+
+
+namespace {
+
+    using namespace std::chrono_literals;
+
+    /**
+     * 运行在独立线程中的泵，以及向其投递消息的 Cycler。
+     */
+    class BenchPump {
+    public:
+        explicit BenchPump(const utl::ThreadOptions& options = utl::ThreadOptions())
+            : thread_(options),
+              cycler_(thread_.getPump()) {}
+
+        utl::Cycler* cycler() { return &cycler_; }
+
+    private:
+        utl::PumpThread thread_;
+        utl::Cycler cycler_;
+    };
+
+    std::string withArg(const char* metric, size_t arg) {
+        return std::string(metric) + "." + std::to_string(arg);
+    }
+
+    // 在 threads 个线程中同时执行 func(i)，返回总耗时。
+    double runConcurrently(size_t threads, const std::function<void(size_t)>& func) {
+        std::atomic<size_t> ready(0);
+        std::atomic<bool> go(false);
+        std::vector<std::thread> workers;
+        for (size_t i = 0; i < threads; ++i) {
+            workers.emplace_back([&, i]() {
+                ready.fetch_add(1);
+                while (!go.load(std::memory_order_acquire)) {}
+                func(i);
+            });
+        }
+        while (ready.load() != threads) {}
+
+        utl::bench::Stopwatch sw;
+        go.store(true, std::memory_order_release);
+        for (auto& t : workers) {
+            t.join();
+        }
+        return sw.elapsedNs();
+    }
+
+    // 从 producers 个线程向泵投递共 total 个消息，等待全部执行完毕，返回每个消息的平均耗时。
+    // batch_size 为 0 时逐个调用 Cycler::post()，否则通过 PostBatch 投递。
+    double benchPost(size_t producers, size_t batch_size, size_t total) {
+        BenchPump pump;
+        auto cycler = pump.cycler();
+
+        size_t count = 0;
+        std::promise<void> done;
+        auto task = [&count, &done, total]() {
+            if (++count == total) {
+                done.set_value();
+            }
+        };
+
+        auto per_thread = total / producers;
+        double elapsed = runConcurrently(producers, [&](size_t) {
+            if (batch_size == 0) {
+                for (size_t i = 0; i < per_thread; ++i) {
+                    cycler->post(task);
+                }
+                return;
+            }
+
+            utl::PostBatch batch(cycler);
+            for (size_t i = 0; i < per_thread; ++i) {
+                batch.post(task);
+                if (batch.size() == batch_size) {
+                    batch.commit();
+                }
+            }
+        });
+
+        utl::bench::Stopwatch sw;
+        done.get_future().get();
+        return (elapsed + sw.elapsedNs()) / double(total);
+    }
+
+    // 在两个泵之间来回投递 count 次，返回每次往返的平均耗时。
+    double benchRoundTrip(BenchPump* a, BenchPump* b, size_t count) {
+        std::promise<void> done;
+        std::function<void(size_t)> ping = [&](size_t n) {
+            if (n == count) {
+                done.set_value();
+                return;
+            }
+            b->cycler()->post([&, n]() {
+                a->cycler()->post([&, n]() { ping(n + 1); });
+            });
+        };
+
+        utl::bench::Stopwatch sw;
+        a->cycler()->post([&]() { ping(0); });
+        done.get_future().get();
+        return sw.elapsedNs() / count;
+    }
+
+    utl::Message* makeMessage(uint64_t time_ns) {
+        auto msg = utl::Message::get();
+        msg->func = []() {};
+        msg->time_ns = time_ns;
+        return msg;
+    }
+
+    // 取出并回收队列中所有就绪的消息，不执行。
+    void drainQueue(utl::MessageQueue* q) {
+        while (q->takeBatch() > 0) {
+            utl::Message* done = nullptr;
+            utl::Message* msg;
+            auto cur = uint64_t(utl::Cycler::now().count());
+            int64_t delay_ns;
+            while (q->nextInBatch(cur, &done, &msg)) {}
+            q->finishBatch(done, &delay_ns);
+        }
+    }
+
+    void reportPercentiles(const char* metric, std::vector<double>* samples) {
+        std::sort(samples->begin(), samples->end());
+        const std::pair<const char*, double> kPercentiles[] = {
+            { "p50", 0.5 }, { "p90", 0.9 }, { "p99", 0.99 }, { "p999", 0.999 },
+        };
+        for (const auto& p : kPercentiles) {
+            auto idx = std::min(size_t(p.second * double(samples->size())), samples->size() - 1);
+            utl::bench::report(std::string(metric) + "." + p.first, (*samples)[idx], "ns");
+        }
+    }
+
+}
+
+using utl::Message;
+
+BENCH_CASE(MessagePoolBench) {
+    constexpr size_t kCount = 1 << 20;
+    constexpr size_t kBurst = 256;
+
+    utl::bench::Stopwatch sw;
+    for (size_t i = 0; i < kCount; ++i) {
+        auto msg = Message::get();
+        utl::bench::doNotOptimize(msg);
+        msg->reset();
+    }
+    utl::bench::report("pool.get_reset", sw.elapsedNs() / kCount, "ns/op");
+
+    // 一次取出多个，超过线程缓存的容量，会经过全局仓库。
+    std::vector<Message*> msgs(kBurst);
+    sw.restart();
+    for (size_t i = 0; i < kCount / kBurst; ++i) {
+        for (auto& msg : msgs) {
+            msg = Message::get();
+        }
+        for (auto msg : msgs) {
+            msg->reset();
+        }
+    }
+    utl::bench::report(withArg("pool.get_reset.burst", kBurst), sw.elapsedNs() / kCount, "ns/op");
+}
+
+BENCH_CASE(MessageQueueBench) {
+    constexpr size_t kCount = 1 << 20;
+
+    {
+        utl::MessageQueue q;
+        std::vector<Message*> msgs(kCount);
+        for (auto& msg : msgs) {
+            msg = makeMessage(0);
+        }
+
+        utl::bench::Stopwatch sw;
+        for (auto msg : msgs) {
+            q.enqueue(msg);
+        }
+        utl::bench::report("queue.enqueue.producers.1", sw.elapsedNs() / kCount, "ns/msg");
+
+        sw.restart();
+        drainQueue(&q);
+        utl::bench::report("queue.drain", sw.elapsedNs() / kCount, "ns/msg");
+    }
+
+    for (size_t producers : { 2, 4, 8 }) {
+        utl::MessageQueue q;
+        auto per_thread = kCount / producers;
+        std::vector<std::vector<Message*>> msgs(producers);
+        for (auto& v : msgs) {
+            v.resize(per_thread);
+            for (auto& msg : v) {
+                msg = makeMessage(0);
+            }
+        }
+
+        double ns = runConcurrently(producers, [&](size_t i) {
+            for (auto msg : msgs[i]) {
+                q.enqueue(msg);
+            }
+        });
+        utl::bench::report(
+            withArg("queue.enqueue.producers", producers), ns / (per_thread * producers), "ns/msg");
+        drainQueue(&q);
+    }
+
+    // 延时消息：到期时间在将来时并入延时结构，到期后再移入就绪队列。
+    for (size_t count : { 1000, 100000 }) {
+        utl::MessageQueue q;
+        std::mt19937_64 rng(count);
+        auto base = uint64_t((utl::Cycler::now() + 200ms).count());
+        std::vector<Message*> msgs(count);
+        for (auto& msg : msgs) {
+            msg = makeMessage(base + rng() % 50000000);
+        }
+
+        utl::bench::Stopwatch sw;
+        for (auto msg : msgs) {
+            q.enqueue(msg);
+        }
+        int64_t delay_ns;
+        q.takeBatch();
+        q.finishBatch(nullptr, &delay_ns);
+        utl::bench::report(withArg("timer.insert", count), sw.elapsedNs() / count, "ns/msg");
+
+        std::this_thread::sleep_for(
+            utl::Cycler::ns(int64_t(base) - utl::Cycler::now().count()) + 60ms);
+
+        sw.restart();
+        drainQueue(&q);
+        utl::bench::report(withArg("timer.expire", count), sw.elapsedNs() / count, "ns/msg");
+    }
+
+    // removeMessages() 遍历该 Cycler 自己的所有消息，耗时应与其消息数量成正比，
+    // 不受队列中其他 Cycler 的消息影响。
+    for (size_t count : { 1000, 16000, 128000 }) {
+        constexpr int kIds = 64;
+
+        utl::MessagePump::create();
+        {
+            utl::Cycler target;
+            utl::Cycler other;
+            for (size_t i = 0; i < count; ++i) {
+                target.post([]() {}, int(i % kIds));
+                other.post([]() {}, int(i % kIds));
+            }
+            // 先将接收栈并入队列，这部分不计入耗时。
+            target.hasMessages(-2);
+
+            utl::bench::Stopwatch sw;
+            for (int id = 0; id < kIds; ++id) {
+                target.removeMessages(id);
+            }
+            utl::bench::report(
+                withArg("queue.remove_messages", count), sw.elapsedNs() / kIds, "ns/call");
+        }
+        utl::MessagePump::destroy();
+    }
+}
+
+BENCH_CASE(MessagePumpBench) {
+    constexpr size_t kCount = 1 << 18;
+    constexpr size_t kLatencySamples = 20000;
+    constexpr size_t kRoundTrips = 100000;
+
+    // 预热消息池，避免第一轮包含分配的开销。
+    Message::reservePool(kCount);
+    benchPost(1, 0, kCount);
+
+    for (size_t producers : { 1, 2, 4 }) {
+        utl::bench::report(
+            withArg("pump.post.producers", producers), benchPost(producers, 0, kCount), "ns/msg");
+    }
+
+    // 每次等上一个消息执行完再投递，泵每次都从等待中被唤醒。
+    {
+        BenchPump pump;
+        std::vector<double> samples(kLatencySamples);
+        std::atomic<size_t> executed(0);
+        for (size_t i = 0; i < kLatencySamples; ++i) {
+            auto posted = utl::Cycler::now();
+            pump.cycler()->post([&samples, &executed, posted, i]() {
+                samples[i] = double((utl::Cycler::now() - posted).count());
+                executed.store(i + 1, std::memory_order_release);
+            });
+            while (executed.load(std::memory_order_acquire) != i + 1) {}
+        }
+        reportPercentiles("pump.latency", &samples);
+    }
+
+    // 两个泵之间来回投递。
+    {
+        BenchPump a;
+        BenchPump b;
+        utl::bench::report("pump.round_trip", benchRoundTrip(&a, &b, kRoundTrips), "ns");
+    }
+
+    // 两个泵绑定在同一个 CPU 上和分别绑定在两个 CPU 上。
+    auto cpus = utl::ThreadUtils::getCpusOfNode(
+        utl::ThreadUtils::getNodeOfCpu(utl::ThreadUtils::getCurrentCpu()));
+    if (cpus.empty()) {
+        for (unsigned i = 0; i < std::thread::hardware_concurrency(); ++i) {
+            cpus.push_back(int(i));
+        }
+    }
+    if (!cpus.empty()) {
+        BenchPump a({ "bench-a", { cpus[0] } });
+        BenchPump b({ "bench-b", { cpus[0] } });
+        utl::bench::report("pump.round_trip.same_cpu", benchRoundTrip(&a, &b, kRoundTrips), "ns");
+    }
+    if (cpus.size() >= 2) {
+        BenchPump a({ "bench-a", { cpus[0] } });
+        BenchPump b({ "bench-b", { cpus[1] } });
+        utl::bench::report("pump.round_trip.two_cpus", benchRoundTrip(&a, &b, kRoundTrips), "ns");
+    }
+}
+
+BENCH_CASE(MessagePostBatchBench) {
+    constexpr size_t kTotal = 1 << 18;
+
+    Message::reservePool(kTotal);
+    benchPost(1, 0, kTotal);
+
+    double single = benchPost(1, 0, kTotal);
+    utl::bench::report("post_batch.none", single, "ns/msg");
+
+    for (size_t size = 1; size <= 1024; size *= 2) {
+        utl::bench::report(withArg("post_batch.size", size), benchPost(1, size, kTotal), "ns/msg");
+    }
+}
+
+BENCH_CASE(MessageChannelBench) {
+    constexpr int kTotal = 1 << 20;
+
+    for (size_t capacity : { 64, 1024 }) {
+        BenchPump pump;
+        utl::MpscChannel<int> channel(capacity);
+
+        std::promise<void> bound;
+        std::promise<void> done;
+        pump.cycler()->post([&]() {
+            channel.bind([&done, count = 0](int&&) mutable {
+                if (++count == kTotal) {
+                    done.set_value();
+                }
+            });
+            bound.set_value();
+        });
+        bound.get_future().get();
+
+        utl::bench::Stopwatch sw;
+        for (int i = 0; i < kTotal; ++i) {
+            while (!channel.trySend(i)) {
+                std::this_thread::yield();
+            }
+        }
+        done.get_future().get();
+        utl::bench::report(withArg("channel.send.capacity", capacity), sw.elapsedNs() / kTotal, "ns/item");
+
+        // 先在接收线程中解除绑定，之后才能在本线程中销毁通道
+        std::promise<void> unbound;
+        pump.cycler()->post([&]() {
+            channel.unbind();
+            unbound.set_value();
+        });
+        unbound.get_future().get();
+    }
+}
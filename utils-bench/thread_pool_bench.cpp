@@ -0,0 +1,117 @@
+// Copyright (c) 2016 ucclkp <ucclkp@gmail.com>.
+// This file is part of utils project.
+//
+// This program is licensed under GPLv3 license that can be
+// found in the LICENSE file.
+
+#include <atomic>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "utils/message/thread_pool.h"
+
+#include "bench_collector.h"
+
+
+namespace {
+
+    // 每个任务的计算量，约为几十到一百纳秒。
+    constexpr int kSpinCount = 64;
+
+    struct Counter {
+        explicit Counter(int total)
+            : total(total), count(0) {}
+
+        void done() {
+            if (count.fetch_add(1, std::memory_order_acq_rel) + 1 == total) {
+                promise.set_value();
+            }
+        }
+
+        int total;
+        std::atomic<int> count;
+        std::promise<void> promise;
+    };
+
+    uint64_t spin(uint64_t seed) {
+        for (int i = 0; i < kSpinCount; ++i) {
+            seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+        }
+        return seed;
+    }
+
+    void fork(utl::ThreadPool* pool, Counter* counter, int depth) {
+        utl::bench::doNotOptimize(spin(uint64_t(depth)));
+        if (depth > 0) {
+            pool->post([=]() { fork(pool, counter, depth - 1); });
+            pool->post([=]() { fork(pool, counter, depth - 1); });
+        }
+        counter->done();
+    }
+
+    // 外部线程投递所有任务，主要经过注入队列。
+    double benchExternal(size_t threads, int task_count) {
+        utl::ThreadPool pool(threads);
+        Counter counter(task_count);
+        auto future = counter.promise.get_future();
+
+        utl::bench::Stopwatch sw;
+        for (int i = 0; i < task_count; ++i) {
+            pool.post([&counter, i]() {
+                utl::bench::doNotOptimize(spin(uint64_t(i)));
+                counter.done();
+            });
+        }
+        future.get();
+        return sw.elapsedNs();
+    }
+
+    // 任务递归地投递子任务，主要经过工作线程自己的队列和窃取。
+    double benchFork(size_t threads, int depth) {
+        utl::ThreadPool pool(threads);
+        Counter counter((1 << (depth + 1)) - 1);
+        auto future = counter.promise.get_future();
+
+        utl::bench::Stopwatch sw;
+        pool.post([&pool, &counter, depth]() { fork(&pool, &counter, depth); });
+        future.get();
+        return sw.elapsedNs();
+    }
+
+}
+
+BENCH_CASE(ThreadPoolBench) {
+    constexpr int kTaskCount = 200000;
+    constexpr int kForkDepth = 17;
+
+    size_t max_threads = std::thread::hardware_concurrency();
+    if (max_threads == 0) {
+        max_threads = 1;
+    }
+
+    std::vector<size_t> thread_counts;
+    for (size_t n = 1; n < max_threads; n *= 2) {
+        thread_counts.push_back(n);
+    }
+    thread_counts.push_back(max_threads);
+
+    double base_external = 0;
+    double base_fork = 0;
+    for (auto n : thread_counts) {
+        double ext_ns = benchExternal(n, kTaskCount);
+        double fork_ns = benchFork(n, kForkDepth);
+        if (n == 1) {
+            base_external = ext_ns;
+            base_fork = fork_ns;
+        }
+
+        double fork_tasks = double((1 << (kForkDepth + 1)) - 1);
+        auto suffix = ".threads." + std::to_string(n);
+        utl::bench::report("external" + suffix, ext_ns / kTaskCount, "ns/task");
+        utl::bench::report("external.speedup" + suffix, base_external / ext_ns, "x");
+        utl::bench::report("fork" + suffix, fork_ns / fork_tasks, "ns/task");
+        utl::bench::report("fork.speedup" + suffix, base_fork / fork_ns, "x");
+    }
+}
@@ -0,0 +1,105 @@
+// Copyright (c) 2016 ucclkp <ucclkp@gmail.com>.
+// This file is part of utils project.
+//
+// This program is licensed under GPLv3 license that can be
+// found in the LICENSE file.
+
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "utils/message/message.h"
+#include "utils/message/timer_queue.h"
+
+#include "bench_collector.h"
+
+
+namespace {
+
+    // 有序链表的插入是 O(n)，超过该数量时总耗时为分钟级，跳过。
+    constexpr size_t kMaxListCount = 100000;
+
+    // 结果的名称为 timer_queue.<kind>.<op>.<n>
+    std::string metricOf(const char* kind, const char* op, size_t count) {
+        return std::string("timer_queue.") + kind + "." + op + "." + std::to_string(count);
+    }
+
+    void benchTimerQueue(
+        const char* kind, utl::TimerQueue* q, const std::vector<uint64_t>& deadlines)
+    {
+        std::vector<utl::Message*> msgs(deadlines.size());
+        for (size_t i = 0; i < deadlines.size(); ++i) {
+            msgs[i] = utl::Message::get();
+            msgs[i]->time_ns = deadlines[i];
+        }
+
+        utl::bench::Stopwatch sw;
+        for (auto msg : msgs) {
+            q->push(msg);
+        }
+        double push_ns = sw.elapsedNs();
+
+        sw.restart();
+        uint64_t last = 0;
+        bool ordered = true;
+        while (auto msg = q->top()) {
+            ordered &= msg->time_ns >= last;
+            last = msg->time_ns;
+            q->pop();
+        }
+        double pop_ns = sw.elapsedNs();
+        utl::bench::doNotOptimize(ordered);
+
+        for (auto msg : msgs) {
+            msg->reset();
+        }
+
+        auto count = deadlines.size();
+        utl::bench::report(metricOf(kind, "push", count), push_ns / count, "ns/op");
+        utl::bench::report(metricOf(kind, "top_pop", count), pop_ns / count, "ns/op");
+        if (!ordered) {
+            utl::bench::note(metricOf(kind, "top_pop", count) + ": out of order");
+        }
+    }
+
+}
+
+BENCH_CASE(TimerQueueBench) {
+    const size_t counts[] = { 1000, 100000, 1000000 };
+
+    for (auto count : counts) {
+        // 截止时间均匀分布在 10s 的窗口内
+        std::mt19937_64 rng(count);
+        std::vector<uint64_t> deadlines(count);
+        uint64_t base = 1700000000000000000ull;
+        for (auto& d : deadlines) {
+            d = base + rng() % 10000000000ull;
+        }
+
+        if (count <= kMaxListCount) {
+            utl::TimerList list;
+            benchTimerQueue("list", &list, deadlines);
+        } else {
+            utl::bench::note(
+                "timer_queue.list." + std::to_string(count) + ": skipped, O(n^2) insertion");
+        }
+
+        {
+            utl::TimerBinaryHeap heap;
+            benchTimerQueue("binary_heap", &heap, deadlines);
+        }
+        {
+            utl::TimerQuaternaryHeap heap;
+            benchTimerQueue("quaternary_heap", &heap, deadlines);
+        }
+        {
+            utl::TimerWheel wheel(1000000);
+            benchTimerQueue("wheel_1ms", &wheel, deadlines);
+        }
+        {
+            utl::TimerWheel wheel(1000);
+            benchTimerQueue("wheel_1us", &wheel, deadlines);
+        }
+    }
+}
@@ -0,0 +1,167 @@
+// Copyright (c) 2016 ucclkp <ucclkp@gmail.com>.
+// This file is part of utils project.
+//
+// This program is licensed under GPLv3 license that can be
+// found in the LICENSE file.
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "utils/message/channel.hpp"
+#include "utils/message/cycler.h"
+#include "utils/message/message_pump.h"
+#include "utils/unit_test/test_collector.h"
+
+
+TEST_CASE(ChannelUnitTest) {
+
+    TEST_DEF("Channel SPSC tests.") {
+        constexpr int kCount = 20000;
+
+        utl::MessagePump::create();
+        utl::SpscChannel<std::unique_ptr<int>> channel(5);
+        TEST_E(channel.capacity(), 8u);
+
+        // 容量远小于数据量，发送端需要在满时重试
+        std::vector<int> received;
+        channel.bind([&received](std::unique_ptr<int>&& v) {
+            received.push_back(*v);
+            if (received.size() == kCount) {
+                utl::MessagePump::quit();
+            }
+        });
+
+        std::thread producer([&channel]() {
+            for (int i = 0; i < kCount; ++i) {
+                auto v = std::make_unique<int>(i);
+                while (!channel.trySend(std::move(v))) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+        utl::MessagePump::run();
+        producer.join();
+
+        TEST_E(received.size(), size_t(kCount));
+        bool ordered = true;
+        for (int i = 0; i < kCount; ++i) {
+            ordered &= received[i] == i;
+        }
+        TEST_TRUE(ordered);
+        TEST_E(channel.size(), 0u);
+
+        utl::MessagePump::destroy();
+        return true;
+    };
+
+    TEST_DEF("Channel MPSC tests.") {
+        constexpr int kProducers = 4;
+        constexpr int kPerProducer = 10000;
+
+        utl::MessagePump::create();
+        utl::MpscChannel<int> channel(64);
+
+        // 每个发送端自己的数据保持先后顺序
+        int total = 0;
+        std::vector<int> next(kProducers, 0);
+        bool ordered = true;
+        channel.bind([&](int&& v) {
+            auto p = v / kPerProducer;
+            ordered &= v % kPerProducer == next[p]++;
+            if (++total == kProducers * kPerProducer) {
+                utl::MessagePump::quit();
+            }
+        });
+
+        std::vector<std::thread> producers;
+        for (int p = 0; p < kProducers; ++p) {
+            producers.emplace_back([&channel, p]() {
+                for (int i = 0; i < kPerProducer; ++i) {
+                    while (!channel.trySend(p * kPerProducer + i)) {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        }
+        utl::MessagePump::run();
+        for (auto& t : producers) {
+            t.join();
+        }
+
+        TEST_E(total, kProducers * kPerProducer);
+        TEST_TRUE(ordered);
+
+        // 在 handler 中解除绑定，剩下的数据留在通道中
+        int handled = 0;
+        channel.bind([&](int&&) {
+            if (++handled == 3) {
+                channel.unbind();
+            }
+        });
+        for (int i = 0; i < 10; ++i) {
+            TEST_TRUE(channel.trySend(i));
+        }
+        utl::Cycler cycler;
+        cycler.post([]() { utl::MessagePump::quit(); });
+        utl::MessagePump::run();
+        TEST_E(handled, 3);
+        TEST_E(channel.size(), 7u);
+
+        utl::MessagePump::destroy();
+        return true;
+    };
+
+    TEST_DEF("Channel backpressure tests.") {
+        utl::MessagePump::create();
+        utl::Cycler cycler;
+
+        utl::MpscChannel<int> channel(8);
+        int sent = 0;
+        while (channel.trySend(sent)) {
+            ++sent;
+        }
+        TEST_E(sent, 8);
+
+        // 腾出一半空间后才通知
+        int writable = 0;
+        channel.whenWritable().then([&writable](bool ok) { writable = ok ? 1 : -1; });
+
+        int v;
+        for (int i = 0; i < 3; ++i) {
+            TEST_TRUE(channel.tryReceive(&v));
+            TEST_E(v, i);
+        }
+        cycler.post([]() { utl::MessagePump::quit(); });
+        utl::MessagePump::run();
+        TEST_E(writable, 0);
+
+        TEST_TRUE(channel.tryReceive(&v));
+        cycler.post([]() { utl::MessagePump::quit(); });
+        utl::MessagePump::run();
+        TEST_E(writable, 1);
+
+        // 关闭后不能再发送，等待中的通知以 false 完成，剩下的数据仍可以取出
+        TEST_TRUE(channel.trySend(100));
+        TEST_TRUE(channel.trySend(101));
+        TEST_TRUE(channel.trySend(102));
+        channel.whenWritable().then([&writable](bool ok) { writable = ok ? 1 : -1; });
+        channel.close();
+        TEST_TRUE(channel.isClosed());
+        TEST_FALSE(channel.trySend(103));
+        cycler.post([]() { utl::MessagePump::quit(); });
+        utl::MessagePump::run();
+        TEST_E(writable, -1);
+
+        int remaining = 0;
+        while (channel.tryReceive(&v)) {
+            ++remaining;
+        }
+        TEST_E(remaining, 7);
+        TEST_E(v, 102);
+
+        utl::MessagePump::destroy();
+        return true;
+    };
+
+}
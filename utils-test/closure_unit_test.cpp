@@ -0,0 +1,101 @@
+// Copyright (c) 2016 ucclkp <ucclkp@gmail.com>.
+// This file is part of utils project.
+//
+// This program is licensed under GPLv3 license that can be
+// found in the LICENSE file.
+
+#include <array>
+#include <functional>
+#include <memory>
+
+#include "utils/message/closure.hpp"
+#include "utils/unit_test/test_collector.h"
+
+
+namespace {
+
+    struct Counter {
+        explicit Counter(int* alive)
+            : alive(alive) { ++*alive; }
+        Counter(Counter&& rhs) noexcept
+            : alive(rhs.alive) { ++*alive; }
+        ~Counter() { --*alive; }
+
+        void operator()() {}
+
+        int* alive;
+    };
+
+}
+
+TEST_CASE(ClosureUnitTest) {
+
+    TEST_DEF("Closure inline storage tests.") {
+        int value = 0;
+        auto small = [&value]() { ++value; };
+        std::array<char, utl::Closure::kInlineSize> big_data{};
+        auto big = [&value, big_data]() { value += big_data[0] + 10; };
+
+        TEST_TRUE(utl::Closure::isInlined<decltype(small)>());
+        TEST_FALSE(utl::Closure::isInlined<decltype(big)>());
+        TEST_TRUE(utl::Closure::isInlined<std::function<void()>>());
+
+        utl::Closure c1(small);
+        utl::Closure c2(big);
+        TEST_TRUE(!!c1);
+        TEST_TRUE(!!c2);
+        c1();
+        c2();
+        TEST_E(value, 11);
+
+        // 移动之后原对象为空
+        utl::Closure c3(std::move(c1));
+        utl::Closure c4;
+        c4 = std::move(c2);
+        TEST_FALSE(!!c1);
+        TEST_FALSE(!!c2);
+        c3();
+        c4();
+        TEST_E(value, 22);
+        return true;
+    };
+
+    TEST_DEF("Closure move-only and lifetime tests.") {
+        int result = 0;
+        auto ptr = std::make_unique<int>(42);
+        utl::Closure c([&result, p = std::move(ptr)]() { result = *p; });
+        c();
+        TEST_E(result, 42);
+
+        int alive = 0;
+        {
+            utl::Closure c1(Counter{ &alive });
+            TEST_E(alive, 1);
+
+            utl::Closure c2(std::move(c1));
+            TEST_E(alive, 1);
+
+            c2 = nullptr;
+            TEST_E(alive, 0);
+
+            c2 = Counter{ &alive };
+            TEST_E(alive, 1);
+        }
+        TEST_E(alive, 0);
+        return true;
+    };
+
+    TEST_DEF("Closure null tests.") {
+        utl::Closure c1(std::function<void()>{});
+        TEST_FALSE(!!c1);
+
+        void (*fp)() = nullptr;
+        utl::Closure c2(fp);
+        TEST_FALSE(!!c2);
+
+        utl::Closure c3(nullptr);
+        TEST_FALSE(!!c3);
+        return true;
+    };
+
+}
@@ -0,0 +1,166 @@
+// Copyright (c) 2016 ucclkp <ucclkp@gmail.com>.
+// This file is part of utils project.
+//
+// This program is licensed under GPLv3 license that can be
+// found in the LICENSE file.
+
+#include "utils/message/coroutine.hpp"
+
+#ifdef UTL_HAS_COROUTINES
+
+#include <atomic>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "utils/message/cycler.h"
+#include "utils/message/message_pump.h"
+#include "utils/message/thread_pool.h"
+#include "utils/unit_test/test_collector.h"
+
+
+namespace {
+
+    utl::Task<int> compute(utl::ThreadPool& pool, utl::Cycler& cycler, int val) {
+        auto doubled = co_await utl::postAndReply(pool, cycler, [val]() { return val * 2; });
+        co_return doubled + 1;
+    }
+
+    utl::Task<void> pipeline(
+        utl::ThreadPool& pool, utl::Cycler& cycler,
+        std::thread::id pump_id, std::vector<int>* out, bool* on_pump)
+    {
+        using namespace std::chrono_literals;
+
+        co_await utl::switchTo(pool);
+        *on_pump = std::this_thread::get_id() != pump_id;
+
+        co_await utl::switchTo(cycler);
+        *on_pump &= std::this_thread::get_id() == pump_id;
+
+        auto start = utl::Cycler::now();
+        co_await utl::sleepFor(cycler, 10ms);
+        *on_pump &= std::this_thread::get_id() == pump_id;
+        out->push_back(utl::Cycler::now() - start >= 10ms ? 1 : 0);
+
+        out->push_back(co_await compute(pool, cycler, 20));
+        *on_pump &= std::this_thread::get_id() == pump_id;
+
+        try {
+            co_await utl::postAndReply(pool, cycler, []() { throw std::runtime_error("x"); });
+        } catch (const std::runtime_error&) {
+            out->push_back(-1);
+        }
+
+        utl::MessagePump::quit();
+    }
+
+    struct DestroyFlag {
+        ~DestroyFlag() {
+            *destroyed = true;
+        }
+
+        std::atomic<bool>* destroyed;
+    };
+
+    utl::Task<void> sleeper(
+        utl::Cycler& cycler, std::atomic<bool>* destroyed, std::atomic<bool>* resumed)
+    {
+        using namespace std::chrono_literals;
+
+        DestroyFlag flag{ destroyed };
+        co_await utl::sleepFor(cycler, 1h);
+        *resumed = true;
+    }
+
+    utl::Task<void> sleeperOwner(
+        utl::Cycler& cycler, std::atomic<bool>* destroyed,
+        std::atomic<bool>* inner_destroyed, std::atomic<bool>* resumed)
+    {
+        DestroyFlag flag{ destroyed };
+        co_await sleeper(cycler, inner_destroyed, resumed);
+        *resumed = true;
+    }
+
+    utl::Task<void> replier(
+        utl::ThreadPool& pool, utl::Cycler& reply,
+        std::atomic<bool>* destroyed, std::atomic<bool>* resumed)
+    {
+        DestroyFlag flag{ destroyed };
+        co_await utl::postAndReply(pool, reply, []() { return 1; });
+        *resumed = true;
+    }
+
+}
+
+TEST_CASE(CoroutineUnitTest) {
+
+    TEST_DEF("Coroutine Task tests.") {
+        std::vector<int> out;
+        bool on_pump = false;
+
+        utl::ThreadPool pool(2);
+        std::promise<std::thread::id> promise;
+
+        std::thread worker([&]() {
+            utl::MessagePump::create();
+            utl::Cycler cycler;
+            promise.set_value(std::this_thread::get_id());
+            pipeline(pool, cycler, std::this_thread::get_id(), &out, &on_pump).detach();
+            utl::MessagePump::run();
+            utl::MessagePump::destroy();
+        });
+
+        promise.get_future().get();
+        worker.join();
+
+        TEST_TRUE(on_pump);
+        TEST_E(out.size(), 3u);
+        TEST_E(out[0], 1);
+        TEST_E(out[1], 41);
+        TEST_E(out[2], -1);
+        return true;
+    };
+
+    TEST_DEF("Coroutine abandon tests.") {
+        using namespace std::chrono_literals;
+
+        // 等待的消息随 Cycler 析构被移除，整条 Task 链被销毁而不会恢复
+        std::atomic<bool> destroyed{ false };
+        std::atomic<bool> inner_destroyed{ false };
+        std::atomic<bool> resumed{ false };
+
+        utl::MessagePump::create();
+        {
+            utl::Cycler cycler;
+            sleeperOwner(cycler, &destroyed, &inner_destroyed, &resumed).detach();
+            TEST_FALSE(destroyed.load());
+        }
+        utl::MessagePump::destroy();
+
+        TEST_TRUE(destroyed.load());
+        TEST_TRUE(inner_destroyed.load());
+        TEST_FALSE(resumed.load());
+
+        // 回复的泵已销毁
+        destroyed = false;
+        {
+            utl::ThreadPool pool(1);
+            utl::Cycler reply{ std::weak_ptr<utl::MessagePump>() };
+            replier(pool, reply, &destroyed, &resumed).detach();
+
+            auto start = utl::Cycler::now();
+            while (!destroyed.load() && utl::Cycler::now() - start < 1s) {
+                std::this_thread::sleep_for(1ms);
+            }
+        }
+        TEST_TRUE(destroyed.load());
+        TEST_FALSE(resumed.load());
+        return true;
+    };
+
+}
+
+#endif  // UTL_HAS_COROUTINES
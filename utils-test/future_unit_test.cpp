@@ -0,0 +1,151 @@
+// Copyright (c) 2016 ucclkp <ucclkp@gmail.com>.
+// This file is part of utils project.
+//
+// This program is licensed under GPLv3 license that can be
+// found in the LICENSE file.
+
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "utils/message/cycler.h"
+#include "utils/message/future.hpp"
+#include "utils/message/message_pump.h"
+#include "utils/unit_test/test_collector.h"
+
+
+namespace {
+
+    class WorkerThread {
+    public:
+        WorkerThread() {
+            std::promise<utl::Cycler*> ready;
+            thread_ = std::thread([this, &ready]() {
+                utl::MessagePump::create();
+                utl::Cycler cycler;
+                id_ = std::this_thread::get_id();
+                ready.set_value(&cycler);
+                utl::MessagePump::run();
+                utl::MessagePump::destroy();
+            });
+            cycler_ = ready.get_future().get();
+        }
+
+        ~WorkerThread() {
+            cycler_->post([]() { utl::MessagePump::quit(); });
+            thread_.join();
+        }
+
+        utl::Cycler* cycler() const { return cycler_; }
+        std::thread::id id() const { return id_; }
+
+    private:
+        std::thread thread_;
+        std::thread::id id_;
+        utl::Cycler* cycler_ = nullptr;
+    };
+
+}
+
+TEST_CASE(FutureUnitTest) {
+
+    TEST_DEF("postTaskAndReply tests.") {
+        WorkerThread worker;
+
+        utl::MessagePump::create();
+
+        std::vector<std::string> out;
+        bool task_on_worker = false;
+        bool reply_on_origin = true;
+        auto origin = std::this_thread::get_id();
+
+        worker.cycler()->postTaskAndReply(
+            [&]() {
+                task_on_worker = std::this_thread::get_id() == worker.id();
+                return std::string("result");
+            },
+            [&](std::string r) {
+                reply_on_origin &= std::this_thread::get_id() == origin;
+                out.push_back(std::move(r));
+            });
+
+        // 返回 void 的任务，回复没有参数；结果只能移动也可以
+        worker.cycler()->postTaskAndReply(
+            []() {},
+            [&]() {
+                reply_on_origin &= std::this_thread::get_id() == origin;
+                out.push_back("void");
+            });
+        worker.cycler()->postTaskAndReply(
+            []() { return std::make_unique<int>(7); },
+            [&](std::unique_ptr<int> r) {
+                reply_on_origin &= std::this_thread::get_id() == origin;
+                out.push_back(std::to_string(*r));
+                utl::MessagePump::quit();
+            });
+
+        utl::MessagePump::run();
+        utl::MessagePump::destroy();
+
+        TEST_TRUE(task_on_worker);
+        TEST_TRUE(reply_on_origin);
+        TEST_E(out.size(), 3u);
+        TEST_E(out[0], std::string("result"));
+        TEST_E(out[1], std::string("void"));
+        TEST_E(out[2], std::string("7"));
+        return true;
+    };
+
+    TEST_DEF("Future and Promise tests.") {
+        WorkerThread worker;
+
+        utl::MessagePump::create();
+
+        std::vector<int> out;
+        bool on_origin = true;
+        auto origin = std::this_thread::get_id();
+
+        // 回调在结果之前设置
+        auto f1 = worker.cycler()->postTask([]() { return 1; });
+        std::move(f1).then([&](int v) {
+            on_origin &= std::this_thread::get_id() == origin;
+            out.push_back(v);
+        });
+
+        // 回调在结果之后设置，仍然通过泵异步执行
+        utl::Promise<int> p2;
+        auto f2 = p2.getFuture();
+        p2.setValue(2);
+        TEST_TRUE(f2.isReady());
+        std::move(f2).then([&](int v) { out.push_back(v); });
+        TEST_TRUE(out.empty());
+
+        // Promise 未设置结果就销毁，回调不会执行
+        utl::Future<int> f3;
+        {
+            utl::Promise<int> p3;
+            f3 = p3.getFuture();
+        }
+        std::move(f3).then([&](int) { out.push_back(-1); });
+
+        auto f4 = worker.cycler()->postTask([]() {});
+        std::move(f4).then([&]() {
+            on_origin &= std::this_thread::get_id() == origin;
+            out.push_back(4);
+            utl::MessagePump::quit();
+        });
+
+        utl::MessagePump::run();
+        utl::MessagePump::destroy();
+
+        // 前两个结果的先后取决于工作线程的进度
+        TEST_TRUE(on_origin);
+        TEST_E(out.size(), 3u);
+        TEST_E(out[0] + out[1], 3);
+        TEST_E(out[2], 4);
+        return true;
+    };
+
+}
@@ -5,6 +5,9 @@
 // found in the LICENSE file.
 
 #include <sstream>
+#include <streambuf>
+#include <string>
+#include <string_view>
 
 #include "utils/json/json_parser.h"
 #include "utils/strings/string_utils_types.hpp"
@@ -114,6 +117,22 @@ const char* test_json = R"({
   }
 })";
 
+namespace {
+
+    // 与管道一样不支持定位的流
+    class UnseekableBuf : public std::streambuf {
+    public:
+        explicit UnseekableBuf(std::string data)
+            : data_(std::move(data)) {
+            setg(&data_[0], &data_[0], &data_[0] + data_.size());
+        }
+
+    private:
+        std::string data_;
+    };
+
+}
+
 TEST_CASE(JSONUnitTest) {
 
     TEST_DEF("JSON parser test 1.") {
@@ -199,4 +218,60 @@ TEST_CASE(JSONUnitTest) {
         return true;
     };
 
+    TEST_DEF("JSON parser buffer tests.") {
+        JSONParser parser;
+        JSONParser::ValuePtr value;
+        TEST_TRUE(parser.parse(std::string_view(test_json), &value));
+        TEST_E(value->asObject()->getString("web-app.servlet-mapping.cofaxCDS"), "/");
+        TEST_E(value->asObject()->getArray("web-app.servlet")->getCount(), 5u);
+
+        // 不要求以 0 结尾
+        const char buf[] = "[1, -20, 0.5, 5e2, -1.5E-1, true, false, null, \"a\\tb\\u0040\", {}]xxx";
+        constexpr size_t kLen = sizeof(buf) - 4;
+        TEST_TRUE(parser.parse(buf, kLen, &value));
+        auto array = value->asArray();
+        TEST_E(array->getCount(), 10u);
+        TEST_E(array->getInteger(0), 1);
+        TEST_E(array->getInteger(1), -20);
+        TEST_E(array->getDouble(2), 0.5);
+        TEST_E(array->getDouble(3), 500.0);
+        TEST_E(array->getDouble(4), -0.15);
+        TEST_TRUE(array->getBoolean(5));
+        TEST_FALSE(array->getBoolean(6, true));
+        TEST_E(array->getString(8), "a\tb@");
+        TEST_FALSE(parser.parse(buf, kLen - 1, &value));
+
+        // 截断的数据
+        const char* truncated[] = {
+            "", "{", "[", "{\"a\"", "{\"a\":", "[1,", "[\"a", "[\"\\u00", "[tru", "[-", "[1.", "[1e",
+        };
+        for (auto str : truncated) {
+            TEST_FALSE(parser.parse(std::string_view(str), &value));
+        }
+
+        // 流停在 JSON 结束的位置
+        std::istringstream iss("{\"a\":[1,2]} tail", std::ios::binary);
+        TEST_TRUE(parser.parse(iss, &value));
+        TEST_E(value->asObject()->getArray("a")->getCount(), 2u);
+        std::string tail;
+        iss >> tail;
+        TEST_E(tail, "tail");
+
+        // 失败时流回到开始的位置
+        std::istringstream bad("{\"a\":[1,}] tail", std::ios::binary);
+        TEST_FALSE(parser.parse(bad, &value));
+        TEST_TRUE(bool(bad));
+        TEST_E(int(bad.tellg()), 0);
+
+        // 只读到 JSON 结束的位置，不依赖流的定位
+        UnseekableBuf sb("[\"]\\\"\", {\"b\": \"}\"}]{\"next\":1}");
+        std::istream unseekable(&sb);
+        TEST_TRUE(unseekable.tellg() == std::istream::pos_type(-1));
+        TEST_TRUE(parser.parse(unseekable, &value));
+        TEST_E(value->asArray()->getString(0), "]\"");
+        TEST_TRUE(parser.parse(unseekable, &value));
+        TEST_E(value->asObject()->getInteger("next"), 1);
+        return true;
+    };
+
 }
\ No newline at end of file
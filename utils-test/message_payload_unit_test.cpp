@@ -0,0 +1,31 @@
+// Copyright (c) 2016 ucclkp <ucclkp@gmail.com>.
+// This file is part of utils project.
+//
+// This program is licensed under GPLv3 license that can be
+// found in the LICENSE file.
+
+#include "utils/message/message.h"
+#include "utils/unit_test/test_collector.h"
+
+
+// 定义在 message_unit_test.cpp 中，内嵌数据在另一个编译单元中构造。
+utl::Message* newIntPayloadMessage(int val);
+
+TEST_CASE(MessagePayloadUnitTest) {
+
+    TEST_DEF("Message payload cross-TU tests.") {
+        // int 与 float 的析构函数都是空函数，链接器合并相同代码后也不能混淆
+        auto msg = newIntPayloadMessage(42);
+        TEST_TRUE(msg->getPayload<float>() == nullptr);
+        TEST_TRUE(msg->getPayload<unsigned int>() == nullptr);
+        TEST_TRUE(msg->getPayload<int>() != nullptr);
+        TEST_E(*msg->getPayload<int>(), 42);
+
+        msg->emplacePayload<float>(1.5f);
+        TEST_TRUE(msg->getPayload<int>() == nullptr);
+        TEST_E(*msg->getPayload<float>(), 1.5f);
+        msg->reset();
+        return true;
+    };
+
+}
@@ -4,13 +4,61 @@
 // This program is licensed under GPLv3 license that can be
 // found in the LICENSE file.
 
-#include <thread>
+#include <atomic>
+#include <functional>
 #include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include "utils/message/cycler.h"
+#include "utils/message/hang_watchdog.h"
 #include "utils/message/message_pump.h"
+#include "utils/message/message_queue.h"
+#include "utils/message/pump_thread.h"
+#include "utils/message/thread_pool.h"
+#include "utils/platform_utils.h"
 #include "utils/unit_test/test_collector.h"
 
+#ifdef OS_LINUX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+namespace {
+
+    struct Point {
+        int x;
+        int y;
+    };
+
+    class PayloadListener : public utl::CyclerListener {
+    public:
+        void onHandleMessage(const utl::Message& msg) override {
+            if (auto p = msg.getPayload<Point>()) {
+                sum += p->x + p->y;
+            }
+            if (auto s = msg.getPayload<std::shared_ptr<int>>()) {
+                sum += **s;
+            }
+            if (msg.id == 0) {
+                utl::MessagePump::quit();
+            }
+        }
+
+        int sum = 0;
+    };
+
+}
+
+utl::Message* newIntPayloadMessage(int val) {
+    auto msg = utl::Message::get();
+    msg->emplacePayload<int>(val);
+    return msg;
+}
 
 TEST_CASE(MessageUnitTest) {
 
@@ -91,4 +139,913 @@ TEST_CASE(MessageUnitTest) {
         return true;
     };
 
-}
\ No newline at end of file
+    TEST_DEF("MessagePump postDelayed() tests.") {
+        std::vector<int> order;
+
+        std::weak_ptr<utl::MessagePump> pump;
+        std::promise<void> promise;
+
+        std::thread worker([&pump, &promise]() {
+            utl::MessagePump::create();
+            pump = utl::MessagePump::getCurrent();
+            promise.set_value();
+            utl::MessagePump::run();
+            utl::MessagePump::destroy();
+        });
+
+        promise.get_future().get();
+
+        using namespace std::chrono_literals;
+
+        auto start = utl::Cycler::now();
+        utl::Cycler::ns elapsed(0);
+
+        utl::Cycler cycler(pump);
+        cycler.postDelayed([&order]() { order.push_back(2); }, 20ms);
+        cycler.postDelayed([&order]() { order.push_back(1); }, 10ms);
+        cycler.postDelayed([&order]() { order.push_back(3); }, 20ms);
+        cycler.postDelayed([pump, start, &elapsed]() {
+            elapsed = utl::Cycler::now() - start;
+            auto ptr = pump.lock();
+            if (ptr) {
+                ptr->quit();
+            }
+        }, 30ms);
+
+        worker.join();
+
+        TEST_E(order.size(), 3u);
+        TEST_E(order[0], 1);
+        TEST_E(order[1], 2);
+        TEST_E(order[2], 3);
+        TEST_TRUE(elapsed >= 30ms);
+        return true;
+    };
+
+    TEST_DEF("MessagePump multi-producer post() tests.") {
+        constexpr int kProducers = 4;
+        constexpr int kPerProducer = 1000;
+
+        int count = 0;
+        bool in_order = true;
+        int last[kProducers] = {};
+
+        std::weak_ptr<utl::MessagePump> pump;
+        std::promise<void> promise;
+
+        std::thread worker([&pump, &promise]() {
+            utl::MessagePump::create();
+            pump = utl::MessagePump::getCurrent();
+            promise.set_value();
+            utl::MessagePump::run();
+            utl::MessagePump::destroy();
+        });
+
+        promise.get_future().get();
+
+        utl::Cycler cycler(pump);
+
+        std::vector<std::thread> producers;
+        for (int p = 0; p < kProducers; ++p) {
+            producers.emplace_back([&, p]() {
+                for (int i = 1; i <= kPerProducer; ++i) {
+                    cycler.post([&, p, i]() {
+                        if (last[p] + 1 != i) {
+                            in_order = false;
+                        }
+                        last[p] = i;
+                        ++count;
+                    });
+                }
+            });
+        }
+        for (auto& t : producers) {
+            t.join();
+        }
+
+        cycler.post([pump]() {
+            auto ptr = pump.lock();
+            if (ptr) {
+                ptr->quit();
+            }
+        });
+
+        worker.join();
+
+        TEST_E(count, kProducers * kPerProducer);
+        TEST_TRUE(in_order);
+        return true;
+    };
+
+    TEST_DEF("MessagePump cancellation handle tests.") {
+        constexpr int kCount = 100;
+
+        int count = 0;
+        int other_count = 0;
+
+        std::weak_ptr<utl::MessagePump> pump;
+        std::promise<void> promise;
+
+        std::thread worker([&pump, &promise]() {
+            utl::MessagePump::create();
+            pump = utl::MessagePump::getCurrent();
+            promise.set_value();
+            utl::MessagePump::run();
+            utl::MessagePump::destroy();
+        });
+
+        promise.get_future().get();
+
+        using namespace std::chrono_literals;
+
+        utl::Cycler cycler(pump);
+        std::vector<utl::MessageHandle> handles;
+        for (int i = 0; i < kCount; ++i) {
+            handles.push_back(cycler.postDelayed([&count]() { ++count; }, 20ms, i % 4));
+        }
+
+        {
+            // 析构时只移除自己的消息
+            utl::Cycler other(pump);
+            for (int i = 0; i < kCount; ++i) {
+                other.postDelayed([&other_count]() { ++other_count; }, 10ms, i % 4);
+            }
+        }
+
+        for (int i = 0; i < kCount; ++i) {
+            TEST_TRUE(cycler.hasMessage(handles[i]));
+        }
+
+        // 取消所有 id 为 0 的消息，再逐个取消 id 为 1 的消息
+        cycler.removeMessages(0);
+        TEST_FALSE(cycler.hasMessages(0));
+        for (int i = 0; i < kCount; ++i) {
+            if (i % 4 == 0) {
+                TEST_FALSE(cycler.hasMessage(handles[i]));
+                TEST_FALSE(cycler.removeMessage(handles[i]));
+            } else if (i % 4 == 1) {
+                TEST_TRUE(cycler.removeMessage(handles[i]));
+                TEST_FALSE(cycler.removeMessage(handles[i]));
+                TEST_FALSE(cycler.hasMessage(handles[i]));
+            }
+        }
+        TEST_FALSE(cycler.hasMessages(1));
+        TEST_TRUE(cycler.hasMessages(2));
+        TEST_FALSE(cycler.hasMessage(utl::MessageHandle()));
+
+        std::promise<void> done;
+        cycler.postDelayed([&done]() { done.set_value(); }, 40ms);
+        done.get_future().get();
+
+        // 已执行的消息不能再被取消
+        for (int i = 0; i < kCount; ++i) {
+            TEST_FALSE(cycler.hasMessage(handles[i]));
+            TEST_FALSE(cycler.removeMessage(handles[i]));
+        }
+
+        cycler.post([pump]() {
+            auto ptr = pump.lock();
+            if (ptr) {
+                ptr->quit();
+            }
+        });
+
+        worker.join();
+
+        TEST_E(count, kCount / 2);
+        TEST_E(other_count, 0);
+        return true;
+    };
+
+    TEST_DEF("Message pool tests.") {
+        constexpr size_t kCount = utl::Message::kDefaultMagazineSize * 4;
+
+        utl::Message::reservePool(kCount * 2);
+
+        auto before = utl::Message::getPoolStats();
+
+        // 在新线程中进行，使线程缓存从空开始
+        std::thread worker([]() {
+            std::vector<utl::Message*> msgs;
+            for (size_t i = 0; i < kCount; ++i) {
+                msgs.push_back(utl::Message::get());
+            }
+            for (auto msg : msgs) {
+                msg->reset();
+            }
+        });
+        worker.join();
+        auto after = utl::Message::getPoolStats();
+
+        // 退出的线程会把缓存全部归还，统计数据则保留下来
+        TEST_E(after.hits + after.misses - before.hits - before.misses, kCount);
+        TEST_E(after.misses, after.refills + after.allocations);
+        TEST_TRUE(after.refills > before.refills);
+        TEST_TRUE(after.flushes > before.flushes);
+        TEST_E(after.allocations, before.allocations);
+        return true;
+    };
+
+    TEST_DEF("Message pool thread exit tests.") {
+        using namespace std::chrono_literals;
+
+        // 线程退出时未调用 destroy()，线程缓存析构之后，队列才在泵的析构中回收消息
+        std::thread worker([]() {
+            utl::MessagePump::create();
+            utl::Cycler cycler;
+            cycler.setClearWhenDestroy(false);
+            cycler.postDelayed([]() {}, 1h);
+        });
+        worker.join();
+
+        constexpr size_t kCount = 1000;
+        auto before = utl::Message::getPoolStats();
+        std::thread other([]() {
+            for (size_t i = 0; i < kCount; ++i) {
+                utl::Message::get()->reset();
+            }
+        });
+        other.join();
+        auto after = utl::Message::getPoolStats();
+
+        // 已退出的线程不再被统计
+        TEST_E(after.hits + after.misses - before.hits - before.misses, kCount);
+        TEST_E(after.misses, after.refills + after.allocations);
+        TEST_E(utl::Message::getPoolStats().hits, after.hits);
+        return true;
+    };
+
+    TEST_DEF("Message payload tests.") {
+        TEST_E(alignof(utl::Message), 64u);
+        TEST_E(sizeof(utl::Message) % 64, 0u);
+        TEST_TRUE(sizeof(utl::Message) <= 6 * 64u);
+
+        // 类型不符时取不到，重新构造或回收时析构
+        auto counter = std::make_shared<int>(1);
+        auto msg = utl::Message::get();
+        TEST_TRUE(msg->getPayload<Point>() == nullptr);
+        msg->emplacePayload<std::shared_ptr<int>>(counter);
+        TEST_E(counter.use_count(), 2);
+        TEST_TRUE(msg->getPayload<Point>() == nullptr);
+        TEST_E(**msg->getPayload<std::shared_ptr<int>>(), 1);
+        msg->emplacePayload<Point>(Point{ 1, 2 });
+        TEST_E(counter.use_count(), 1);
+        TEST_E(msg->getPayload<Point>()->y, 2);
+        msg->emplacePayload<std::shared_ptr<int>>(counter);
+        msg->reset();
+        TEST_E(counter.use_count(), 1);
+
+        utl::MessagePump::create();
+        PayloadListener listener;
+        utl::Cycler cycler;
+        cycler.setListener(&listener);
+
+        cycler.postPayload(1, Point{ 3, 4 });
+        cycler.postPayload(2, counter);
+        auto cancelled = cycler.postPayload(3, counter);
+        cycler.post(0);
+        TEST_E(counter.use_count(), 3);
+        TEST_TRUE(cycler.removeMessage(cancelled));
+        TEST_E(counter.use_count(), 2);
+        utl::MessagePump::run();
+
+        // 执行后即析构
+        TEST_E(listener.sum, 3 + 4 + 1);
+        TEST_E(counter.use_count(), 1);
+
+        utl::MessagePump::destroy();
+        return true;
+    };
+
+    TEST_DEF("MessagePump move-only post() tests.") {
+        int result = 0;
+
+        std::weak_ptr<utl::MessagePump> pump;
+        std::promise<void> promise;
+
+        std::thread worker([&pump, &promise]() {
+            utl::MessagePump::create();
+            pump = utl::MessagePump::getCurrent();
+            promise.set_value();
+            utl::MessagePump::run();
+            utl::MessagePump::destroy();
+        });
+
+        promise.get_future().get();
+
+        utl::Cycler cycler(pump);
+        auto value = std::make_unique<int>(42);
+        cycler.post([&result, value = std::move(value)]() {
+            result = *value;
+        });
+
+        cycler.post([pump]() {
+            auto ptr = pump.lock();
+            if (ptr) {
+                ptr->quit();
+            }
+        });
+
+        worker.join();
+
+        TEST_E(result, 42);
+        return true;
+    };
+
+    TEST_DEF("MessagePump priority tests.") {
+        using namespace std::chrono_literals;
+
+        utl::MessagePump::create();
+        auto queue = utl::MessagePump::getCurrent()->getQueue();
+
+        utl::Cycler critical;
+        utl::Cycler normal;
+        utl::Cycler background;
+        critical.setPriority(utl::Message::PRI_CRITICAL);
+        background.setPriority(utl::Message::PRI_BACKGROUND);
+
+        // 同时就绪的消息按优先级执行，同一优先级内先进先出
+        std::vector<int> order;
+        for (int i = 0; i < 3; ++i) {
+            background.post([&order, i]() { order.push_back(20 + i); });
+            normal.post([&order, i]() { order.push_back(10 + i); });
+            critical.post([&order, i]() { order.push_back(i); });
+        }
+        normal.post([]() { utl::MessagePump::quit(); });
+        utl::MessagePump::run();
+
+        TEST_E(order.size(), 9u);
+        for (int i = 0; i < 9; ++i) {
+            TEST_E(order[i], (i / 3) * 10 + i % 3);
+        }
+
+        // 高优先级的消息总是占满时间片时，等待超过时限的后台消息仍会被执行
+        utl::MessagePump::getCurrent()->setTimeSlice(1ms);
+        queue->setAgingLimit(utl::Message::PRI_BACKGROUND, 5ms);
+
+        bool bg_ran = false;
+        bool bg_ran_early = false;
+        auto start = utl::Cycler::now();
+        std::function<void()> flood = [&]() {
+            std::this_thread::sleep_for(1ms);
+            if (utl::Cycler::now() - start < 50ms) {
+                critical.post([&]() { flood(); });
+            } else if (!bg_ran_early) {
+                bg_ran_early = bg_ran;
+                utl::MessagePump::quit();
+            }
+        };
+        background.post([&bg_ran]() { bg_ran = true; });
+        for (int i = 0; i < 3; ++i) {
+            critical.post([&]() { flood(); });
+        }
+        utl::MessagePump::run();
+
+        auto stats = queue->getPriorityStats(utl::Message::PRI_BACKGROUND);
+        utl::MessagePump::destroy();
+
+        TEST_TRUE(bg_ran_early);
+        TEST_E(stats.count, 4u);
+        TEST_E(stats.aged, 1u);
+        TEST_TRUE(stats.max_delay_ns >= uint64_t(std::chrono::nanoseconds(5ms).count()));
+        return true;
+    };
+
+    TEST_DEF("MessagePump batch tests.") {
+        utl::MessagePump::create();
+
+        // 同一批中的消息在执行前仍可以被移除
+        std::vector<int> order;
+        utl::Cycler cycler;
+        auto other = std::make_unique<utl::Cycler>();
+        utl::MessageHandle h2;
+        bool has_self = true;
+        bool removed = false;
+
+        cycler.post([&]() {
+            order.push_back(1);
+            has_self = cycler.hasMessages(7);
+            removed = cycler.removeMessage(h2);
+            other.reset();
+        }, 7);
+        h2 = cycler.post([&]() { order.push_back(2); });
+        other->post([&]() { order.push_back(3); });
+        cycler.post([&]() {
+            order.push_back(4);
+            utl::MessagePump::quit();
+        });
+        utl::MessagePump::run();
+        utl::MessagePump::destroy();
+
+        TEST_FALSE(has_self);
+        TEST_TRUE(removed);
+        TEST_E(order.size(), 2u);
+        TEST_E(order[0], 1);
+        TEST_E(order[1], 4);
+        return true;
+    };
+
+    TEST_DEF("MessagePump idle task tests.") {
+        using namespace std::chrono_literals;
+
+        utl::MessagePump::create();
+        utl::Cycler cycler;
+
+        // 只在没有其他工作时执行，截止时间不超过下一个延时消息
+        std::vector<int> order;
+        bool in_time = false;
+        cycler.post([&]() {
+            order.push_back(1);
+            cycler.postDelayed([&]() {
+                order.push_back(3);
+                utl::MessagePump::quit();
+            }, 20ms);
+        });
+        cycler.postIdle([&](const utl::IdleDeadline& d) {
+            order.push_back(2);
+            auto remaining = d.getTimeRemaining();
+            in_time = !d.isTimedOut() && remaining > 0ms && remaining <= 20ms;
+        });
+        auto removed = cycler.postIdle([&](const utl::IdleDeadline&) { order.push_back(-1); });
+        TEST_TRUE(cycler.removeMessage(removed));
+        utl::MessagePump::run();
+
+        TEST_TRUE(in_time);
+        TEST_E(order.size(), 3u);
+        TEST_E(order[0], 1);
+        TEST_E(order[1], 2);
+        TEST_E(order[2], 3);
+
+        // 泵一直忙碌时，超过等待时限的空闲任务仍会执行
+        bool timed_out = false;
+        bool idle_ran = false;
+        auto start = utl::Cycler::now();
+        std::function<void()> busy = [&]() {
+            if (utl::Cycler::now() - start < 30ms) {
+                cycler.post([&]() { busy(); });
+            } else {
+                utl::MessagePump::quit();
+            }
+        };
+        cycler.post([&]() { busy(); });
+        cycler.postIdle([&](const utl::IdleDeadline& d) {
+            idle_ran = utl::Cycler::now() - start < 30ms;
+            timed_out = d.isTimedOut();
+        }, 5ms);
+        utl::MessagePump::run();
+        utl::MessagePump::destroy();
+
+        TEST_TRUE(idle_ran);
+        TEST_TRUE(timed_out);
+        return true;
+    };
+
+#ifdef OS_LINUX
+    TEST_DEF("MessagePump fd watching tests.") {
+        using namespace std::chrono_literals;
+
+        int fds[2];
+        TEST_E(::pipe2(fds, O_NONBLOCK | O_CLOEXEC), 0);
+
+        utl::MessagePump::create();
+        utl::Cycler cycler;
+        auto pump = utl::MessagePump::getCurrent();
+
+        // 水平触发：数据未读完时每轮都会通知；在其他线程中写入会唤醒等待中的泵
+        int level_count = 0;
+        std::string received;
+        TEST_TRUE(pump->watchFd(fds[0], utl::MessagePump::FE_READ,
+            [&](int fd, unsigned int events) {
+                if (!(events & utl::MessagePump::FE_READ)) {
+                    return;
+                }
+                ++level_count;
+                char c;
+                if (::read(fd, &c, 1) == 1) {
+                    received.push_back(c);
+                }
+                if (received.size() == 3) {
+                    utl::MessagePump::getCurrent()->unwatch(fd);
+                    utl::MessagePump::quit();
+                }
+            }));
+
+        std::thread writer([&]() {
+            std::this_thread::sleep_for(10ms);
+            auto ret = ::write(fds[1], "abc", 3);
+            (void)ret;
+        });
+        utl::MessagePump::run();
+        writer.join();
+
+        TEST_E(received, std::string("abc"));
+        TEST_E(level_count, 3);
+
+        // 边沿触发：不读取数据也只通知一次；取消监视后不再通知
+        int edge_count = 0;
+        TEST_TRUE(pump->watchFd(fds[0], utl::MessagePump::FE_READ | utl::MessagePump::FE_EDGE,
+            [&](int, unsigned int) { ++edge_count; }));
+        TEST_E(::write(fds[1], "x", 1), 1);
+        cycler.postDelayed([]() { utl::MessagePump::quit(); }, 20ms);
+        utl::MessagePump::run();
+        TEST_E(edge_count, 1);
+
+        pump->unwatch(fds[0]);
+        TEST_E(::write(fds[1], "y", 1), 1);
+        cycler.postDelayed([]() { utl::MessagePump::quit(); }, 10ms);
+        utl::MessagePump::run();
+        TEST_E(edge_count, 1);
+
+        utl::MessagePump::destroy();
+        ::close(fds[0]);
+        ::close(fds[1]);
+        return true;
+    };
+#endif
+
+#ifdef UTL_MESSAGE_STATS
+    TEST_DEF("MessagePump stats tests.") {
+        using namespace std::chrono_literals;
+
+        // 桶的上界不小于落入其中的值，相对误差不超过 1/kSubBuckets
+        for (uint64_t v : { 0ull, 1ull, 31ull, 32ull, 33ull, 1000ull, 123456789ull, 1ull << 40 }) {
+            auto upper = utl::Histogram::bucketUpperBound(utl::Histogram::bucketIndex(v));
+            TEST_TRUE(upper >= v);
+            TEST_TRUE(upper - v <= v / utl::Histogram::kSubBuckets);
+        }
+
+        utl::Histogram h;
+        for (uint64_t v = 1; v <= 1000; ++v) {
+            h.record(v);
+        }
+        auto hs = h.snapshot();
+        TEST_E(hs.count, 1000u);
+        TEST_E(hs.min, 1u);
+        TEST_E(hs.max, 1000u);
+        TEST_E(hs.mean(), 500u);
+        TEST_TRUE(hs.percentile(50) >= 500 && hs.percentile(50) <= 532);
+        TEST_E(hs.percentile(100), 1000u);
+
+        utl::MessagePump::create();
+        utl::Cycler cycler;
+        for (int i = 0; i < 3; ++i) {
+            cycler.post([]() { std::this_thread::sleep_for(2ms); }, 7);
+        }
+        cycler.post([]() { utl::MessagePump::quit(); });
+        utl::MessagePump::run();
+
+        auto stats = utl::MessagePump::getCurrent()->getStats();
+        utl::MessagePump::destroy();
+
+        TEST_E(stats.run_time.count, 4u);
+        TEST_E(stats.queue_delay.count, 4u);
+        TEST_E(stats.depth.count, 1u);
+        TEST_E(stats.depth.max, 4u);
+        TEST_E(stats.run_time_by_id.size(), 2u);
+        TEST_E(stats.run_time_by_id[7].count, 3u);
+        TEST_TRUE(stats.run_time_by_id[7].min >= 2000000u);
+        TEST_E(stats.run_time_by_id[-1].count, 1u);
+        // 最后一个消息至少等待了前三个的执行时间
+        TEST_TRUE(stats.queue_delay.max >= 6000000u);
+        return true;
+    };
+#endif
+
+    TEST_DEF("HangWatchdog tests.") {
+        using namespace std::chrono_literals;
+
+        utl::MessagePump::create();
+        utl::Cycler cycler;
+
+        std::mutex sync;
+        std::vector<utl::HangWatchdog::HangInfo> hangs;
+        utl::HangWatchdog watchdog(20ms, 2ms);
+        watchdog.setHandler([&](const utl::HangWatchdog::HangInfo& info) {
+            std::lock_guard<std::mutex> lk(sync);
+            hangs.push_back(info);
+        });
+        watchdog.watch(utl::MessagePump::getCurrent(), "main");
+
+        // 只有超过阈值的消息会被报告，且只报告一次
+        cycler.post([]() { std::this_thread::sleep_for(1ms); }, 1);
+        cycler.post([]() { std::this_thread::sleep_for(60ms); }, 9);
+        int post_line = __LINE__ - 1;
+        cycler.post([]() { utl::MessagePump::quit(); });
+        utl::MessagePump::run();
+
+        // 泵空闲时不会被报告
+        std::this_thread::sleep_for(30ms);
+        watchdog.unwatch(utl::MessagePump::getCurrent());
+        utl::MessagePump::destroy();
+
+        std::lock_guard<std::mutex> lk(sync);
+        TEST_E(watchdog.getHangCount(), 1u);
+        TEST_E(hangs.size(), 1u);
+        TEST_E(hangs[0].name, std::string("main"));
+        TEST_E(hangs[0].id, 9);
+        TEST_E(hangs[0].from.getLine(), post_line);
+        TEST_TRUE(hangs[0].stalled >= 20ms && hangs[0].stalled < 60ms);
+        return true;
+    };
+
+    TEST_DEF("MessagePump timer slack tests.") {
+        using namespace std::chrono_literals;
+
+        utl::MessagePump::create();
+        utl::Cycler cycler;
+        cycler.setTimerSlack(8ms);
+        TEST_E(cycler.getTimerSlack(), utl::Cycler::ns(8ms));
+
+        // 到期时间分散在 4ms 内的延时消息，对齐后最多落在两个时刻
+        int count = 0;
+        bool early = false;
+        bool immediate_first = false;
+        for (int i = 0; i < 20; ++i) {
+            auto due = utl::Cycler::now() + 1ms + i * 200us;
+            cycler.postAtTime([&, due]() {
+                early |= utl::Cycler::now() < due;
+                if (++count == 20) {
+                    utl::MessagePump::quit();
+                }
+            }, due);
+        }
+
+        // 即时消息不受余量的影响
+        cycler.post([&]() { immediate_first = count == 0; });
+        utl::MessagePump::run();
+
+        auto stats = utl::MessagePump::getCurrent()->getQueue()->getTimerStats();
+        utl::MessagePump::destroy();
+
+        TEST_TRUE(immediate_first);
+        TEST_FALSE(early);
+        TEST_E(count, 20);
+        TEST_E(stats.fired, 20u);
+        TEST_TRUE(stats.wakeups >= 1 && stats.wakeups <= 2);
+        // 最多两个对齐时刻，其余的唤醒都是由余量合并掉的
+        TEST_TRUE(stats.wakeups_saved >= 18u && stats.wakeups_saved <= 19u);
+
+        // 没有余量时，本来就同时到期的消息不算作合并
+        utl::MessagePump::create();
+        utl::Cycler plain;
+        count = 0;
+        auto due = utl::Cycler::now() + 1ms;
+        for (int i = 0; i < 10; ++i) {
+            plain.postAtTime([&]() {
+                if (++count == 10) {
+                    utl::MessagePump::quit();
+                }
+            }, due);
+        }
+        utl::MessagePump::run();
+
+        stats = utl::MessagePump::getCurrent()->getQueue()->getTimerStats();
+        utl::MessagePump::destroy();
+
+        TEST_E(stats.fired, 10u);
+        TEST_E(stats.wakeups, 1u);
+        TEST_E(stats.wakeups_saved, 0u);
+
+        // 在耗时较长的消息中投递的即时消息，即使余量很大也立即执行
+        utl::MessagePump::create();
+        utl::Cycler loose;
+        loose.setTimerSlack(200ms);
+        count = 0;
+        utl::Cycler::ns posted{};
+        utl::Cycler::ns last{};
+        loose.post([&]() {
+            std::this_thread::sleep_for(10ms);
+            posted = utl::Cycler::now();
+            auto done = [&]() {
+                last = utl::Cycler::now();
+                if (++count == 3) {
+                    utl::MessagePump::quit();
+                }
+            };
+            loose.post(done);
+            utl::PostBatch batch(&loose);
+            batch.post(done);
+            batch.postDelayed(done, 0ms);
+        });
+        utl::MessagePump::run();
+        utl::MessagePump::destroy();
+
+        TEST_E(count, 3);
+        TEST_TRUE(last - posted < 50ms);
+        return true;
+    };
+
+    TEST_DEF("MessagePump loop time tests.") {
+        using namespace std::chrono_literals;
+
+        utl::MessagePump::create();
+        utl::Cycler cycler;
+
+        // 不在执行消息时即为当前时间
+        auto before = utl::Cycler::now();
+        auto loop = utl::MessagePump::getLoopTime();
+        TEST_TRUE(loop >= before && loop <= utl::Cycler::now());
+
+        // 同一个消息中多次读取得到相同的值，延时从消息开始执行时算起
+        bool stable = false;
+        bool in_past = false;
+        utl::Cycler::ns started{};
+        utl::Cycler::ns fired{};
+        cycler.post([&]() {
+            started = utl::MessagePump::getLoopTime();
+            std::this_thread::sleep_for(5ms);
+            stable = utl::MessagePump::getLoopTime() == started;
+            in_past = utl::Cycler::now() - started >= 5ms;
+            cycler.postDelayed([&]() {
+                fired = utl::Cycler::now();
+                utl::MessagePump::quit();
+            }, 10ms);
+        });
+        utl::MessagePump::run();
+        utl::MessagePump::destroy();
+
+        TEST_TRUE(stable);
+        TEST_TRUE(in_past);
+        TEST_TRUE(fired - started >= 10ms);
+        TEST_TRUE(fired - started < 15ms + 50ms);
+
+        // 嵌套的消息循环结束后，外层消息的循环时间和心跳保持不变
+        utl::MessagePump::create();
+        utl::Cycler nested;
+        bool outer_time_kept = false;
+        bool outer_beat_kept = false;
+        nested.post([&]() {
+            auto pump = utl::MessagePump::getCurrent();
+            auto outer_time = utl::MessagePump::getLoopTime();
+            utl::PumpHeartbeat::Snapshot outer;
+            pump->getHeartbeat().read(&outer);
+
+            nested.post([]() { utl::MessagePump::quit(); });
+            utl::MessagePump::run();
+
+            utl::PumpHeartbeat::Snapshot beat;
+            outer_beat_kept = pump->getHeartbeat().read(&beat) &&
+                beat.start_ns == outer.start_ns && beat.id == outer.id && beat.start_ns != 0;
+            outer_time_kept = utl::MessagePump::getLoopTime() == outer_time;
+            utl::MessagePump::quit();
+        }, 42);
+        utl::MessagePump::run();
+
+        utl::PumpHeartbeat::Snapshot idle;
+        TEST_TRUE(utl::MessagePump::getCurrent()->getHeartbeat().read(&idle));
+        utl::MessagePump::destroy();
+
+        TEST_TRUE(outer_time_kept);
+        TEST_TRUE(outer_beat_kept);
+        TEST_E(idle.start_ns, int64_t(0));
+
+        // 即时消息以投递时的时间为准，不会因当前消息耗时较长而被当作已等待过久
+        utl::MessagePump::create();
+        utl::Cycler normal;
+        utl::Cycler critical;
+        critical.setPriority(utl::Message::PRI_CRITICAL);
+
+        std::vector<int> order;
+        normal.post([&]() {
+            std::this_thread::sleep_for(
+                utl::MessageQueue::kDefaultNormalAgingLimit + 20ms);
+            normal.post([&order]() { order.push_back(1); });
+            critical.post([&order]() {
+                order.push_back(0);
+                utl::MessagePump::quit();
+            });
+        });
+        utl::MessagePump::run();
+
+        auto stats = utl::MessagePump::getCurrent()->getQueue()->getPriorityStats(
+            utl::Message::PRI_NORMAL);
+        utl::MessagePump::destroy();
+
+        TEST_E(order.size(), 2u);
+        TEST_E(order[0], 0);
+        TEST_E(order[1], 1);
+        TEST_E(stats.aged, 0u);
+        return true;
+    };
+
+    TEST_DEF("PumpThread tests.") {
+        auto cpu = utl::ThreadUtils::getCurrentCpu();
+
+        utl::ThreadOptions options;
+        options.name = "utl-pump";
+        if (cpu >= 0) {
+            options.cpus = { cpu };
+        }
+
+        utl::PumpThread thread(options);
+        TEST_FALSE(thread.getPump().expired());
+
+        // 消息在新线程的泵中执行，且运行在指定的 CPU 上
+        std::promise<void> done;
+        bool on_pump = false;
+        int ran_on = -1;
+        utl::Cycler cycler(thread.getPump());
+        cycler.post([&]() {
+            on_pump = utl::MessagePump::getCurrent() == thread.getPump().lock();
+            ran_on = utl::ThreadUtils::getCurrentCpu();
+            done.set_value();
+        });
+        done.get_future().get();
+
+        TEST_TRUE(on_pump);
+        TEST_E(ran_on, cpu);
+
+        thread.stop();
+        TEST_TRUE(thread.getPump().expired());
+        return true;
+    };
+
+    TEST_DEF("MessagePump foreign handle tests.") {
+        using namespace std::chrono_literals;
+
+        std::atomic<int> count{ 0 };
+        utl::PumpThread thread1;
+        utl::PumpThread thread2;
+        utl::ThreadPool pool(1);
+
+        utl::Cycler cycler(thread1.getPump());
+        utl::Cycler sibling(thread1.getPump());
+        utl::Cycler remote(thread2.getPump());
+
+        auto h = cycler.postDelayed([&count]() { ++count; }, 20ms);
+        auto h_pool = pool.postDelayed([&count]() { count += 10; }, 20ms);
+
+        // 只有投递者能取消消息，其他对象取消时不能改动消息和所在的队列
+        TEST_FALSE(sibling.removeMessage(h));
+        TEST_FALSE(remote.removeMessage(h));
+        TEST_FALSE(pool.removeMessage(h));
+        TEST_FALSE(cycler.removeMessage(h_pool));
+        TEST_FALSE(remote.removeMessage(h_pool));
+        TEST_TRUE(cycler.hasMessage(h));
+        TEST_TRUE(pool.hasMessage(h_pool));
+
+        // 队列的取消计数未被改动，被取消的消息仍能正常回收
+        auto cancelled = cycler.postDelayed([&count]() { count += 100; }, 10ms);
+        TEST_TRUE(cycler.removeMessage(cancelled));
+
+        std::promise<void> done;
+        cycler.postDelayed([&done]() { done.set_value(); }, 40ms);
+        done.get_future().get();
+        pool.shutdown();
+
+        TEST_E(count.load(), 11);
+        TEST_FALSE(cycler.hasMessage(h));
+        TEST_FALSE(pool.hasMessage(h_pool));
+        return true;
+    };
+
+    TEST_DEF("Cycler postBatch() tests.") {
+        using namespace std::chrono_literals;
+
+        utl::MessagePump::create();
+        utl::Cycler cycler;
+
+        std::vector<int> order;
+        {
+            utl::PostBatch batch(&cycler);
+            batch.postDelayed([&]() {
+                order.push_back(100);
+                utl::MessagePump::quit();
+            }, 5ms);
+            for (int i = 0; i < 5; ++i) {
+                batch.post([&order, i]() { order.push_back(i); });
+            }
+            auto removed = batch.post([&]() { order.push_back(-1); });
+            TEST_E(batch.size(), 7u);
+            TEST_TRUE(cycler.removeMessage(removed));
+
+            // 提交之前不在队列中
+            TEST_FALSE(utl::MessagePump::getCurrent()->getQueue()->hasMessages(
+                utl::MessageQueue::ML_NORMAL | utl::MessageQueue::ML_DELAYED));
+            batch.commit();
+            TEST_E(batch.size(), 0u);
+
+            // 析构时自动提交
+            batch.post([&]() { order.push_back(5); });
+        }
+
+        std::vector<std::function<void()>> funcs;
+        for (int i = 6; i < 9; ++i) {
+            funcs.push_back([&order, i]() { order.push_back(i); });
+        }
+        TEST_E(cycler.postBatch(funcs), 3u);
+        TEST_E(funcs.size(), 3u);
+        TEST_TRUE(!!funcs[0]);
+
+        utl::MessagePump::run();
+        utl::MessagePump::destroy();
+
+        TEST_E(order.size(), 10u);
+        for (int i = 0; i < 9; ++i) {
+            TEST_E(order[i], i);
+        }
+        TEST_E(order[9], 100);
+        return true;
+    };
+
+}
@@ -0,0 +1,172 @@
+// Copyright (c) 2016 ucclkp <ucclkp@gmail.com>.
+// This file is part of utils project.
+//
+// This program is licensed under GPLv3 license that can be
+// found in the LICENSE file.
+
+#include <atomic>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "utils/message/cycler.h"
+#include "utils/message/sequenced_cycler.h"
+#include "utils/message/thread_pool.h"
+#include "utils/unit_test/test_collector.h"
+
+
+namespace {
+
+    struct Sequence {
+        explicit Sequence(utl::ThreadPool* pool)
+            : cycler(pool) {}
+
+        utl::SequencedCycler cycler;
+        std::atomic<bool> busy{ false };
+        int last = 0;
+        bool ok = true;
+    };
+
+    class IdListener : public utl::CyclerListener {
+    public:
+        void onHandleMessage(const utl::Message& msg) override {
+            ids.push_back(msg.id);
+        }
+
+        std::vector<int> ids;
+    };
+
+}
+
+TEST_CASE(SequencedCyclerUnitTest) {
+
+    TEST_DEF("SequencedCycler ordering tests.") {
+        constexpr int kSequences = 1000;
+        constexpr int kPerSequence = 50;
+
+        std::atomic<int> remaining{ kSequences * kPerSequence };
+        std::promise<void> done;
+
+        utl::ThreadPool pool(4);
+        std::vector<std::unique_ptr<Sequence>> seqs;
+        for (int i = 0; i < kSequences; ++i) {
+            seqs.emplace_back(new Sequence(&pool));
+        }
+
+        for (int n = 1; n <= kPerSequence; ++n) {
+            for (auto& seq : seqs) {
+                auto s = seq.get();
+                s->cycler.post([s, n, &remaining, &done]() {
+                    // 同一序列的消息不能重叠，且必须按投递顺序执行
+                    if (s->busy.exchange(true) || s->last + 1 != n || !s->cycler.isCurrent()) {
+                        s->ok = false;
+                    }
+                    s->last = n;
+                    s->busy.store(false);
+                    if (remaining.fetch_sub(1) == 1) {
+                        done.set_value();
+                    }
+                });
+            }
+        }
+
+        done.get_future().get();
+        for (auto& seq : seqs) {
+            TEST_TRUE(seq->ok);
+            TEST_E(seq->last, kPerSequence);
+            TEST_FALSE(seq->cycler.isCurrent());
+        }
+        return true;
+    };
+
+    TEST_DEF("SequencedCycler postDelayed() tests.") {
+        using namespace std::chrono_literals;
+
+        std::vector<int> order;
+        std::promise<void> done;
+        IdListener listener;
+
+        utl::ThreadPool pool(2);
+        utl::SequencedCycler cycler(&pool);
+        cycler.setListener(&listener);
+
+        cycler.postDelayed([&order]() { order.push_back(2); }, 20ms);
+        cycler.postDelayed([&order]() { order.push_back(1); }, 10ms);
+        cycler.postDelayed([&order]() { order.push_back(3); }, 20ms);
+        auto h = cycler.postDelayed([&order]() { order.push_back(4); }, 20ms);
+        cycler.postDelayed(7, 15ms);
+        cycler.postDelayed([&order]() { order.push_back(5); }, 20ms, 5);
+        cycler.post([&order]() { order.push_back(0); });
+
+        TEST_TRUE(cycler.hasMessages(5));
+        cycler.removeMessages(5);
+        TEST_FALSE(cycler.hasMessages(5));
+        TEST_TRUE(cycler.removeMessage(h));
+        TEST_FALSE(cycler.hasMessage(h));
+
+        cycler.postDelayed([&done]() { done.set_value(); }, 30ms);
+        done.get_future().get();
+
+        TEST_E(order.size(), 4u);
+        TEST_E(order[0], 0);
+        TEST_E(order[1], 1);
+        TEST_E(order[2], 2);
+        TEST_E(order[3], 3);
+        TEST_E(listener.ids.size(), 1u);
+        TEST_E(listener.ids[0], 7);
+        return true;
+    };
+
+    TEST_DEF("SequencedCycler timer re-arming tests.") {
+        using namespace std::chrono_literals;
+
+        constexpr int kCount = 50;
+        std::vector<int> order;
+        std::promise<void> done;
+
+        utl::ThreadPool pool(2);
+        utl::SequencedCycler cycler(&pool);
+
+        // 按到期时间倒序投递，每次都会取代已投递给线程池的定时任务
+        auto start = utl::SequencedCycler::now();
+        for (int i = kCount; i > 0; --i) {
+            cycler.postAtTime([&order, i]() { order.push_back(i); }, start + i * 1ms + 10ms);
+        }
+
+        // 取消后立即释放捕获的对象
+        auto captured = std::make_shared<int>(0);
+        auto h = cycler.postDelayed([captured]() { ++*captured; }, 1h);
+        TEST_E(captured.use_count(), 2);
+        TEST_TRUE(cycler.removeMessage(h));
+        TEST_E(captured.use_count(), 1);
+
+        cycler.postAtTime([&done]() { done.set_value(); }, start + (kCount + 20) * 1ms);
+        done.get_future().get();
+
+        TEST_E(order.size(), size_t(kCount));
+        for (int i = 0; i < kCount; ++i) {
+            TEST_E(order[i], i + 1);
+        }
+        return true;
+    };
+
+    TEST_DEF("SequencedCycler destruction tests.") {
+        using namespace std::chrono_literals;
+
+        std::atomic<int> count{ 0 };
+        utl::ThreadPool pool(2);
+        {
+            utl::SequencedCycler cycler(&pool);
+            cycler.postDelayed([&count]() { ++count; }, 10ms);
+            for (int i = 0; i < 100; ++i) {
+                cycler.postDelayed([&count]() { ++count; }, 1s);
+            }
+        }
+
+        std::this_thread::sleep_for(30ms);
+        TEST_E(count.load(), 0);
+        return true;
+    };
+
+}
@@ -0,0 +1,231 @@
+// Copyright (c) 2016 ucclkp <ucclkp@gmail.com>.
+// This file is part of utils project.
+//
+// This program is licensed under GPLv3 license that can be
+// found in the LICENSE file.
+
+#include <atomic>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "utils/message/executable.h"
+#include "utils/message/thread_pool.h"
+#include "utils/message/work_stealing_deque.hpp"
+#include "utils/platform_utils.h"
+#include "utils/unit_test/test_collector.h"
+
+#ifdef OS_LINUX
+#include <pthread.h>
+#endif
+
+
+namespace {
+
+    class CountingExec : public utl::Executable {
+    public:
+        void onExecTask(const utl::Message& msg) override {
+            sum.fetch_add(msg.id, std::memory_order_relaxed);
+        }
+
+        std::atomic<int> sum{ 0 };
+    };
+
+    void spawn(utl::ThreadPool* pool, std::atomic<int>* count, int depth) {
+        count->fetch_add(1, std::memory_order_relaxed);
+        if (depth == 0) {
+            return;
+        }
+        pool->post([pool, count, depth]() { spawn(pool, count, depth - 1); });
+        pool->post([pool, count, depth]() { spawn(pool, count, depth - 1); });
+    }
+
+}
+
+TEST_CASE(ThreadPoolUnitTest) {
+
+    TEST_DEF("WorkStealingDeque tests.") {
+        constexpr int kCount = 100000;
+
+        utl::WorkStealingDeque<int> deque(4);
+        std::atomic<bool> done{ false };
+        std::atomic<long long> stolen_sum{ 0 };
+
+        std::vector<std::thread> thieves;
+        for (int i = 0; i < 3; ++i) {
+            thieves.emplace_back([&]() {
+                long long sum = 0;
+                int val;
+                while (!done.load(std::memory_order_acquire) || !deque.empty()) {
+                    if (deque.steal(&val)) {
+                        sum += val;
+                    }
+                }
+                stolen_sum.fetch_add(sum);
+            });
+        }
+
+        long long taken_sum = 0;
+        for (int i = 1; i <= kCount; ++i) {
+            deque.push(i);
+            int val;
+            if (i % 3 == 0 && deque.take(&val)) {
+                taken_sum += val;
+            }
+        }
+        int val;
+        while (deque.take(&val)) {
+            taken_sum += val;
+        }
+        done.store(true, std::memory_order_release);
+
+        for (auto& t : thieves) {
+            t.join();
+        }
+
+        // 每个元素恰好被取出一次
+        TEST_E(taken_sum + stolen_sum.load(), (long long)kCount * (kCount + 1) / 2);
+        return true;
+    };
+
+    TEST_DEF("ThreadPool post() tests.") {
+        constexpr int kCount = 10000;
+
+        std::atomic<int> count{ 0 };
+        CountingExec exec;
+        {
+            utl::ThreadPool pool(4);
+            TEST_E(pool.getThreadCount(), 4u);
+            TEST_FALSE(pool.isWorkerThread());
+
+            for (int i = 0; i < kCount; ++i) {
+                pool.post([&count]() { count.fetch_add(1, std::memory_order_relaxed); });
+            }
+            for (int i = 1; i <= 100; ++i) {
+                pool.post(&exec, i);
+            }
+            // 析构时会执行完所有已到期的消息
+        }
+
+        TEST_E(count.load(), kCount);
+        TEST_E(exec.sum.load(), 5050);
+        return true;
+    };
+
+    TEST_DEF("ThreadPool nested post() tests.") {
+        constexpr int kDepth = 14;
+
+        std::atomic<int> count{ 0 };
+        {
+            utl::ThreadPool pool(4);
+            pool.post([&pool, &count]() {
+                spawn(&pool, &count, kDepth);
+            });
+
+            using namespace std::chrono_literals;
+            while (count.load() < (1 << (kDepth + 1)) - 1) {
+                std::this_thread::sleep_for(1ms);
+            }
+        }
+
+        TEST_E(count.load(), (1 << (kDepth + 1)) - 1);
+        return true;
+    };
+
+    TEST_DEF("ThreadPool postDelayed() tests.") {
+        using namespace std::chrono_literals;
+
+        std::atomic<int> count{ 0 };
+        utl::ThreadPool::ns elapsed(0);
+        std::promise<void> done;
+
+        utl::ThreadPool pool(2);
+        auto start = utl::ThreadPool::now();
+
+        auto h1 = pool.postDelayed([&count]() { ++count; }, 10ms);
+        auto h2 = pool.postDelayed([&count]() { count += 100; }, 10ms);
+        pool.postDelayed([&]() {
+            elapsed = utl::ThreadPool::now() - start;
+            done.set_value();
+        }, 30ms);
+
+        TEST_TRUE(pool.hasMessage(h1));
+        TEST_TRUE(pool.removeMessage(h2));
+        TEST_FALSE(pool.removeMessage(h2));
+        TEST_FALSE(pool.hasMessage(h2));
+
+        // 取消后立即释放捕获的对象，而不是等到原定的到期时间
+        auto captured = std::make_shared<int>(0);
+        std::vector<utl::MessageHandle> handles;
+        for (int i = 0; i < 200; ++i) {
+            handles.push_back(pool.postDelayed([captured]() { ++*captured; }, 1h));
+        }
+        TEST_E(captured.use_count(), 201);
+        for (const auto& h : handles) {
+            TEST_TRUE(pool.removeMessage(h));
+        }
+        TEST_E(captured.use_count(), 1);
+
+        done.get_future().get();
+
+        TEST_E(count.load(), 1);
+        TEST_FALSE(pool.hasMessage(h1));
+        TEST_TRUE(elapsed >= 30ms);
+        return true;
+    };
+
+    TEST_DEF("ThreadPool shutdown() tests.") {
+        using namespace std::chrono_literals;
+
+        std::atomic<int> count{ 0 };
+        utl::ThreadPool pool(2);
+        pool.postDelayed([&count]() { ++count; }, 10s);
+        pool.post([&count]() {
+            std::this_thread::sleep_for(10ms);
+            ++count;
+        });
+        pool.shutdown();
+
+        // 停止后投递的消息被丢弃
+        auto h = pool.post([&count]() { ++count; });
+        TEST_FALSE(pool.hasMessage(h));
+        TEST_E(count.load(), 1);
+        return true;
+    };
+
+#ifdef OS_LINUX
+    TEST_DEF("ThreadPool thread options tests.") {
+        utl::ThreadOptions options;
+        options.name = "utl-pool";
+
+        // 各工作线程的名称带有序号
+        std::mutex sync;
+        std::set<std::string> names;
+        std::atomic<int> count{ 0 };
+        {
+            utl::ThreadPool pool(2, options);
+            for (int i = 0; i < 200; ++i) {
+                pool.post([&]() {
+                    char buf[16] = {};
+                    ::pthread_getname_np(::pthread_self(), buf, sizeof(buf));
+                    std::lock_guard<std::mutex> lk(sync);
+                    names.insert(buf);
+                    ++count;
+                });
+            }
+        }
+
+        TEST_E(count.load(), 200);
+        TEST_FALSE(names.empty());
+        for (const auto& name : names) {
+            TEST_TRUE(name == "utl-pool-0" || name == "utl-pool-1");
+        }
+        return true;
+    };
+#endif
+
+}
@@ -0,0 +1,68 @@
+// Copyright (c) 2016 ucclkp <ucclkp@gmail.com>.
+// This file is part of utils project.
+//
+// This program is licensed under GPLv3 license that can be
+// found in the LICENSE file.
+
+#include <algorithm>
+#include <string>
+#include <thread>
+
+#include "utils/platform_utils.h"
+#include "utils/thread_utils.h"
+#include "utils/unit_test/test_collector.h"
+
+#ifdef OS_LINUX
+#include <pthread.h>
+#endif
+
+
+using namespace utl;
+
+TEST_CASE(ThreadUtilsUnitTest) {
+
+    TEST_DEF("ThreadUtils tests.") {
+        TEST_E(ThreadUtils::getNodeOfCpu(-1), -1);
+        TEST_TRUE(ThreadUtils::getCpusOfNode(-1).empty());
+
+#if defined(OS_WINDOWS) || defined(OS_LINUX)
+        auto cpu = ThreadUtils::getCurrentCpu();
+        TEST_TRUE(cpu >= 0);
+
+        // 绑定到单个 CPU 后一直在该 CPU 上运行；过长的名称会被截断而不是失败
+        bool applied = false;
+        bool stayed = true;
+        std::string name;
+        std::thread worker([&]() {
+            ThreadOptions options;
+            options.name = "utl-test-thread-long";
+            options.cpus = { cpu };
+            applied = ThreadUtils::applyToCurrentThread(options);
+            for (int i = 0; i < 100; ++i) {
+                stayed &= ThreadUtils::getCurrentCpu() == cpu;
+                std::this_thread::yield();
+            }
+#ifdef OS_LINUX
+            char buf[16] = {};
+            ::pthread_getname_np(::pthread_self(), buf, sizeof(buf));
+            name = buf;
+#endif
+        });
+        worker.join();
+
+        TEST_TRUE(applied);
+        TEST_TRUE(stayed);
+#ifdef OS_LINUX
+        TEST_E(name, std::string("utl-test-thread"));
+#endif
+
+        auto node = ThreadUtils::getNodeOfCpu(cpu);
+        if (node >= 0) {
+            auto cpus = ThreadUtils::getCpusOfNode(node);
+            TEST_TRUE(std::find(cpus.begin(), cpus.end(), cpu) != cpus.end());
+        }
+#endif
+        return true;
+    };
+
+}
@@ -0,0 +1,55 @@
+// Copyright (c) 2016 ucclkp <ucclkp@gmail.com>.
+// This file is part of utils project.
+//
+// This program is licensed under GPLv3 license that can be
+// found in the LICENSE file.
+
+#include <chrono>
+#include <thread>
+
+#include "utils/time_utils.h"
+#include "utils/unit_test/test_collector.h"
+
+
+using namespace utl;
+
+TEST_CASE(TimeUtilsUnitTest) {
+
+    TEST_DEF("TimeUtils clock tests.") {
+        using namespace std::chrono_literals;
+
+        // 单调不减
+        auto prev = TimeUtils::upTime();
+        bool monotonic = true;
+        for (int i = 0; i < 10000; ++i) {
+            auto cur = TimeUtils::upTime();
+            monotonic &= cur >= prev;
+            prev = cur;
+        }
+        TEST_TRUE(monotonic);
+
+        auto t0 = TimeUtils::upTime();
+        std::this_thread::sleep_for(5ms);
+        auto t1 = TimeUtils::upTime();
+        TEST_TRUE(t1 - t0 >= 5ms);
+
+        // 粗略时钟与 upTime() 是同一时钟，只是精度较低
+        auto coarse = TimeUtils::coarseUpTime();
+        auto precise = TimeUtils::upTime();
+        TEST_TRUE(coarse <= precise + 1ms);
+        TEST_TRUE(precise - coarse < 50ms);
+
+        // TSC 可能在更早的测试中就已校准，与 upTime() 的偏差会随时间累积，
+        // 因此只比较两者走过的时长
+        auto fast0 = TimeUtils::fastUpTime();
+        auto precise0 = TimeUtils::upTime();
+        std::this_thread::sleep_for(5ms);
+        auto fast1 = TimeUtils::fastUpTime();
+        auto precise1 = TimeUtils::upTime();
+        auto diff = (fast1 - fast0) - (precise1 - precise0);
+        TEST_TRUE(fast1 - fast0 >= 4ms && fast1 - fast0 < 100ms);
+        TEST_TRUE(diff < 500us && diff > -500us);
+        return true;
+    };
+
+}
@@ -0,0 +1,170 @@
+// Copyright (c) 2016 ucclkp <ucclkp@gmail.com>.
+// This file is part of utils project.
+//
+// This program is licensed under GPLv3 license that can be
+// found in the LICENSE file.
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "utils/message/message.h"
+#include "utils/message/timer_queue.h"
+#include "utils/unit_test/test_collector.h"
+
+
+namespace {
+
+    std::vector<std::unique_ptr<utl::TimerQueue>> createTimerQueues() {
+        std::vector<std::unique_ptr<utl::TimerQueue>> queues;
+        queues.emplace_back(new utl::TimerList());
+        queues.emplace_back(new utl::TimerBinaryHeap());
+        queues.emplace_back(new utl::TimerQuaternaryHeap());
+        queues.emplace_back(new utl::TimerWheel(1));
+        queues.emplace_back(new utl::TimerWheel(1000));
+        queues.emplace_back(new utl::TimerWheel(1000000));
+        return queues;
+    }
+
+    utl::Message* makeMessage(uint64_t time_ns, int id) {
+        auto msg = utl::Message::get();
+        msg->time_ns = time_ns;
+        msg->id = id;
+        return msg;
+    }
+
+}
+
+TEST_CASE(TimerQueueUnitTest) {
+
+    TEST_DEF("TimerQueue order tests.") {
+        std::mt19937_64 rng(42);
+        std::vector<std::pair<uint64_t, int>> expected;
+        for (int i = 0; i < 5000; ++i) {
+            // 较小的取值范围用来制造大量相同时间的消息
+            uint64_t t = 1700000000000000000ull + rng() % 20000000;
+            expected.push_back({ t, i });
+        }
+
+        auto sorted = expected;
+        std::stable_sort(
+            sorted.begin(), sorted.end(),
+            [](const auto& l, const auto& r) { return l.first < r.first; });
+
+        for (auto& q : createTimerQueues()) {
+            for (auto& e : expected) {
+                q->push(makeMessage(e.first, e.second));
+            }
+            TEST_E(q->size(), expected.size());
+
+            for (auto& e : sorted) {
+                auto msg = q->top();
+                TEST_TRUE(msg != nullptr);
+                TEST_E(msg->time_ns, e.first);
+                TEST_E(msg->id, e.second);
+                q->pop();
+                msg->reset();
+            }
+            TEST_TRUE(q->empty());
+            TEST_TRUE(q->top() == nullptr);
+        }
+        return true;
+    };
+
+    TEST_DEF("TimerQueue zero time tests.") {
+        // 时间为 0 的消息同样按放入的先后顺序取出
+        for (auto& q : createTimerQueues()) {
+            q->push(makeMessage(0, 0));
+            q->push(makeMessage(5, 1));
+            q->push(makeMessage(0, 2));
+            q->push(makeMessage(0, 3));
+
+            for (int id : { 0, 2, 3, 1 }) {
+                auto msg = q->top();
+                TEST_TRUE(msg != nullptr);
+                TEST_E(msg->id, id);
+                q->pop();
+                msg->reset();
+            }
+            TEST_TRUE(q->empty());
+        }
+        return true;
+    };
+
+    TEST_DEF("TimerQueue interleaved push/pop tests.") {
+        for (auto& q : createTimerQueues()) {
+            std::mt19937_64 rng(7);
+            uint64_t now = 1000000000;
+            int id = 0;
+            std::vector<std::pair<uint64_t, int>> pending;
+
+            for (int round = 0; round < 2000; ++round) {
+                int count = int(rng() % 4);
+                for (int i = 0; i < count; ++i) {
+                    uint64_t t = now + rng() % 5000000000ull;
+                    q->push(makeMessage(t, id));
+                    pending.push_back({ t, id });
+                    ++id;
+                }
+
+                now += rng() % 5000000;
+                for (;;) {
+                    auto msg = q->top();
+                    if (!msg || msg->time_ns > now) {
+                        break;
+                    }
+
+                    auto it = std::min_element(
+                        pending.begin(), pending.end(),
+                        [](const auto& l, const auto& r) {
+                            return l.first < r.first ||
+                                (l.first == r.first && l.second < r.second);
+                        });
+                    TEST_TRUE(it != pending.end());
+                    TEST_E(msg->id, it->second);
+                    pending.erase(it);
+
+                    q->pop();
+                    msg->reset();
+                }
+            }
+            TEST_E(q->size(), pending.size());
+        }
+        return true;
+    };
+
+    TEST_DEF("TimerQueue extract() tests.") {
+        for (auto& q : createTimerQueues()) {
+            for (int i = 0; i < 1000; ++i) {
+                q->push(makeMessage(1000000ull * (1000 - i), i));
+            }
+
+            auto is_odd = [](const utl::Message& m) { return m.id % 2 != 0; };
+            TEST_TRUE(q->contains(is_odd));
+
+            size_t removed = 0;
+            auto msg = q->extract(is_odd);
+            while (msg) {
+                auto next = msg->next;
+                TEST_TRUE(is_odd(*msg));
+                msg->reset();
+                msg = next;
+                ++removed;
+            }
+            TEST_E(removed, 500u);
+            TEST_E(q->size(), 500u);
+            TEST_FALSE(q->contains(is_odd));
+
+            uint64_t last = 0;
+            while (auto top = q->top()) {
+                TEST_TRUE(top->time_ns >= last);
+                last = top->time_ns;
+                q->pop();
+                top->reset();
+            }
+        }
+        return true;
+    };
+
+}
@@ -0,0 +1,146 @@
+// Copyright (c) 2016 ucclkp <ucclkp@gmail.com>.
+// This file is part of utils project.
+//
+// This program is licensed under GPLv3 license that can be
+// found in the LICENSE file.
+
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "utils/message/cycler.h"
+#include "utils/message/location.hpp"
+#include "utils/message/message_pump.h"
+#include "utils/message/trace_log.h"
+#include "utils/unit_test/test_collector.h"
+
+
+namespace {
+
+    size_t countOf(const std::string& str, const std::string& sub) {
+        size_t count = 0;
+        for (auto pos = str.find(sub); pos != std::string::npos; pos = str.find(sub, pos + 1)) {
+            ++count;
+        }
+        return count;
+    }
+
+    // 取得包含 sub 的事件所在的 tid，没有则返回 -1。
+    int tidOf(const std::string& json, const std::string& sub) {
+        auto pos = json.find(sub);
+        if (pos == std::string::npos) {
+            return -1;
+        }
+        auto begin = json.rfind("\"tid\":", pos);
+        if (begin == std::string::npos) {
+            return -1;
+        }
+        return std::stoi(json.substr(begin + 6));
+    }
+
+    utl::Location here(const utl::Location& loc = utl::Location::current()) {
+        return loc;
+    }
+
+}
+
+TEST_CASE(TraceLogUnitTest) {
+
+    TEST_DEF("Location tests.") {
+        auto loc = here();
+        TEST_FALSE(loc.isNull());
+        TEST_E(loc.getLine(), __LINE__ - 2);
+        TEST_TRUE(std::string(loc.getFile()).find("trace_log_unit_test") != std::string::npos);
+        TEST_TRUE(utl::Location().isNull());
+        TEST_E(std::string(utl::Location().getFile()), std::string());
+        return true;
+    };
+
+    TEST_DEF("TraceLog export tests.") {
+        utl::TraceLog::clear();
+        utl::TraceLog::setEnabled(true);
+
+        utl::MessagePump::create();
+        utl::Cycler cycler;
+        cycler.post([]() {}, 42);
+        int post_line = __LINE__ - 1;
+        cycler.post([]() { utl::MessagePump::quit(); });
+        utl::MessagePump::run();
+        utl::MessagePump::destroy();
+
+        utl::TraceLog::setEnabled(false);
+
+        std::ostringstream ss;
+        utl::TraceLog::exportJSON(ss);
+        auto json = ss.str();
+
+        // 两次投递各有一个流的起点和终点，两次执行各有开始和结束
+        TEST_E(countOf(json, "\"ph\":\"s\""), 2u);
+        TEST_E(countOf(json, "\"ph\":\"f\""), 2u);
+        TEST_E(countOf(json, "\"ph\":\"B\""), 2u);
+        TEST_E(countOf(json, "\"ph\":\"E\""), 2u);
+        TEST_TRUE(json.find("\"line\":" + std::to_string(post_line) + ",\"id\":42") != std::string::npos);
+        TEST_TRUE(json.find("trace_log_unit_test") != std::string::npos);
+        TEST_E(json.front(), '{');
+
+        // 清除之后不再导出，关闭时不再记录
+        utl::TraceLog::clear();
+        utl::TraceLog::addEvent(utl::TraceLog::PH_BEGIN, here(), 0, 0, 0);
+        ss.str(std::string());
+        utl::TraceLog::exportJSON(ss);
+        TEST_E(countOf(ss.str(), "\"ph\""), 0u);
+        return true;
+    };
+
+    TEST_DEF("TraceLog ring buffer tests.") {
+        utl::TraceLog::clear();
+        utl::TraceLog::setBufferCapacity(8);
+
+        // 新线程使用新的容量，写满后只保留最新的事件
+        std::thread worker([]() {
+            auto now = utl::Cycler::now().count();
+            for (int i = 0; i < 20; ++i) {
+                utl::TraceLog::addEvent(utl::TraceLog::PH_FLOW_START, here(), 1000 + i, i, now + i);
+            }
+        });
+        worker.join();
+        utl::TraceLog::setBufferCapacity(utl::TraceLog::kDefaultBufferCapacity);
+
+        std::ostringstream ss;
+        utl::TraceLog::exportJSON(ss);
+        auto json = ss.str();
+        TEST_E(countOf(json, "\"ph\":\"s\""), 8u);
+        TEST_TRUE(json.find("\"id\":1011}") == std::string::npos);
+        TEST_TRUE(json.find("\"id\":1012}") != std::string::npos);
+        TEST_TRUE(json.find("\"id\":1019}") != std::string::npos);
+        return true;
+    };
+
+    TEST_DEF("TraceLog buffer reuse tests.") {
+        utl::TraceLog::clear();
+
+        // 先后退出的线程复用同一个缓冲区，已退出线程的事件在复用之前仍可导出
+        auto now = utl::Cycler::now().count();
+        for (int i = 0; i < 5; ++i) {
+            std::thread worker([now, i]() {
+                utl::TraceLog::addEvent(utl::TraceLog::PH_FLOW_START, here(), 2000 + i, i, now + i);
+            });
+            worker.join();
+
+            std::ostringstream ss;
+            utl::TraceLog::exportJSON(ss);
+            TEST_TRUE(tidOf(ss.str(), "\"id\":" + std::to_string(2000 + i) + "}") > 0);
+        }
+
+        std::ostringstream ss;
+        utl::TraceLog::exportJSON(ss);
+        auto json = ss.str();
+        auto tid = tidOf(json, "\"id\":2000}");
+        TEST_TRUE(tid > 0);
+        for (int i = 1; i < 5; ++i) {
+            TEST_E(tidOf(json, "\"id\":" + std::to_string(2000 + i) + "}"), tid);
+        }
+        return true;
+    };
+
+}
@@ -7,41 +7,137 @@
 #include "utils/json/json_parser.h"
 
 #include <cmath>
+#include <cstring>
 
-#include "utils/stream_utils.h"
 #include "utils/strings/int_conv.hpp"
 #include "utils/strings/float_conv.h"
 #include "utils/strings/utfccpp.h"
 
 
-namespace utl {
+namespace {
 
-    JSONParser::JSONParser() {
+    bool isWhitespace(char ch) {
+        return ch == ' ' || ch == '\r' || ch == '\n' || ch == '\t';
     }
 
-    bool JSONParser::parse(std::istream& s, ValuePtr* v) {
+    // 从流中读出一个完整的顶层对象或数组的文本，只根据括号和字符串的边界判断结束位置，
+    // 不读取其后的数据，也不会为等待流结束而阻塞。遇到流末尾时返回 false。
+    bool readText(std::istream& s, std::string* buf) {
+        auto sb = s.rdbuf();
+        auto next = [&](char* ch) {
+            auto c = sb->sbumpc();
+            if (c == std::char_traits<char>::eof()) {
+                s.setstate(std::ios::eofbit | std::ios::failbit);
+                return false;
+            }
+            *ch = char(c);
+            buf->push_back(*ch);
+            return true;
+        };
+
         char ch;
-        PEEK_STREAM(ch);
+        if (!next(&ch)) return false;
         if (uint8_t(ch) == 0xEF) {
-            SKIP_BYTES(1);
-            GET_STREAM(ch);
-            if (uint8_t(ch) != 0xBB) RET_FALSE;
-            GET_STREAM(ch);
-            if (uint8_t(ch) != 0xBF) RET_FALSE;
+            if (!next(&ch) || !next(&ch) || !next(&ch)) return false;
+        }
+        // 不是对象或数组时交给解析器报错
+        if (ch != '{' && ch != '[') {
+            return true;
+        }
+
+        int depth = 1;
+        bool in_string = false;
+        while (depth > 0) {
+            if (!next(&ch)) return false;
+            if (in_string) {
+                if (ch == '\\') {
+                    if (!next(&ch)) return false;
+                } else if (ch == '"') {
+                    in_string = false;
+                }
+            } else if (ch == '"') {
+                in_string = true;
+            } else if (ch == '{' || ch == '[') {
+                ++depth;
+            } else if (ch == '}' || ch == ']') {
+                --depth;
+            }
+        }
+        return true;
+    }
+
+    // 将连续的 \uXXXX 转换为 UTF-8 后追加到 str 中。
+    void flushUTF16(std::u16string* u16_str, std::string* str) {
+        if (u16_str->empty()) {
+            return;
+        }
+
+        std::string buf;
+        if (utl::utf16_to_utf8(*u16_str, &buf, UTFCF_CHK) == 0) {
+            str->append(buf);
+        }
+        u16_str->clear();
+    }
+
+}
+
+namespace utl {
+
+    JSONParser::JSONParser()
+        : cur_(nullptr),
+          end_(nullptr) {
+    }
+
+    bool JSONParser::parse(std::istream& s, ValuePtr* v) {
+        if (!s) {
+            return false;
+        }
+
+        auto start = s.tellg();
+        std::string buf;
+        if (!readText(s, &buf) || !parse(buf, v)) {
+            // 无法定位的流（管道等）中已读出的数据不能退回
+            if (start != std::istream::pos_type(-1)) {
+                s.clear();
+                s.seekg(start);
+            }
+            return false;
+        }
+        return true;
+    }
+
+    bool JSONParser::parse(const std::string_view& str, ValuePtr* v) {
+        return parse(str.data(), str.size(), v);
+    }
+
+    bool JSONParser::parse(const char* buf, size_t len, ValuePtr* v) {
+        cur_ = buf;
+        end_ = buf + len;
+
+        if (cur_ == end_) return false;
+        if (uint8_t(*cur_) == 0xEF) {
+            if (end_ - cur_ < 3 ||
+                uint8_t(cur_[1]) != 0xBB ||
+                uint8_t(cur_[2]) != 0xBF)
+            {
+                return false;
+            }
+            cur_ += 3;
         }
 
-        GET_STREAM(ch);
+        if (cur_ == end_) return false;
+        char ch = *cur_++;
         if (ch == '{') {
             // object
             json::ObjectValue* obj_val;
-            if (!parseObject(s, &obj_val)) {
+            if (!parseObject(&obj_val)) {
                 return false;
             }
             v->reset(obj_val);
         } else if (ch == '[') {
             // array
             json::ArrayValue* arr_val;
-            if (!parseArray(s, &arr_val)) {
+            if (!parseArray(&arr_val)) {
                 return false;
             }
             v->reset(arr_val);
@@ -52,37 +148,42 @@ namespace utl {
         return true;
     }
 
-    bool JSONParser::parseObject(std::istream& s, json::ObjectValue** v) {
-        if (!eatWhitespace(s)) return false;
+    bool JSONParser::parseObject(json::ObjectValue** v) {
+        eatWhitespace();
 
-        GET_STREAM(char ch);
+        if (cur_ == end_) return false;
+        char ch = *cur_++;
         auto obj_val = std::make_unique<json::ObjectValue>();
         if (ch != '}') {
+            std::string buf;
             for (;;) {
                 if (ch != '"') return false;
 
-                std::string str_val;
-                if (!parseString(s, &str_val)) {
+                std::string_view key;
+                if (!parseString(&key, &buf)) {
                     return false;
                 }
 
-                if (!eatWhitespace(s)) return false;
-                GET_STREAM(ch);
+                eatWhitespace();
+                if (cur_ == end_) return false;
+                ch = *cur_++;
 
                 if (ch != ':') {
                     return false;
                 }
 
                 json::Value* val;
-                if (!parseValue(s, &val)) {
+                if (!parseValue(&val)) {
                     return false;
                 }
-                obj_val->put(str_val, val);
+                obj_val->put(key, val);
 
-                GET_STREAM(ch);
+                if (cur_ == end_) return false;
+                ch = *cur_++;
                 if (ch == ',') {
-                    if (!eatWhitespace(s)) return false;
-                    GET_STREAM(ch);
+                    eatWhitespace();
+                    if (cur_ == end_) return false;
+                    ch = *cur_++;
                 } else {
                     break;
                 }
@@ -97,23 +198,24 @@ namespace utl {
         return true;
     }
 
-    bool JSONParser::parseArray(std::istream& s, json::ArrayValue** v) {
-        if (!eatWhitespace(s)) return false;
+    bool JSONParser::parseArray(json::ArrayValue** v) {
+        eatWhitespace();
 
-        char ch;
-        PEEK_STREAM(ch);
+        if (cur_ == end_) return false;
         auto array_val = std::make_unique<json::ArrayValue>();
-        if (ch != ']') {
+        if (*cur_ != ']') {
+            char ch = 0;
             for (;;) {
                 json::Value* val;
-                if (!parseValue(s, &val)) {
+                if (!parseValue(&val)) {
                     return false;
                 }
                 array_val->put(val);
 
-                GET_STREAM(ch);
+                if (cur_ == end_) return false;
+                ch = *cur_++;
                 if (ch == ',') {
-                    if (!eatWhitespace(s)) return false;
+                    eatWhitespace();
                 } else {
                     break;
                 }
@@ -123,143 +225,122 @@ namespace utl {
                 return false;
             }
         } else {
-            SKIP_BYTES(1);
+            ++cur_;
         }
 
         *v = array_val.release();
         return true;
     }
 
-    bool JSONParser::parseValue(std::istream& s, json::Value** v) {
-        if (!eatWhitespace(s)) return false;
+    bool JSONParser::parseValue(json::Value** v) {
+        eatWhitespace();
 
-        int tmp;
-        PEEK_STREAM(char ch);
+        if (cur_ == end_) return false;
+        char ch = *cur_;
         if (ch == '"') {
-            SKIP_BYTES(1);
+            ++cur_;
             // string
-            std::string str_val;
-            if (!parseString(s, &str_val)) {
+            std::string_view str_val;
+            std::string buf;
+            if (!parseString(&str_val, &buf)) {
                 return false;
             }
             *v = new json::StringValue(str_val);
         } else if (ch == '{') {
-            SKIP_BYTES(1);
+            ++cur_;
             // object
             json::ObjectValue* obj_val;
-            if (!parseObject(s, &obj_val)) {
+            if (!parseObject(&obj_val)) {
                 return false;
             }
             *v = obj_val;
         } else if (ch == '[') {
-            SKIP_BYTES(1);
+            ++cur_;
             // array
             json::ArrayValue* array_obj;
-            if (!parseArray(s, &array_obj)) {
+            if (!parseArray(&array_obj)) {
                 return false;
             }
             *v = array_obj;
-        } else if ((tmp = startWith(s, "true")) != 0) {
-            if (tmp == -1) return false;
+        } else if (startWith("true")) {
             // true;
             *v = new json::BoolValue(true);
-        } else if ((tmp = startWith(s, "false")) != 0) {
-            if (tmp == -1) return false;
+        } else if (startWith("false")) {
             // false;
             *v = new json::BoolValue(false);
-        } else if ((tmp = startWith(s, "null")) != 0) {
-            if (tmp == -1) return false;
+        } else if (startWith("null")) {
             // null;
             *v = new json::NullValue();
         } else {
             // may be number
             json::Value* num_val;
-            if (!parseNumber(s, &num_val)) {
+            if (!parseNumber(&num_val)) {
                 return false;
             }
             *v = num_val;
         }
 
-        if (!eatWhitespace(s)) return false;
+        eatWhitespace();
         return true;
     }
 
-    bool JSONParser::parseNumber(std::istream& s, json::Value** v) {
-        std::string str;
+    bool JSONParser::parseNumber(json::Value** v) {
+        auto start = cur_;
         bool is_frac = false;
-        GET_STREAM(char ch);
-        if (ch == '-') {
-            str.push_back('-');
-            GET_STREAM(ch);
+        if (cur_ != end_ && *cur_ == '-') {
+            ++cur_;
         }
 
         // integer
-        if (ch != '0') {
-            if (!utl::isdigit(ch, 10)) return false;
-            str.push_back(ch);
-            for (;;) {
-                PEEK_STREAM(ch);
-                if (!utl::isdigit(ch, 10)) break;
-                str.push_back(ch);
-                SKIP_BYTES(1);
+        if (cur_ == end_) return false;
+        if (*cur_ != '0') {
+            if (!utl::isdigit(*cur_, 10)) return false;
+            ++cur_;
+            while (cur_ != end_ && utl::isdigit(*cur_, 10)) {
+                ++cur_;
             }
         } else {
-            str.push_back(ch);
-            PEEK_STREAM(ch);
+            ++cur_;
         }
 
         // fraction
-        if (ch == '.') {
+        if (cur_ != end_ && *cur_ == '.') {
             is_frac = true;
-            str.push_back(ch);
-            SKIP_BYTES(1);
-            PEEK_STREAM(ch);
-            if (!utl::isdigit(ch, 10)) return false;
-            str.push_back(ch);
-            SKIP_BYTES(1);
-            for (;;) {
-                PEEK_STREAM(ch);
-                if (!utl::isdigit(ch, 10)) break;
-                str.push_back(ch);
-                SKIP_BYTES(1);
+            ++cur_;
+            if (cur_ == end_ || !utl::isdigit(*cur_, 10)) return false;
+            ++cur_;
+            while (cur_ != end_ && utl::isdigit(*cur_, 10)) {
+                ++cur_;
             }
         }
 
         // exponent
-        std::string exp_str;
-        if (ch == 'e' || ch == 'E') {
+        if (cur_ != end_ && (*cur_ == 'e' || *cur_ == 'E')) {
             is_frac = true;
-            //str.push_back(ch);
-            SKIP_BYTES(1);
-            PEEK_STREAM(ch);
-
-            if (ch == '+' || ch == '-') {
-                exp_str.push_back(ch);
-                SKIP_BYTES(1);
-                PEEK_STREAM(ch);
+            ++cur_;
+            if (cur_ != end_ && (*cur_ == '+' || *cur_ == '-')) {
+                ++cur_;
             }
 
-            if (!utl::isdigit(ch, 10)) return false;
-            exp_str.push_back(ch);
-            SKIP_BYTES(1);
-            for (;;) {
-                PEEK_STREAM(ch);
-                if (!utl::isdigit(ch, 10)) break;
-                exp_str.push_back(ch);
-                SKIP_BYTES(1);
+            if (cur_ == end_ || !utl::isdigit(*cur_, 10)) return false;
+            ++cur_;
+            while (cur_ != end_ && utl::isdigit(*cur_, 10)) {
+                ++cur_;
             }
         }
 
+        // 数字的文本就在输入中，直接转换
+        size_t len = cur_ - start;
         if (is_frac) {
             double result;
-            int ret = utl::stof(str, &result, FCF_SCI);
+            int ret = utl::stof(start, len, &result, FCF_SCI);
             if (ret != SCR_OK) {
                 return false;
             }
             *v = new json::DoubleValue(result);
         } else {
             int64_t result;
-            if (!utl::stoi(str, &result)) {
+            if (!utl::stoi(start, len, &result)) {
                 return false;
             }
             *v = new json::IntegerValue(result);
@@ -268,94 +349,94 @@ namespace utl {
         return true;
     }
 
-    bool JSONParser::parseString(std::istream& s, std::string* val) {
-        std::string str;
+    bool JSONParser::parseString(std::string_view* val, std::string* buf) {
+        // 不含转义字符时，直接引用输入中的数据
+        auto start = cur_;
+        for (;;) {
+            if (cur_ == end_) return false;
+            char ch = *cur_;
+            if (ch == '"') {
+                *val = std::string_view(start, cur_ - start);
+                ++cur_;
+                return true;
+            }
+            if (ch == '\\') {
+                break;
+            }
+            ++cur_;
+        }
+
+        buf->assign(start, cur_);
         std::u16string u16_str;
 
-        GET_STREAM(char ch);
         for (;;) {
+            if (cur_ == end_) return false;
+            char ch = *cur_++;
             if (ch == '\\') {
-                GET_STREAM(ch);
-                if (ch != 'u' && !u16_str.empty()) {
-                    std::string buf;
-                    if (utf16_to_utf8(u16_str, &buf, UTFCF_CHK) == 0) {
-                        str.append(buf);
-                    }
-                    u16_str.clear();
+                if (cur_ == end_) return false;
+                ch = *cur_++;
+                if (ch != 'u') {
+                    flushUTF16(&u16_str, buf);
                 }
 
                 switch (ch) {
-                case '"': str.push_back('\"'); break;
-                case '\\': str.push_back('\\'); break;
-                case '/': str.push_back('/'); break;
-                case 'b': str.push_back('\b'); break;
-                case 'f': str.push_back('\f'); break;
-                case 'n': str.push_back('\n'); break;
-                case 'r': str.push_back('\r'); break;
-                case 't': str.push_back('\t'); break;
+                case '"': buf->push_back('\"'); break;
+                case '\\': buf->push_back('\\'); break;
+                case '/': buf->push_back('/'); break;
+                case 'b': buf->push_back('\b'); break;
+                case 'f': buf->push_back('\f'); break;
+                case 'n': buf->push_back('\n'); break;
+                case 'r': buf->push_back('\r'); break;
+                case 't': buf->push_back('\t'); break;
                 case 'u':
                 {
-                    uint_fast16_t code = 0;
-
                     // To UTF-16 LE
-                    GET_STREAM(ch);
-                    if (!utl::isdigit(ch, 16)) return false;
-                    code |= uint_fast16_t(utl::ctoi(ch)) << 12;
-
-                    GET_STREAM(ch);
-                    if (!utl::isdigit(ch, 16)) return false;
-                    code |= uint_fast16_t(utl::ctoi(ch)) << 8;
-
-                    GET_STREAM(ch);
-                    if (!utl::isdigit(ch, 16)) return false;
-                    code |= uint_fast16_t(utl::ctoi(ch)) << 4;
-
-                    GET_STREAM(ch);
-                    if (!utl::isdigit(ch, 16)) return false;
-                    code |= uint_fast16_t(utl::ctoi(ch)) << 0;
+                    if (end_ - cur_ < 4) return false;
+                    uint_fast16_t code = 0;
+                    for (int i = 0; i < 4; ++i) {
+                        if (!utl::isdigit(cur_[i], 16)) return false;
+                        code = (code << 4) | uint_fast16_t(utl::ctoi(cur_[i]));
+                    }
+                    cur_ += 4;
 
                     u16_str.push_back(code);
                     break;
                 }
                 default: return false;
                 }
-                GET_STREAM(ch);
-            } else if (ch == '"') {
-                if (!u16_str.empty()) {
-                    std::string buf;
-                    if (utf16_to_utf8(u16_str, &buf, UTFCF_CHK) == 0) {
-                        str.append(buf);
-                    }
-                    u16_str.clear();
-                }
-                break;
             } else {
-                if (!u16_str.empty()) {
-                    std::string buf;
-                    if (utf16_to_utf8(u16_str, &buf, UTFCF_CHK) == 0) {
-                        str.append(buf);
-                    }
-                    u16_str.clear();
+                flushUTF16(&u16_str, buf);
+                if (ch == '"') {
+                    break;
                 }
 
-                str.push_back(ch);
-                GET_STREAM(ch);
+                // 一次追加到下一个转义字符或引号之前的所有字符
+                auto run = cur_ - 1;
+                while (cur_ != end_ && *cur_ != '"' && *cur_ != '\\') {
+                    ++cur_;
+                }
+                buf->append(run, cur_);
             }
         }
 
-        *val = std::move(str);
+        *val = *buf;
         return true;
     }
 
-    bool JSONParser::eatWhitespace(std::istream& s) {
-        for (;;) {
-            PEEK_STREAM(char ch);
-            if (ch != ' ' && ch != '\r' && ch != '\n' && ch != '\t') {
-                break;
-            }
-            SKIP_BYTES(1);
+    bool JSONParser::startWith(const std::string_view& str) {
+        if (size_t(end_ - cur_) < str.size() ||
+            std::memcmp(cur_, str.data(), str.size()) != 0)
+        {
+            return false;
         }
+        cur_ += str.size();
         return true;
     }
 
+    void JSONParser::eatWhitespace() {
+        while (cur_ != end_ && isWhitespace(*cur_)) {
+            ++cur_;
+        }
+    }
+
 }
@@ -7,8 +7,10 @@
 #ifndef UTILS_JSON_JSON_PARSER_H_
 #define UTILS_JSON_JSON_PARSER_H_
 
+#include <istream>
 #include <memory>
 #include <string>
+#include <string_view>
 
 #include "utils/json/json_structs.h"
 
@@ -26,15 +28,32 @@ namespace utl {
 
         JSONParser();
 
+        /**
+         * 从流的当前位置读出一个完整的顶层对象或数组后解析，不读取其后的数据。
+         * 成功时流停在 JSON 结束的位置。失败时，可定位的流会回到开始的位置；
+         * 管道等无法定位的流中已读出的数据不会退回。
+         */
         bool parse(std::istream& s, ValuePtr* v);
 
+        /**
+         * 直接在连续的内存上解析，不需要以 0 结尾。
+         * 不含转义字符的字符串直接从输入构造，不经过中间缓冲。
+         */
+        bool parse(const std::string_view& str, ValuePtr* v);
+        bool parse(const char* buf, size_t len, ValuePtr* v);
+
     private:
-        bool parseObject(std::istream& s, json::ObjectValue** v);
-        bool parseArray(std::istream& s, json::ArrayValue** v);
-        bool parseValue(std::istream& s, json::Value** v);
-        bool parseNumber(std::istream& s, json::Value** v);
-        bool parseString(std::istream& s, std::string* val);
-        bool eatWhitespace(std::istream& s);
+        bool parseObject(json::ObjectValue** v);
+        bool parseArray(json::ArrayValue** v);
+        bool parseValue(json::Value** v);
+        bool parseNumber(json::Value** v);
+        bool parseString(std::string_view* val, std::string* buf);
+        bool startWith(const std::string_view& str);
+        void eatWhitespace();
+
+        // 正在解析的数据，cur_ 为当前位置
+        const char* cur_;
+        const char* end_;
     };
 
 }
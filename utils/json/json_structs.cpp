@@ -215,7 +215,7 @@ namespace json {
     ObjectValue::ObjectValue() {}
 
     ObjectValue::~ObjectValue() {
-        for (auto pair : map_) {
+        for (const auto& pair : map_) {
             delete pair.second;
         }
     }
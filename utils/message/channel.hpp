@@ -0,0 +1,410 @@
+// Copyright (c) 2016 ucclkp <ucclkp@gmail.com>.
+// This file is part of utils project.
+//
+// This program is licensed under GPLv3 license that can be
+// found in the LICENSE file.
+
+#ifndef UTILS_MESSAGE_CHANNEL_HPP_
+#define UTILS_MESSAGE_CHANNEL_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "utils/message/future.hpp"
+#include "utils/message/message.h"
+#include "utils/message/message_pump.h"
+
+
+namespace utl {
+
+    enum ChannelMode {
+        CHANNEL_SPSC,  // 只有一个发送线程
+        CHANNEL_MPSC,  // 可以有多个发送线程
+    };
+
+    /**
+     * 有界的、带类型的通道，用于在线程（泵）之间传递大量数据。
+     * 数据存放在预先分配的环形缓冲区中，发送时不需要为每一项分配消息或 shared_ptr。
+     * 接收端通过 bind() 绑定到某个泵后，通道从空变为非空时才向该泵投递一个消息，
+     * 该消息一次取出多项交给 handler，因此连续发送不会造成大量的唤醒。
+     * 也可以不绑定，由接收线程自行调用 tryReceive()。
+     *
+     * 通道满时 trySend() 返回 false，发送端可以通过 whenWritable() 在腾出一半空间后得到通知，
+     * 再继续发送。
+     *
+     * 接收相关的方法（bind()、unbind()、tryReceive()）只能在同一个线程中调用，
+     * 通道应在该线程中销毁，且销毁前发送端不能再访问它。
+     */
+    template <typename T, ChannelMode Mode = CHANNEL_MPSC>
+    class Channel {
+    public:
+        using Handler = std::function<void(T&&)>;
+
+        /**
+         * @param capacity 容量，会向上取为 2 的幂。
+         */
+        explicit Channel(size_t capacity)
+            : state_(std::make_shared<State>(capacity)) {}
+
+        ~Channel() {
+            close();
+            unbind();
+        }
+
+        Channel(const Channel&) = delete;
+        Channel& operator=(const Channel&) = delete;
+
+        /**
+         * 在当前线程的泵中接收数据，当前线程必须有 MessagePump。
+         * 已在通道中的数据随后也会交给 handler。
+         */
+        void bind(Handler handler) {
+            {
+                std::lock_guard<std::mutex> lk(state_->sync);
+                state_->receiver = MessagePump::getCurrent();
+                state_->handler = std::move(handler);
+                ++state_->generation;
+            }
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!state_->isEmpty() && !state_->scheduled.exchange(true)) {
+                schedule(state_);
+            }
+        }
+
+        /**
+         * 解除绑定，之后 handler 不会再被调用。
+         */
+        void unbind() {
+            std::lock_guard<std::mutex> lk(state_->sync);
+            state_->receiver.reset();
+            state_->handler = nullptr;
+            ++state_->generation;
+        }
+
+        /**
+         * 取出一项数据，没有绑定时使用。
+         * @return 通道为空时返回 false。
+         */
+        bool tryReceive(T* out) {
+            if (!state_->pop(out)) {
+                return false;
+            }
+            state_->notifyWritable();
+            return true;
+        }
+
+        /**
+         * 可以在任意发送线程中调用。CHANNEL_SPSC 模式下同一时刻只能有一个线程发送。
+         * @return 通道已满或已关闭时返回 false，此时 value 保持不变。
+         */
+        bool trySend(const T& value) {
+            return send(value);
+        }
+
+        bool trySend(T&& value) {
+            return send(std::move(value));
+        }
+
+        /**
+         * 通道中的数据不多于容量的一半时，返回的 Future 的结果为 true；
+         * 通道关闭时为 false。用于 trySend() 失败后等待，例如：
+         *   channel.whenWritable().then([](bool ok) { if (ok) produceMore(); });
+         * 回调在调用 then() 的线程的泵中执行。在多个发送线程的情况下，回调执行时通道可能又已满。
+         */
+        Future<bool> whenWritable() {
+            Promise<bool> promise;
+            auto future = promise.getFuture();
+
+            std::unique_lock<std::mutex> lk(state_->sync);
+            if (state_->closed.load(std::memory_order_relaxed)) {
+                lk.unlock();
+                promise.setValue(false);
+                return future;
+            }
+
+            state_->waiters.push_back(std::move(promise));
+            state_->has_waiters.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            lk.unlock();
+
+            // 接收端可能在登记之前已经取走了数据，因此登记之后要再检查一次。
+            state_->notifyWritable();
+            return future;
+        }
+
+        /**
+         * 关闭通道，之后发送都会失败，等待中的 whenWritable() 以 false 完成。
+         * 已在通道中的数据仍可以被接收。
+         */
+        void close() {
+            std::vector<Promise<bool>> waiters;
+            {
+                std::lock_guard<std::mutex> lk(state_->sync);
+                state_->closed.store(true, std::memory_order_release);
+                state_->has_waiters.store(false, std::memory_order_relaxed);
+                waiters.swap(state_->waiters);
+            }
+            for (auto& p : waiters) {
+                p.setValue(false);
+            }
+        }
+
+        bool isClosed() const {
+            return state_->closed.load(std::memory_order_acquire);
+        }
+
+        size_t capacity() const {
+            return state_->mask + 1;
+        }
+
+        /**
+         * 通道中数据的数量，其他线程同时收发时只是近似值。
+         */
+        size_t size() const {
+            return state_->size();
+        }
+
+    private:
+        // 每次连续处理的最大数量，超过后让出泵，处理完泵中的其他消息后再继续。
+        static constexpr size_t kDrainBatch = 64;
+
+        struct Slot {
+            std::atomic<size_t> seq;
+            alignas(T) unsigned char storage[sizeof(T)];
+
+            T* value() {
+                return std::launder(reinterpret_cast<T*>(storage));
+            }
+        };
+
+        /**
+         * 环形缓冲区的算法参照 Dmitry Vyukov 的有界 MPMC 队列：
+         * 每个槽的 seq 表示该槽当前可以被哪个位置的发送或接收使用，
+         * 发送端之间只在 tail 上竞争，发送端与接收端之间只通过槽的 seq 交接。
+         */
+        struct State {
+            explicit State(size_t cap) {
+                size_t n = 2;
+                while (n < cap) {
+                    n <<= 1;
+                }
+                mask = n - 1;
+                slots = new Slot[n];
+                for (size_t i = 0; i < n; ++i) {
+                    slots[i].seq.store(i, std::memory_order_relaxed);
+                }
+            }
+
+            ~State() {
+                while (popWith([](T&&) {})) {}
+                delete[] slots;
+            }
+
+            template <typename V>
+            bool push(V&& v) {
+                Slot* slot;
+                auto pos = tail.load(std::memory_order_relaxed);
+                if constexpr (Mode == CHANNEL_SPSC) {
+                    slot = &slots[pos & mask];
+                    if (slot->seq.load(std::memory_order_acquire) != pos) {
+                        return false;
+                    }
+                    tail.store(pos + 1, std::memory_order_relaxed);
+                } else {
+                    for (;;) {
+                        slot = &slots[pos & mask];
+                        auto seq = slot->seq.load(std::memory_order_acquire);
+                        auto diff = intptr_t(seq) - intptr_t(pos);
+                        if (diff == 0) {
+                            if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                                break;
+                            }
+                        } else if (diff < 0) {
+                            return false;
+                        } else {
+                            pos = tail.load(std::memory_order_relaxed);
+                        }
+                    }
+                }
+
+                new (slot->storage) T(std::forward<V>(v));
+                slot->seq.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+
+            // 只能在接收线程中调用
+            bool pop(T* out) {
+                return popWith([out](T&& v) { *out = std::move(v); });
+            }
+
+            template <typename F>
+            bool popWith(F&& f) {
+                auto pos = head.load(std::memory_order_relaxed);
+                auto slot = &slots[pos & mask];
+                if (slot->seq.load(std::memory_order_acquire) != pos + 1) {
+                    return false;
+                }
+
+                auto v = slot->value();
+                f(std::move(*v));
+                v->~T();
+                slot->seq.store(pos + mask + 1, std::memory_order_release);
+                head.store(pos + 1, std::memory_order_relaxed);
+                return true;
+            }
+
+            bool isEmpty() const {
+                auto pos = head.load(std::memory_order_relaxed);
+                return slots[pos & mask].seq.load(std::memory_order_acquire) != pos + 1;
+            }
+
+            size_t size() const {
+                auto h = head.load(std::memory_order_relaxed);
+                auto t = tail.load(std::memory_order_relaxed);
+                return t > h ? t - h : 0;
+            }
+
+            // 只能在接收线程中调用，或在登记等待之后调用
+            void notifyWritable() {
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (!has_waiters.load(std::memory_order_relaxed)) {
+                    return;
+                }
+
+                std::vector<Promise<bool>> ready;
+                {
+                    std::lock_guard<std::mutex> lk(sync);
+                    if (size() > (mask + 1) / 2) {
+                        return;
+                    }
+                    has_waiters.store(false, std::memory_order_relaxed);
+                    ready.swap(waiters);
+                }
+                for (auto& p : ready) {
+                    p.setValue(true);
+                }
+            }
+
+            size_t mask;
+            Slot* slots;
+
+            alignas(64) std::atomic<size_t> head{ 0 };
+            alignas(64) std::atomic<size_t> tail{ 0 };
+
+            // 是否已有 drain() 在接收端的泵中等待或正在执行
+            alignas(64) std::atomic<bool> scheduled{ false };
+            std::atomic<bool> closed{ false };
+            std::atomic<bool> has_waiters{ false };
+
+            std::mutex sync;
+            std::weak_ptr<MessagePump> receiver;
+            std::vector<Promise<bool>> waiters;
+
+            // 以下只在接收线程中访问。generation 在每次 bind() 和 unbind() 时递增
+            Handler handler;
+            uint64_t generation = 0;
+        };
+
+        template <typename V>
+        bool send(V&& value) {
+            if (state_->closed.load(std::memory_order_acquire) ||
+                !state_->push(std::forward<V>(value)))
+            {
+                return false;
+            }
+
+            // 与 drain() 中清除 scheduled 之后的检查配对，保证不会漏掉唤醒。
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!state_->scheduled.load(std::memory_order_relaxed) &&
+                !state_->scheduled.exchange(true))
+            {
+                schedule(state_);
+            }
+            return true;
+        }
+
+        static void schedule(const std::shared_ptr<State>& state) {
+            std::weak_ptr<MessagePump> receiver;
+            {
+                std::lock_guard<std::mutex> lk(state->sync);
+                if (state->receiver.expired()) {
+                    // 未绑定，由之后的 bind() 重新检查
+                    state->scheduled.store(false);
+                    return;
+                }
+                receiver = state->receiver;
+            }
+
+            auto msg = Message::get();
+            msg->func.emplace([state]() { drain(state); });
+            MessagePump::postTo(receiver, msg);
+        }
+
+        static void drain(const std::shared_ptr<State>& state) {
+            if (!state->handler) {
+                state->scheduled.store(false);
+                return;
+            }
+
+            // handler 可能在执行中调用 bind() 或 unbind()，因此先移出，执行完且绑定未变时再放回。
+            auto gen = state->generation;
+            Handler handler(std::move(state->handler));
+            bool rebound = false;
+            auto call = [&](T&& v) {
+                if (!rebound) {
+                    handler(std::move(v));
+                    rebound = state->generation != gen;
+                }
+            };
+
+            for (;;) {
+                size_t count = 0;
+                while (!rebound && count < kDrainBatch && state->popWith(call)) {
+                    ++count;
+                }
+                state->notifyWritable();
+
+                if (rebound) {
+                    // 绑定已改变。本次调度仍在进行，bind() 中的检查不会生效，这里替它再检查一次。
+                    state->scheduled.store(false);
+                    std::atomic_thread_fence(std::memory_order_seq_cst);
+                    if (!state->isEmpty() && !state->scheduled.exchange(true)) {
+                        schedule(state);
+                    }
+                    return;
+                }
+                if (count == kDrainBatch) {
+                    state->handler = std::move(handler);
+                    schedule(state);
+                    return;
+                }
+
+                state->scheduled.store(false);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (state->isEmpty() || state->scheduled.exchange(true)) {
+                    state->handler = std::move(handler);
+                    return;
+                }
+            }
+        }
+
+        std::shared_ptr<State> state_;
+    };
+
+    template <typename T>
+    using SpscChannel = Channel<T, CHANNEL_SPSC>;
+
+    template <typename T>
+    using MpscChannel = Channel<T, CHANNEL_MPSC>;
+
+}
+
+#endif  // UTILS_MESSAGE_CHANNEL_HPP_
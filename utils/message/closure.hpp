@@ -0,0 +1,189 @@
+// Copyright (c) 2016 ucclkp <ucclkp@gmail.com>.
+// This file is part of utils project.
+//
+// This program is licensed under GPLv3 license that can be
+// found in the LICENSE file.
+
+#ifndef UTILS_MESSAGE_CLOSURE_HPP_
+#define UTILS_MESSAGE_CLOSURE_HPP_
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+
+namespace utl {
+
+    /**
+     * 只能移动的 void() 可调用对象。
+     * 大小不超过 kInlineSize 且移动构造不抛异常的可调用对象直接存放在内部，
+     * 不需要分配内存；其他的则存放在堆上。
+     * 与 std::function 不同，该类不要求可调用对象能够复制，可以捕获 std::unique_ptr 等。
+     */
+    class Closure {
+    public:
+        static constexpr size_t kInlineSize = 56;
+        static constexpr size_t kInlineAlign = alignof(void*);
+
+        template <typename F>
+        static constexpr bool isInlined() {
+            using T = std::decay_t<F>;
+            return sizeof(T) <= kInlineSize &&
+                kInlineAlign % alignof(T) == 0 &&
+                std::is_nothrow_move_constructible<T>::value;
+        }
+
+        template <typename F>
+        using EnableIfCallable = std::enable_if_t<
+            !std::is_same<std::decay_t<F>, Closure>::value &&
+            std::is_invocable<std::decay_t<F>&>::value>;
+
+        Closure() = default;
+        Closure(std::nullptr_t) {}
+
+        template <typename F, typename = EnableIfCallable<F>>
+        Closure(F&& f) {
+            emplace(std::forward<F>(f));
+        }
+
+        Closure(Closure&& rhs) noexcept {
+            moveFrom(rhs);
+        }
+
+        Closure(const Closure&) = delete;
+        Closure& operator=(const Closure&) = delete;
+
+        ~Closure() {
+            reset();
+        }
+
+        Closure& operator=(Closure&& rhs) noexcept {
+            if (this != &rhs) {
+                reset();
+                moveFrom(rhs);
+            }
+            return *this;
+        }
+
+        Closure& operator=(std::nullptr_t) {
+            reset();
+            return *this;
+        }
+
+        template <typename F, typename = EnableIfCallable<F>>
+        Closure& operator=(F&& f) {
+            emplace(std::forward<F>(f));
+            return *this;
+        }
+
+        /**
+         * 就地构造可调用对象，原有的对象会被先销毁。
+         * 空的函数指针和空的 std::function 会使该对象为空。
+         */
+        template <typename F, typename = EnableIfCallable<F>>
+        void emplace(F&& f) {
+            using T = std::decay_t<F>;
+
+            reset();
+            if (isNull(f)) {
+                return;
+            }
+
+            if constexpr (isInlined<T>()) {
+                new (storage_) T(std::forward<F>(f));
+                ops_ = &InlineOps<T>::ops;
+            } else {
+                *reinterpret_cast<T**>(storage_) = new T(std::forward<F>(f));
+                ops_ = &HeapOps<T>::ops;
+            }
+        }
+
+        void reset() {
+            if (ops_) {
+                ops_->destroy(storage_);
+                ops_ = nullptr;
+            }
+        }
+
+        void operator()() {
+            ops_->invoke(storage_);
+        }
+
+        explicit operator bool() const {
+            return ops_ != nullptr;
+        }
+
+    private:
+        struct Ops {
+            void (*invoke)(void* s);
+            // 在 dst 上移动构造，并销毁 src 上的对象。
+            void (*relocate)(void* dst, void* src);
+            void (*destroy)(void* s);
+        };
+
+        template <typename T>
+        struct InlineOps {
+            static void invoke(void* s) {
+                (*static_cast<T*>(s))();
+            }
+            static void relocate(void* dst, void* src) {
+                auto obj = static_cast<T*>(src);
+                new (dst) T(std::move(*obj));
+                obj->~T();
+            }
+            static void destroy(void* s) {
+                static_cast<T*>(s)->~T();
+            }
+
+            static constexpr Ops ops{ invoke, relocate, destroy };
+        };
+
+        template <typename T>
+        struct HeapOps {
+            static T* get(void* s) {
+                return *static_cast<T**>(s);
+            }
+            static void invoke(void* s) {
+                (*get(s))();
+            }
+            static void relocate(void* dst, void* src) {
+                *static_cast<T**>(dst) = get(src);
+            }
+            static void destroy(void* s) {
+                delete get(s);
+            }
+
+            static constexpr Ops ops{ invoke, relocate, destroy };
+        };
+
+        template <typename T>
+        static bool isNull(const T& f) {
+            if constexpr (std::is_pointer<T>::value) {
+                return f == nullptr;
+            } else {
+                return false;
+            }
+        }
+
+        template <typename Sig>
+        static bool isNull(const std::function<Sig>& f) {
+            return !f;
+        }
+
+        void moveFrom(Closure& rhs) noexcept {
+            if (rhs.ops_) {
+                rhs.ops_->relocate(storage_, rhs.storage_);
+                ops_ = rhs.ops_;
+                rhs.ops_ = nullptr;
+            }
+        }
+
+        alignas(kInlineAlign) unsigned char storage_[kInlineSize];
+        const Ops* ops_ = nullptr;
+    };
+
+}
+
+#endif  // UTILS_MESSAGE_CLOSURE_HPP_
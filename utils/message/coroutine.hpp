@@ -0,0 +1,363 @@
+// Copyright (c) 2016 ucclkp <ucclkp@gmail.com>.
+// This file is part of utils project.
+//
+// This program is licensed under GPLv3 license that can be
+// found in the LICENSE file.
+
+#ifndef UTILS_MESSAGE_COROUTINE_HPP_
+#define UTILS_MESSAGE_COROUTINE_HPP_
+
+// 协程需要 C++20，更低的标准下该文件不提供任何内容。
+// 项目整体以 C++17 编译，使用协程的源文件需单独以 C++20 编译，如 coroutine_unit_test.cpp。
+// 因此协程相关的内容都以自由函数的形式放在这里，Cycler 等类的定义不随语言标准变化。
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#define UTL_HAS_COROUTINES
+#endif
+#endif
+
+#ifdef UTL_HAS_COROUTINES
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "utils/time_utils.h"
+
+
+namespace utl {
+
+    namespace internal {
+
+        struct PromiseBase {
+            struct FinalAwaiter {
+                bool await_ready() const noexcept {
+                    return false;
+                }
+
+                template <typename Promise>
+                std::coroutine_handle<> await_suspend(
+                    std::coroutine_handle<Promise> h) noexcept
+                {
+                    auto& promise = h.promise();
+                    if (promise.continuation) {
+                        return promise.continuation;
+                    }
+                    if (promise.detached) {
+                        h.destroy();
+                    }
+                    return std::noop_coroutine();
+                }
+
+                void await_resume() const noexcept {}
+            };
+
+            std::suspend_always initial_suspend() const noexcept {
+                return {};
+            }
+
+            FinalAwaiter final_suspend() const noexcept {
+                return {};
+            }
+
+            void unhandled_exception() {
+                // 没有人等待结果的协程，与投递的回调中未捕获的异常一样处理。
+                if (detached) {
+                    std::terminate();
+                }
+                exception = std::current_exception();
+            }
+
+            void rethrowIfFailed() {
+                if (exception) {
+                    std::rethrow_exception(exception);
+                }
+            }
+
+            /**
+             * 挂起在 p 上的 Task 链再也不会被恢复时调用。
+             * 内层协程帧归外层帧中的 Task 所有，因此只能从最外层开始销毁。
+             * 最外层是由 detach() 启动的协程时销毁它，整条链随之析构；
+             * 否则最外层由其他类型的协程等待，只能留给它的所有者销毁。
+             */
+            static void abandon(PromiseBase* p) {
+                while (p->parent) {
+                    p = p->parent;
+                }
+                if (p->detached) {
+                    p->self.destroy();
+                }
+            }
+
+            std::coroutine_handle<> self;
+            std::coroutine_handle<> continuation;
+            // 等待本协程的 Task 协程，等待者不是 Task 时为 nullptr
+            PromiseBase* parent = nullptr;
+            std::exception_ptr exception;
+            bool detached = false;
+        };
+
+        /**
+         * 随消息投递的可调用对象，执行时恢复协程。
+         * 消息在执行前被移除或回收时，按 PromiseBase::abandon() 销毁协程。
+         */
+        class Resumer {
+        public:
+            template <typename Promise>
+            explicit Resumer(std::coroutine_handle<Promise> h)
+                : handle_(h)
+            {
+                if constexpr (std::is_base_of_v<PromiseBase, Promise>) {
+                    promise_ = &h.promise();
+                }
+            }
+
+            Resumer(Resumer&& rhs) noexcept
+                : handle_(std::exchange(rhs.handle_, nullptr)),
+                  promise_(std::exchange(rhs.promise_, nullptr)) {}
+
+            Resumer(const Resumer&) = delete;
+            Resumer& operator=(const Resumer&) = delete;
+            Resumer& operator=(Resumer&&) = delete;
+
+            ~Resumer() {
+                if (handle_ && promise_) {
+                    PromiseBase::abandon(promise_);
+                }
+            }
+
+            void operator()() {
+                promise_ = nullptr;
+                std::exchange(handle_, nullptr).resume();
+            }
+
+        private:
+            std::coroutine_handle<> handle_;
+            PromiseBase* promise_ = nullptr;
+        };
+
+    }
+
+    /**
+     * 挂起当前协程，并在 Poster 的线程（或序列）中恢复。通过 switchTo()、sleepFor() 和 sleepUntil() 获取。
+     * Poster 可以是 Cycler、SequencedCycler 或 ThreadPool，
+     * 恢复时使用池化的 Message，恢复所需的状态内嵌在消息中，不会额外分配内存。
+     * 如果消息在执行前被移除（例如 Cycler 析构或泵已销毁），协程将不会被恢复：
+     * 由 detach() 启动的 Task 会连同其等待中的内层 Task 一起被销毁，协程帧中的对象随之析构。
+     */
+    template <typename Poster>
+    class ResumeAwaiter {
+    public:
+        /**
+         * @param is_delay 为 true 时 time 为延时，交给 Poster::postDelayed()，
+         *                 由 Poster 决定延时的起点；否则为到期时间。
+         */
+        ResumeAwaiter(Poster* poster, TimeUtils::ns time, bool is_delay)
+            : poster_(poster), time_(time), is_delay_(is_delay) {}
+
+        bool await_ready() const noexcept {
+            return false;
+        }
+
+        template <typename Promise>
+        void await_suspend(std::coroutine_handle<Promise> h) {
+            if (is_delay_) {
+                poster_->postDelayed(internal::Resumer(h), time_);
+            } else {
+                poster_->postAtTime(internal::Resumer(h), time_);
+            }
+        }
+
+        void await_resume() const noexcept {}
+
+    private:
+        Poster* poster_;
+        TimeUtils::ns time_;
+        bool is_delay_;
+    };
+
+    /**
+     * 用于 co_await，协程剩余的部分作为 poster 中的一个消息执行。
+     * 用法：co_await utl::switchTo(cycler);
+     */
+    template <typename Poster>
+    ResumeAwaiter<Poster> switchTo(Poster& poster) {
+        return ResumeAwaiter<Poster>(&poster, TimeUtils::ns(0), true);
+    }
+
+    /**
+     * 与 switchTo() 相同，但在 delay 之后恢复。延时的起点与 poster.postDelayed() 相同。
+     */
+    template <typename Poster>
+    ResumeAwaiter<Poster> sleepFor(Poster& poster, TimeUtils::nsp delay) {
+        return ResumeAwaiter<Poster>(&poster, delay, true);
+    }
+
+    /**
+     * 与 switchTo() 相同，但在 at_time 时恢复。时间以 poster 的 now() 为准。
+     */
+    template <typename Poster>
+    ResumeAwaiter<Poster> sleepUntil(Poster& poster, TimeUtils::nsp at_time) {
+        return ResumeAwaiter<Poster>(&poster, at_time, false);
+    }
+
+
+    /**
+     * 惰性启动的协程。
+     * 被 co_await 时才开始执行，执行完毕后在最后一次恢复它的线程中继续等待者。
+     * 最外层的协程可以调用 detach() 启动，之后协程帧在执行完毕时自行销毁。
+     */
+    template <typename T>
+    class Task {
+    public:
+        struct promise_type : internal::PromiseBase {
+            Task get_return_object() {
+                auto h = std::coroutine_handle<promise_type>::from_promise(*this);
+                self = h;
+                return Task(h);
+            }
+
+            template <typename U>
+            void return_value(U&& val) {
+                value.emplace(std::forward<U>(val));
+            }
+
+            T result() {
+                rethrowIfFailed();
+                return std::move(*value);
+            }
+
+            std::optional<T> value;
+        };
+
+        Task(Task&& rhs) noexcept
+            : handle_(std::exchange(rhs.handle_, nullptr)) {}
+
+        Task(const Task&) = delete;
+        Task& operator=(const Task&) = delete;
+
+        ~Task() {
+            if (handle_) {
+                handle_.destroy();
+            }
+        }
+
+        bool await_ready() const noexcept {
+            return !handle_ || handle_.done();
+        }
+
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> cont) noexcept {
+            auto& promise = handle_.promise();
+            promise.continuation = cont;
+            if constexpr (std::is_base_of_v<internal::PromiseBase, Promise>) {
+                promise.parent = &cont.promise();
+            }
+            return handle_;
+        }
+
+        T await_resume() {
+            return handle_.promise().result();
+        }
+
+        /**
+         * 启动协程，并放弃对其的所有权。
+         */
+        void detach() && {
+            auto h = std::exchange(handle_, nullptr);
+            h.promise().detached = true;
+            h.resume();
+        }
+
+    private:
+        explicit Task(std::coroutine_handle<promise_type> h)
+            : handle_(h) {}
+
+        std::coroutine_handle<promise_type> handle_;
+    };
+
+    template <>
+    struct Task<void>::promise_type : internal::PromiseBase {
+        Task get_return_object() {
+            auto h = std::coroutine_handle<promise_type>::from_promise(*this);
+            self = h;
+            return Task(h);
+        }
+
+        void return_void() {}
+
+        void result() {
+            rethrowIfFailed();
+        }
+    };
+
+
+    /**
+     * 在 target 中执行 func，完成后在 reply 中恢复协程，co_await 的结果为 func 的返回值。
+     * func 抛出的异常会在恢复后重新抛出。
+     * func 或回复的消息在执行前被移除时，协程与 ResumeAwaiter 中一样被销毁而不会恢复。
+     * 用法：auto r = co_await utl::postAndReply(worker, ui, [] { return compute(); });
+     */
+    template <typename Target, typename Reply, typename F>
+    class PostAndReplyAwaiter {
+    public:
+        using Result = std::invoke_result_t<F&>;
+
+        PostAndReplyAwaiter(Target* target, Reply* reply, F&& func)
+            : target_(target), reply_(reply), func_(std::move(func)) {}
+
+        bool await_ready() const noexcept {
+            return false;
+        }
+
+        template <typename Promise>
+        void await_suspend(std::coroutine_handle<Promise> h) {
+            target_->post([this, resumer = internal::Resumer(h)]() mutable {
+                try {
+                    if constexpr (std::is_void_v<Result>) {
+                        func_();
+                    } else {
+                        result_.emplace(func_());
+                    }
+                } catch (...) {
+                    exception_ = std::current_exception();
+                }
+                // 回复的泵已销毁时，resumer 随消息一起被回收。
+                reply_->post(std::move(resumer));
+            });
+        }
+
+        Result await_resume() {
+            if (exception_) {
+                std::rethrow_exception(exception_);
+            }
+            if constexpr (!std::is_void_v<Result>) {
+                return std::move(*result_);
+            }
+        }
+
+    private:
+        using Storage = std::conditional_t<std::is_void_v<Result>, bool, Result>;
+
+        Target* target_;
+        Reply* reply_;
+        F func_;
+        std::optional<Storage> result_;
+        std::exception_ptr exception_;
+    };
+
+    template <typename Target, typename Reply, typename F>
+    PostAndReplyAwaiter<Target, Reply, std::decay_t<F>> postAndReply(
+        Target& target, Reply& reply, F&& func)
+    {
+        return PostAndReplyAwaiter<Target, Reply, std::decay_t<F>>(
+            &target, &reply, std::decay_t<F>(std::forward<F>(func)));
+    }
+
+}
+
+#endif  // UTL_HAS_COROUTINES
+
+#endif  // UTILS_MESSAGE_COROUTINE_HPP_
@@ -6,12 +6,15 @@
 
 #include "utils/message/cycler.h"
 
+#include <algorithm>
 #include <chrono>
 
+#include "utils/log.h"
 #include "utils/message/executable.h"
 #include "utils/message/message.h"
 #include "utils/message/message_pump.h"
 #include "utils/message/message_queue.h"
+#include "utils/message/trace_log.h"
 
 
 namespace utl {
@@ -19,16 +22,28 @@ namespace utl {
     Cycler::Cycler()
         : pump_(MessagePump::getCurrent()),
           listener_(nullptr),
-          clear_when_destroy_(true) {}
+          clear_when_destroy_(true),
+          priority_(Message::PRI_NORMAL),
+          slack_ns_(0),
+          queued_(nullptr) {}
 
     Cycler::Cycler(const std::weak_ptr<MessagePump>& pump)
         : pump_(pump),
           listener_(nullptr),
-          clear_when_destroy_(true) {}
+          clear_when_destroy_(true),
+          priority_(Message::PRI_NORMAL),
+          slack_ns_(0),
+          queued_(nullptr) {}
 
     Cycler::~Cycler() {
         if (clear_when_destroy_.load(std::memory_order_relaxed)) {
             clear();
+        } else {
+            // 消息留在队列中，但不能再引用本对象的索引。
+            auto ptr = pump_.lock();
+            if (ptr) {
+                ptr->getQueue()->detach(this);
+            }
         }
     }
 
@@ -40,64 +55,89 @@ namespace utl {
         clear_when_destroy_.store(val, std::memory_order_relaxed);
     }
 
-    void Cycler::post(Executable* exec, int id) {
-        postDelayed(exec, ns(0), id);
+    void Cycler::setPriority(Message::Priority p) {
+        if (p >= Message::PRI_COUNT) {
+            ubassert(false);
+            return;
+        }
+        priority_.store(p, std::memory_order_relaxed);
     }
 
-    void Cycler::postDelayed(Executable* exec, nsp delay, int id) {
-        postAtTime(exec, delay + now(), id);
+    Message::Priority Cycler::getPriority() const {
+        return priority_.load(std::memory_order_relaxed);
     }
 
-    void Cycler::postAtTime(Executable* exec, nsp at_time, int id) {
-        Message* msg = Message::get();
-        msg->callback = exec;
-        msg->id = id;
+    void Cycler::setTimerSlack(nsp slack) {
+        slack_ns_.store(std::max(slack.count(), int64_t(0)), std::memory_order_relaxed);
+    }
 
-        postAtTime(msg, at_time);
+    Cycler::ns Cycler::getTimerSlack() const {
+        return ns(slack_ns_.load(std::memory_order_relaxed));
     }
 
-    void Cycler::post(const std::function<void()>& func, int id) {
-        postDelayed(func, ns(0), id);
+    MessageHandle Cycler::post(Executable* exec, int id, const Location& from) {
+        return postDelayed(exec, ns(0), id, from);
     }
 
-    void Cycler::postDelayed(const std::function<void()>& func, nsp delay, int id) {
-        postAtTime(func, delay + now(), id);
+    MessageHandle Cycler::postDelayed(Executable* exec, nsp delay, int id, const Location& from) {
+        Message* msg = Message::get();
+        msg->callback = exec;
+        msg->id = id;
+
+        return postDelayed(msg, delay, from);
     }
 
-    void Cycler::postAtTime(const std::function<void()>& func, nsp at_time, int id) {
+    MessageHandle Cycler::postAtTime(Executable* exec, nsp at_time, int id, const Location& from) {
         Message* msg = Message::get();
-        msg->func = func;
+        msg->callback = exec;
         msg->id = id;
 
-        postAtTime(msg, at_time);
+        return postAtTime(msg, at_time, from);
     }
 
-    void Cycler::post(int id) {
-        postDelayed(id, ns(0));
+    MessageHandle Cycler::post(int id, const Location& from) {
+        return postDelayed(id, ns(0), from);
     }
 
-    void Cycler::postDelayed(int id, nsp delay) {
-        postAtTime(id, delay + now());
+    MessageHandle Cycler::postDelayed(int id, nsp delay, const Location& from) {
+        Message* msg = Message::get();
+        msg->id = id;
+
+        return postDelayed(msg, delay, from);
     }
 
-    void Cycler::postAtTime(int id, nsp at_time) {
+    MessageHandle Cycler::postAtTime(int id, nsp at_time, const Location& from) {
         Message* msg = Message::get();
         msg->id = id;
 
-        postAtTime(msg, at_time);
+        return postAtTime(msg, at_time, from);
     }
 
-    void Cycler::post(Message* msg) {
-        postDelayed(msg, ns(0));
+    MessageHandle Cycler::post(Message* msg, const Location& from) {
+        return postDelayed(msg, ns(0), from);
     }
 
-    void Cycler::postDelayed(Message* msg, nsp delay) {
-        postAtTime(msg, delay + now());
+    MessageHandle Cycler::postDelayed(Message* msg, nsp delay, const Location& from) {
+        if (delay.count() > 0) {
+            return postAtTime(msg, getPostTime(delay), from);
+        }
+        return postMessage(msg, getPostTime(delay).count(), from);
+    }
+
+    MessageHandle Cycler::postAtTime(Message* msg, nsp at_time, const Location& from) {
+        auto time_ns = applySlack(at_time.count());
+        msg->is_slack = time_ns != at_time.count();
+        return postMessage(msg, time_ns, from);
     }
 
-    void Cycler::postAtTime(Message* msg, nsp at_time) {
-        msg->time_ns = at_time.count();
+    MessageHandle Cycler::postMessage(Message* msg, int64_t time_ns, const Location& from) {
+        msg->time_ns = time_ns;
+        msg->from = from;
+
+        // 必须在入队前获取，入队后消息随时可能被执行并回收。
+        auto handle = msg->getHandle(this);
         enqueueMessage(msg);
+        return handle;
     }
 
     void Cycler::clear() {
@@ -108,9 +148,9 @@ namespace utl {
     }
 
     void Cycler::enqueueMessage(Message* msg) {
-        msg->target = this;
         auto ptr = pump_.lock();
         if (ptr) {
+            prepareMessage(msg);
             ptr->getQueue()->enqueue(msg);
             ptr->wakeup();
         } else {
@@ -118,6 +158,30 @@ namespace utl {
         }
     }
 
+    void Cycler::prepareMessage(Message* msg) {
+        msg->target = this;
+        msg->priority = priority_.load(std::memory_order_relaxed);
+        if (TraceLog::isEnabled()) {
+            msg->flow_id = TraceLog::newFlowId();
+            TraceLog::addEvent(
+                TraceLog::PH_FLOW_START, msg->from, msg->flow_id, msg->id, now().count());
+        }
+    }
+
+    int64_t Cycler::applySlack(int64_t time_ns) const {
+        auto slack = slack_ns_.load(std::memory_order_relaxed);
+        if (slack <= 0 || time_ns <= MessagePump::getLoopTime().count()) {
+            return time_ns;
+        }
+
+        // 对齐粒度取不大于余量的最大的 2 的幂，不同余量的对齐点相互重合。
+        int64_t grain = 1;
+        while (grain <= slack / 2) {
+            grain <<= 1;
+        }
+        return (time_ns + grain - 1) & ~(grain - 1);
+    }
+
     bool Cycler::hasMessages(int id) {
         auto ptr = pump_.lock();
         if (ptr) {
@@ -133,6 +197,18 @@ namespace utl {
         }
     }
 
+    bool Cycler::hasMessage(const MessageHandle& h) const {
+        return Message::isPending(h);
+    }
+
+    bool Cycler::removeMessage(const MessageHandle& h) {
+        auto ptr = pump_.lock();
+        if (ptr) {
+            return ptr->getQueue()->cancel(this, h);
+        }
+        return false;
+    }
+
     void Cycler::dispatchMessage(const Message& msg) {
         if (listener_) {
             listener_->onHandleMessage(msg);
@@ -144,4 +220,99 @@ namespace utl {
         return TimeUtils::upTime();
     }
 
-}
\ No newline at end of file
+    // static
+    Cycler::ns Cycler::getPostTime(nsp delay) {
+        // 即时消息不能以缓存的时间为准，否则在耗时较长的消息中投递时，
+        // 会被当作已排队了同样长的时间，提前越过更高优先级的消息。
+        if (delay.count() <= 0) {
+            return TimeUtils::coarseUpTime();
+        }
+        return delay + MessagePump::getLoopTime();
+    }
+
+
+
+    // PostBatch
+    PostBatch::PostBatch(Cycler* cycler)
+        : cycler_(cycler),
+          head_(nullptr),
+          tail_(nullptr),
+          count_(0),
+          immediate_(0) {}
+
+    PostBatch::~PostBatch() {
+        commit();
+    }
+
+    MessageHandle PostBatch::post(Message* msg, const Location& from) {
+        // 时间在 commit() 时填写
+        msg->time_ns = 0;
+        ++immediate_;
+        return add(msg, from);
+    }
+
+    MessageHandle PostBatch::postDelayed(Message* msg, nsp delay, const Location& from) {
+        if (delay.count() > 0) {
+            return postAtTime(msg, Cycler::getPostTime(delay), from);
+        }
+        return post(msg, from);
+    }
+
+    MessageHandle PostBatch::postAtTime(Message* msg, nsp at_time, const Location& from) {
+        auto time_ns = cycler_->applySlack(at_time.count());
+        msg->time_ns = time_ns;
+        msg->is_slack = time_ns != at_time.count();
+        return add(msg, from);
+    }
+
+    MessageHandle PostBatch::add(Message* msg, const Location& from) {
+        msg->from = from;
+        cycler_->prepareMessage(msg);
+
+        // 与接收栈相同，新的消息在前。
+        msg->next = head_;
+        head_ = msg;
+        if (!tail_) {
+            tail_ = msg;
+        }
+        ++count_;
+        return msg->getHandle(cycler_);
+    }
+
+    size_t PostBatch::size() const {
+        return count_;
+    }
+
+    void PostBatch::commit() {
+        if (!head_) {
+            return;
+        }
+
+        if (immediate_ > 0) {
+            // 整批只取一次时间。at_time 为 0 的消息本来就已到期，一并填写也没有影响。
+            auto time_ns = Cycler::getPostTime(ns(0)).count();
+            for (auto msg = head_; msg; msg = msg->next) {
+                if (msg->time_ns == 0) {
+                    msg->time_ns = time_ns;
+                }
+            }
+            immediate_ = 0;
+        }
+
+        auto ptr = cycler_->pump_.lock();
+        if (ptr) {
+            ptr->getQueue()->enqueue(head_, tail_);
+            ptr->wakeup();
+        } else {
+            while (auto msg = head_) {
+                head_ = msg->next;
+                msg->reset();
+            }
+        }
+
+        head_ = nullptr;
+        tail_ = nullptr;
+        count_ = 0;
+    }
+
+}
@@ -7,15 +7,20 @@
 #ifndef UTILS_MESSAGE_CYCLER_H_
 #define UTILS_MESSAGE_CYCLER_H_
 
+#include <atomic>
 #include <functional>
 #include <memory>
+#include <type_traits>
 
+#include "utils/message/future.hpp"
+#include "utils/message/location.hpp"
+#include "utils/message/message.h"
+#include "utils/message/message_pump.h"
 #include "utils/time_utils.h"
 
 
 namespace utl {
 
-    class Message;
     class MessagePump;
     class Executable;
 
@@ -28,6 +33,20 @@ namespace utl {
     };
 
 
+    namespace internal {
+
+        template <typename F>
+        struct IdleTask {
+            void operator()() {
+                func(MessagePump::getCurrent()->getIdleDeadline());
+            }
+
+            F func;
+        };
+
+    }
+
+
     class Cycler {
     public:
         using ns = TimeUtils::ns;
@@ -40,21 +59,160 @@ namespace utl {
         void setListener(CyclerListener* l);
         void setClearWhenDestroy(bool val);
 
-        void post(Executable* exec, int id = -1);
-        void postDelayed(Executable* exec, nsp delay, int id = -1);
-        void postAtTime(Executable* exec, nsp at_time, int id = -1);
+        /**
+         * 设置通过本 Cycler 投递的消息的优先级，默认为 PRI_NORMAL。
+         * 只影响之后投递的消息。需要不同优先级时，可以对同一个泵创建多个 Cycler。
+         */
+        void setPriority(Message::Priority p);
+        Message::Priority getPriority() const;
+
+        /**
+         * 设置延时消息的时间余量，默认为 0。只影响之后投递的延时消息，不影响即时消息。
+         * 设置后，延时消息可能在到期之后、余量之内的任意时刻执行。到期时间会向后对齐到
+         * 不大于余量的 2 的幂的整数倍，到期时间相近的消息因此落在同一时刻，泵只需要唤醒一次。
+         * 适合大量精度要求不高的超时，例如网络请求的超时。
+         */
+        void setTimerSlack(nsp slack);
+        ns getTimerSlack() const;
+
+        /**
+         * 以下 post 方法均返回所投递消息的句柄，
+         * 可用于 hasMessage() 和 removeMessage()，不需要时忽略即可。
+         * 参数 from 为投递位置，用于 TraceLog，保持默认值即可。
+         * 在泵的线程中投递时，延时从当前消息开始执行的时刻算起（参见 MessagePump::getLoopTime()），
+         * 因此在耗时较长的消息中投递的延时消息会相应提前执行。即时消息则以投递时的粗略时间为准
+         * （参见 getPostTime()），优先级的等待时限和排队时间的统计都从这一刻算起。
+         * 即时消息不受时间余量的影响。
+         */
+
+        MessageHandle post(
+            Executable* exec, int id = -1, const Location& from = Location::current());
+        MessageHandle postDelayed(
+            Executable* exec, nsp delay, int id = -1, const Location& from = Location::current());
+        MessageHandle postAtTime(
+            Executable* exec, nsp at_time, int id = -1, const Location& from = Location::current());
+
+        /**
+         * 可调用对象直接在消息内部构造，较小的 lambda 不需要分配内存。
+         * 参见 Closure。
+         */
+        template <typename F, typename = Closure::EnableIfCallable<F>>
+        MessageHandle post(
+            F&& func, int id = -1, const Location& from = Location::current())
+        {
+            return postDelayed(std::forward<F>(func), ns(0), id, from);
+        }
+
+        template <typename F, typename = Closure::EnableIfCallable<F>>
+        MessageHandle postDelayed(
+            F&& func, nsp delay, int id = -1, const Location& from = Location::current())
+        {
+            Message* msg = Message::get();
+            msg->func.emplace(std::forward<F>(func));
+            msg->id = id;
+
+            return postDelayed(msg, delay, from);
+        }
+
+        template <typename F, typename = Closure::EnableIfCallable<F>>
+        MessageHandle postAtTime(
+            F&& func, nsp at_time, int id = -1, const Location& from = Location::current())
+        {
+            Message* msg = Message::get();
+            msg->func.emplace(std::forward<F>(func));
+            msg->id = id;
 
-        void post(const std::function<void()>& func, int id = -1);
-        void postDelayed(const std::function<void()>& func, nsp delay, int id = -1);
-        void postAtTime(const std::function<void()>& func, nsp at_time, int id = -1);
+            return postAtTime(msg, at_time, from);
+        }
 
-        void post(Message* msg);
-        void postDelayed(Message* msg, nsp delay);
-        void postAtTime(Message* msg, nsp at_time);
+        /**
+         * 在本 Cycler 所在的线程中执行 task，完成后在调用线程的泵中执行 reply。
+         * task 有返回值时，reply 以该返回值为参数。
+         * 调用线程必须有 MessagePump。如果调用线程的泵在 task 完成前已销毁，reply 不会执行。
+         * @return task 的句柄，移除后 reply 也不会执行。
+         */
+        template <typename T, typename R>
+        MessageHandle postTaskAndReply(
+            T&& task, R&& reply, const Location& from = Location::current())
+        {
+            return post(internal::TaskAndReply<std::decay_t<T>, std::decay_t<R>>{
+                std::forward<T>(task), std::forward<R>(reply), MessagePump::getCurrent() },
+                -1, from);
+        }
 
-        void post(int id);
-        void postDelayed(int id, nsp delay);
-        void postAtTime(int id, nsp at_time);
+        /**
+         * 在本 Cycler 所在的线程中执行 task，通过返回的 Future 获取其结果。
+         * 如果 task 在执行前被移除，Future 上的回调不会执行。
+         */
+        template <typename T, typename Result = std::invoke_result_t<std::decay_t<T>&>>
+        Future<Result> postTask(T&& task, const Location& from = Location::current()) {
+            Promise<Result> promise;
+            auto future = promise.getFuture();
+            post([t = std::decay_t<T>(std::forward<T>(task)),
+                  p = std::move(promise)]() mutable
+            {
+                if constexpr (std::is_void<Result>::value) {
+                    t();
+                    p.setValue();
+                } else {
+                    p.setValue(t());
+                }
+            }, -1, from);
+            return future;
+        }
+
+        /**
+         * 投递空闲任务，func 的参数为 const IdleDeadline&。
+         * 空闲任务只在泵没有就绪的消息、也没有到期的延时消息时执行，每段空闲时间只执行一个，
+         * 先投递的先执行。任务应在截止时间之前返回，没做完的部分可以再次投递。
+         * @param deadline_hint 最多等待多长时间。超过后即使泵一直不空闲，也会在普通消息之后执行，
+         *                      此时 IdleDeadline::isTimedOut() 为 true。为 0 时一直等待。
+         */
+        template <typename F>
+        MessageHandle postIdle(
+            F&& func, nsp deadline_hint = ns(0), const Location& from = Location::current())
+        {
+            Message* msg = Message::get();
+            msg->func.emplace(internal::IdleTask<std::decay_t<F>>{ std::forward<F>(func) });
+            msg->is_idle = true;
+            msg->time_ns = deadline_hint.count() > 0 ?
+                (deadline_hint + MessagePump::getLoopTime()).count() : 0;
+            msg->from = from;
+
+            auto handle = msg->getHandle(this);
+            enqueueMessage(msg);
+            return handle;
+        }
+
+        MessageHandle post(Message* msg, const Location& from = Location::current());
+        MessageHandle postDelayed(
+            Message* msg, nsp delay, const Location& from = Location::current());
+        MessageHandle postAtTime(
+            Message* msg, nsp at_time, const Location& from = Location::current());
+
+        MessageHandle post(int id, const Location& from = Location::current());
+        MessageHandle postDelayed(int id, nsp delay, const Location& from = Location::current());
+        MessageHandle postAtTime(int id, nsp at_time, const Location& from = Location::current());
+
+        /**
+         * 投递 id 消息，payload 内嵌在消息中，不需要额外分配。
+         * 监听器中通过 Message::getPayload() 取得。
+         */
+        template <typename T>
+        MessageHandle postPayload(int id, T&& payload, const Location& from = Location::current()) {
+            auto msg = Message::get();
+            msg->id = id;
+            msg->emplacePayload<std::decay_t<T>>(std::forward<T>(payload));
+            return post(msg, from);
+        }
+
+        /**
+         * 批量投递 range 中的所有可调用对象，只唤醒泵一次。参见 PostBatch。
+         * range 为右值时，其中的元素会被移走。
+         * @return 投递的消息数量。
+         */
+        template <typename Range>
+        size_t postBatch(Range&& range, int id = -1, const Location& from = Location::current());
 
         void clear();
 
@@ -63,16 +221,160 @@ namespace utl {
         bool hasMessages(int id);
         void removeMessages(int id);
 
+        /**
+         * 判断句柄所指的消息是否仍在等待执行。O(1)，不需要持锁。
+         */
+        bool hasMessage(const MessageHandle& h) const;
+
+        /**
+         * 取消句柄所指的消息。O(1)。
+         * @return 如果消息由本 Cycler 投递、仍在等待执行且成功取消，返回 true。
+         */
+        bool removeMessage(const MessageHandle& h);
+
         void dispatchMessage(const Message& msg);
 
+        /**
+         * 单调时钟的当前时间，即 TimeUtils::upTime()。所有消息的时间都以此为准。
+         */
         static ns now();
 
+        /**
+         * 延时为 delay 的消息的执行时间。
+         * delay 大于 0 时以 MessagePump::getLoopTime() 为起点。
+         * 否则为即时消息，取 TimeUtils::coarseUpTime()，不需要读取精确的时钟。
+         * 粗略时钟与 upTime() 是同一个时钟，只是停留在最近一次时钟中断的时刻，
+         * 因此不会超过 now()，即时消息总是立即就绪；只是等待时限和排队时间的统计会多算最多一个时钟周期。
+         */
+        static ns getPostTime(nsp delay);
+
     private:
+        friend class MessageQueue;
+        friend class PostBatch;
+
+        /**
+         * 设置消息的目标和优先级，跟踪开启时记录投递事件。
+         */
+        void prepareMessage(Message* msg);
+
+        /**
+         * 以 time_ns 为消息的时间放入队列，不再调整。
+         */
+        MessageHandle postMessage(Message* msg, int64_t time_ns, const Location& from);
+
+        /**
+         * 按时间余量调整延时消息的到期时间。
+         * 不晚于 MessagePump::getLoopTime() 的时间已经到期，不作调整。
+         */
+        int64_t applySlack(int64_t time_ns) const;
+
         std::weak_ptr<MessagePump> pump_;
         CyclerListener* listener_;
         std::atomic_bool clear_when_destroy_;
+        std::atomic<Message::Priority> priority_;
+        std::atomic<int64_t> slack_ns_;
+
+        // 本 Cycler 在队列中待执行的消息，由 MessageQueue 持锁维护。
+        Message* queued_;
+    };
+
+
+    /**
+     * 批量投递。
+     * 消息先在本地串成链表，commit() 时一次性放入泵的队列，整批只需要一次原子操作和一次唤醒。
+     * 适合一次产生大量消息的生产者，例如每条解析出的记录对应一个消息。
+     * 批内的消息在 commit() 之前不会执行，但返回的句柄可以立即用于取消。
+     * PostBatch 不是线程安全的。析构时会自动 commit()。
+     */
+    class PostBatch {
+    public:
+        using ns = TimeUtils::ns;
+        using nsp = TimeUtils::nsp;
+
+        explicit PostBatch(Cycler* cycler);
+        ~PostBatch();
+
+        PostBatch(const PostBatch&) = delete;
+        PostBatch& operator=(const PostBatch&) = delete;
+
+        template <typename F, typename = Closure::EnableIfCallable<F>>
+        MessageHandle post(
+            F&& func, int id = -1, const Location& from = Location::current())
+        {
+            return postDelayed(std::forward<F>(func), ns(0), id, from);
+        }
+
+        template <typename F, typename = Closure::EnableIfCallable<F>>
+        MessageHandle postDelayed(
+            F&& func, nsp delay, int id = -1, const Location& from = Location::current())
+        {
+            Message* msg = Message::get();
+            msg->func.emplace(std::forward<F>(func));
+            msg->id = id;
+
+            return postDelayed(msg, delay, from);
+        }
+
+        template <typename F, typename = Closure::EnableIfCallable<F>>
+        MessageHandle postAtTime(
+            F&& func, nsp at_time, int id = -1, const Location& from = Location::current())
+        {
+            Message* msg = Message::get();
+            msg->func.emplace(std::forward<F>(func));
+            msg->id = id;
+
+            return postAtTime(msg, at_time, from);
+        }
+
+        /**
+         * 即时消息的时间在 commit() 时统一取一次，参见 Cycler::getPostTime()。
+         */
+        MessageHandle post(Message* msg, const Location& from = Location::current());
+        MessageHandle postDelayed(
+            Message* msg, nsp delay, const Location& from = Location::current());
+        MessageHandle postAtTime(
+            Message* msg, nsp at_time, const Location& from = Location::current());
+
+        /**
+         * 尚未放入队列的消息数量。
+         */
+        size_t size() const;
+
+        /**
+         * 将批内的消息放入泵的队列并唤醒泵。之后可以继续使用本对象投递新的一批。
+         * 如果泵已销毁，消息会被回收。
+         */
+        void commit();
+
+    private:
+        MessageHandle add(Message* msg, const Location& from);
+
+        Cycler* cycler_;
+        // 按投递顺序的逆序串起来，head_ 为最后投递的消息。
+        Message* head_;
+        Message* tail_;
+        size_t count_;
+        // 批内尚未填写时间的即时消息数量
+        size_t immediate_;
     };
 
+
+    template <typename Range>
+    size_t Cycler::postBatch(Range&& range, int id, const Location& from) {
+        PostBatch batch(this);
+        for (auto&& func : range) {
+            if constexpr (std::is_lvalue_reference<Range>::value) {
+                batch.post(func, id, from);
+            } else {
+                batch.post(std::move(func), id, from);
+            }
+        }
+
+        auto count = batch.size();
+        batch.commit();
+        return count;
+    }
+
 }
 
 #endif  // UTILS_MESSAGE_CYCLER_H_
\ No newline at end of file
@@ -0,0 +1,317 @@
+// Copyright (c) 2016 ucclkp <ucclkp@gmail.com>.
+// This file is part of utils project.
+//
+// This program is licensed under GPLv3 license that can be
+// found in the LICENSE file.
+
+#ifndef UTILS_MESSAGE_FUTURE_HPP_
+#define UTILS_MESSAGE_FUTURE_HPP_
+
+#include <atomic>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "utils/message/message.h"
+#include "utils/message/message_pump.h"
+
+
+namespace utl {
+
+    template <typename T>
+    class Future;
+
+    namespace internal {
+
+        /**
+         * Promise 与 Future 共享的状态。
+         * 结果直接存放在内部，整个状态只有一次分配。
+         * 结果与回调谁后到达，谁就负责把回调投递到 Future::then() 调用时所在的泵，
+         * 两者之间只通过 flags_ 上的一次原子操作交接，不需要持锁。
+         */
+        template <typename T>
+        class FutureState {
+        public:
+            enum Flags : unsigned {
+                HAS_VALUE        = 1u << 0,
+                HAS_CONTINUATION = 1u << 1,
+                BROKEN           = 1u << 2,
+            };
+
+            FutureState()
+                : refs_(1), flags_(0) {}
+
+            ~FutureState() {
+                if constexpr (!std::is_void<T>::value) {
+                    if (flags_.load(std::memory_order_relaxed) & HAS_VALUE) {
+                        valuePtr()->~T();
+                    }
+                }
+            }
+
+            void addRef() {
+                refs_.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            void release() {
+                if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    delete this;
+                }
+            }
+
+            template <typename... Args>
+            void setValue(Args&&... args) {
+                if constexpr (!std::is_void<T>::value) {
+                    new (storage_) T(std::forward<Args>(args)...);
+                }
+                auto prev = flags_.fetch_or(HAS_VALUE, std::memory_order_acq_rel);
+                if (prev & HAS_CONTINUATION) {
+                    dispatch();
+                }
+            }
+
+            void setBroken() {
+                auto prev = flags_.fetch_or(BROKEN, std::memory_order_acq_rel);
+                if (prev & HAS_CONTINUATION) {
+                    dropContinuation();
+                }
+            }
+
+            void setContinuation(Closure&& c, const std::weak_ptr<MessagePump>& origin) {
+                continuation_ = std::move(c);
+                origin_ = origin;
+                auto prev = flags_.fetch_or(HAS_CONTINUATION, std::memory_order_acq_rel);
+                if (prev & HAS_VALUE) {
+                    dispatch();
+                } else if (prev & BROKEN) {
+                    dropContinuation();
+                }
+            }
+
+            bool isReady() const {
+                return (flags_.load(std::memory_order_acquire) & HAS_VALUE) != 0;
+            }
+
+            T takeValue() {
+                if constexpr (!std::is_void<T>::value) {
+                    return std::move(*valuePtr());
+                }
+            }
+
+        private:
+            void dropContinuation() {
+                // 回调永远不会执行。它可能持有本状态的最后一个引用，
+                // 因此先移到局部变量中，避免析构时仍在访问成员。
+                Closure c(std::move(continuation_));
+            }
+
+            void dispatch() {
+                auto msg = Message::get();
+                msg->func = std::move(continuation_);
+                MessagePump::postTo(origin_, msg);
+            }
+
+            T* valuePtr() {
+                return std::launder(reinterpret_cast<T*>(storage_));
+            }
+
+            using Storage = std::conditional_t<std::is_void<T>::value, char, T>;
+
+            std::atomic<unsigned> refs_;
+            std::atomic<unsigned> flags_;
+            alignas(Storage) unsigned char storage_[sizeof(Storage)];
+            Closure continuation_;
+            std::weak_ptr<MessagePump> origin_;
+        };
+
+        /**
+         * 持有一个 FutureState 引用的指针。
+         */
+        template <typename T>
+        class FutureRef {
+        public:
+            FutureRef() = default;
+            explicit FutureRef(FutureState<T>* s)
+                : state_(s) {}
+
+            FutureRef(const FutureRef& rhs)
+                : state_(rhs.state_)
+            {
+                if (state_) {
+                    state_->addRef();
+                }
+            }
+
+            FutureRef(FutureRef&& rhs) noexcept
+                : state_(std::exchange(rhs.state_, nullptr)) {}
+
+            ~FutureRef() {
+                if (state_) {
+                    state_->release();
+                }
+            }
+
+            FutureRef& operator=(FutureRef rhs) noexcept {
+                std::swap(state_, rhs.state_);
+                return *this;
+            }
+
+            FutureState<T>* get() const { return state_; }
+            FutureState<T>* operator->() const { return state_; }
+            explicit operator bool() const { return state_ != nullptr; }
+
+        private:
+            FutureState<T>* state_ = nullptr;
+        };
+
+    }
+
+    /**
+     * 结果的生产端，只能移动。
+     * 如果析构时仍未设置结果，对应 Future 上的回调将永远不会执行。
+     */
+    template <typename T>
+    class Promise {
+    public:
+        Promise()
+            : state_(new internal::FutureState<T>()) {}
+
+        Promise(Promise&&) noexcept = default;
+        Promise& operator=(Promise&& rhs) noexcept {
+            if (this != &rhs) {
+                breakIfUnset();
+                state_ = std::move(rhs.state_);
+                set_ = rhs.set_;
+            }
+            return *this;
+        }
+
+        ~Promise() {
+            breakIfUnset();
+        }
+
+        /**
+         * 只能调用一次。
+         */
+        Future<T> getFuture() {
+            return Future<T>(state_);
+        }
+
+        /**
+         * 设置结果，可以在任意线程中调用，只能调用一次。
+         */
+        template <typename... Args>
+        void setValue(Args&&... args) {
+            if (!state_ || set_) {
+                return;
+            }
+            set_ = true;
+            state_->setValue(std::forward<Args>(args)...);
+        }
+
+    private:
+        void breakIfUnset() {
+            if (state_ && !set_) {
+                state_->setBroken();
+            }
+        }
+
+        internal::FutureRef<T> state_;
+        bool set_ = false;
+    };
+
+    /**
+     * 结果的消费端，只能移动。
+     * 通过 then() 设置的回调总是在调用 then() 的线程的泵中执行，
+     * 即使调用时结果已经可用，也会通过泵异步执行。
+     */
+    template <typename T>
+    class Future {
+    public:
+        Future() = default;
+        Future(Future&&) noexcept = default;
+        Future& operator=(Future&&) noexcept = default;
+
+        bool isValid() const {
+            return !!state_;
+        }
+
+        bool isReady() const {
+            return state_ && state_->isReady();
+        }
+
+        /**
+         * 设置结果可用时的回调，调用后该 Future 失效。
+         * 对于 Future<void>，回调没有参数；否则回调的参数为结果。
+         * 当前线程必须有 MessagePump。
+         */
+        template <typename F>
+        void then(F&& func) && {
+            if (!state_) {
+                return;
+            }
+
+            auto s = state_.get();
+            Closure c([f = std::decay_t<F>(std::forward<F>(func)),
+                       ref = std::move(state_)]() mutable
+            {
+                if constexpr (std::is_void<T>::value) {
+                    f();
+                } else {
+                    f(ref->takeValue());
+                }
+            });
+            s->setContinuation(std::move(c), MessagePump::getCurrent());
+        }
+
+    private:
+        friend class Promise<T>;
+
+        explicit Future(const internal::FutureRef<T>& ref)
+            : state_(ref) {}
+
+        internal::FutureRef<T> state_;
+    };
+
+    namespace internal {
+
+        template <typename R, typename Result>
+        struct ReplyWithResult {
+            void operator()() {
+                reply(std::move(result));
+            }
+
+            R reply;
+            Result result;
+        };
+
+        /**
+         * Cycler::postTaskAndReply() 投递的任务。
+         * 结果随回复消息的 Closure 一起传回，较小的结果不需要额外分配内存。
+         */
+        template <typename T, typename R>
+        struct TaskAndReply {
+            void operator()() {
+                using Result = std::invoke_result_t<T&>;
+
+                auto msg = Message::get();
+                if constexpr (std::is_void<Result>::value) {
+                    task();
+                    msg->func.emplace(std::move(reply));
+                } else {
+                    msg->func.emplace(ReplyWithResult<R, Result>{ std::move(reply), task() });
+                }
+                MessagePump::postTo(origin, msg);
+            }
+
+            T task;
+            R reply;
+            std::weak_ptr<MessagePump> origin;
+        };
+
+    }
+
+}
+
+#endif  // UTILS_MESSAGE_FUTURE_HPP_
@@ -0,0 +1,125 @@
+// Copyright (c) 2016 ucclkp <ucclkp@gmail.com>.
+// This file is part of utils project.
+//
+// This program is licensed under GPLv3 license that can be
+// found in the LICENSE file.
+
+#include "utils/message/hang_watchdog.h"
+
+#include <algorithm>
+
+#include "utils/log.h"
+#include "utils/message/message_pump.h"
+
+
+namespace utl {
+
+    HangWatchdog::HangWatchdog(nsp threshold, nsp interval)
+        : threshold_ns_(std::max(threshold.count(), int64_t(1))),
+          interval_ns_(interval.count() > 0 ? interval.count() : std::max(threshold_ns_ / 4, int64_t(1))),
+          hang_count_(0)
+    {
+        thread_ = std::thread(&HangWatchdog::run, this);
+    }
+
+    HangWatchdog::~HangWatchdog() {
+        {
+            std::lock_guard<std::mutex> lk(sync_);
+            stopped_ = true;
+        }
+        cv_.notify_one();
+        thread_.join();
+    }
+
+    void HangWatchdog::watch(const std::shared_ptr<MessagePump>& pump, const std::string& name) {
+        if (!pump) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lk(sync_);
+        for (const auto& w : watched_) {
+            if (w.pump.lock() == pump) {
+                return;
+            }
+        }
+
+        Watched w;
+        w.pump = pump;
+        w.name = name;
+        watched_.push_back(std::move(w));
+    }
+
+    void HangWatchdog::unwatch(const std::shared_ptr<MessagePump>& pump) {
+        std::lock_guard<std::mutex> lk(sync_);
+        watched_.erase(
+            std::remove_if(watched_.begin(), watched_.end(), [&pump](const Watched& w) {
+                return w.pump.lock() == pump;
+            }),
+            watched_.end());
+    }
+
+    void HangWatchdog::setHandler(Handler handler) {
+        std::lock_guard<std::mutex> lk(sync_);
+        handler_ = std::move(handler);
+    }
+
+    uint64_t HangWatchdog::getHangCount() const {
+        return hang_count_.load(std::memory_order_relaxed);
+    }
+
+    void HangWatchdog::run() {
+        std::unique_lock<std::mutex> lk(sync_);
+        while (!stopped_) {
+            cv_.wait_for(lk, ns(interval_ns_));
+            if (stopped_) {
+                break;
+            }
+
+            lk.unlock();
+            check(TimeUtils::upTime().count());
+            lk.lock();
+        }
+    }
+
+    void HangWatchdog::check(int64_t cur) {
+        std::vector<HangInfo> hangs;
+        Handler handler;
+        {
+            std::lock_guard<std::mutex> lk(sync_);
+            for (auto it = watched_.begin(); it != watched_.end();) {
+                auto pump = it->pump.lock();
+                if (!pump) {
+                    it = watched_.erase(it);
+                    continue;
+                }
+
+                PumpHeartbeat::Snapshot beat;
+                if (pump->getHeartbeat().read(&beat) &&
+                    beat.start_ns != 0 &&
+                    beat.start_ns != it->reported_start_ns &&
+                    cur - beat.start_ns >= threshold_ns_)
+                {
+                    it->reported_start_ns = beat.start_ns;
+                    hangs.push_back({ it->name, beat.id, beat.from, ns(cur - beat.start_ns) });
+                }
+                ++it;
+            }
+            handler = handler_;
+        }
+
+        for (const auto& info : hangs) {
+            hang_count_.fetch_add(1, std::memory_order_relaxed);
+            if (handler) {
+                handler(info);
+                continue;
+            }
+
+            LOG(Log::WARNING) << "MessagePump \"" << info.name << "\" is stalled for "
+                << std::chrono::duration_cast<std::chrono::milliseconds>(info.stalled).count()
+                << "ms by message " << info.id << " posted from "
+                << info.from.getFunction() << " (" << info.from.getFile() << ":"
+                << info.from.getLine() << ")";
+        }
+    }
+
+}
@@ -0,0 +1,99 @@
+// Copyright (c) 2016 ucclkp <ucclkp@gmail.com>.
+// This file is part of utils project.
+//
+// This program is licensed under GPLv3 license that can be
+// found in the LICENSE file.
+
+#ifndef UTILS_MESSAGE_HANG_WATCHDOG_H_
+#define UTILS_MESSAGE_HANG_WATCHDOG_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "utils/message/location.hpp"
+#include "utils/time_utils.h"
+
+
+namespace utl {
+
+    class MessagePump;
+
+    /**
+     * 泵卡死的监视器。
+     * 在独立的线程中定期读取各个泵的心跳（参见 PumpHeartbeat），
+     * 某个消息执行的时间超过阈值时，通过 utl::Log 输出该消息的 id、投递位置和已执行的时间。
+     * 每个卡住的消息只报告一次。被监视的泵不需要做额外的事情。
+     */
+    class HangWatchdog {
+    public:
+        using ns = TimeUtils::ns;
+        using nsp = TimeUtils::nsp;
+
+        struct HangInfo {
+            std::string name;
+            int id;
+            Location from;
+            ns stalled;
+        };
+
+        using Handler = std::function<void(const HangInfo& info)>;
+
+        /**
+         * @param threshold 单个消息执行超过该时间时视为卡住。
+         * @param interval 检查的间隔，为 0 时使用 threshold 的四分之一。
+         */
+        explicit HangWatchdog(nsp threshold, nsp interval = ns(0));
+        ~HangWatchdog();
+
+        HangWatchdog(const HangWatchdog&) = delete;
+        HangWatchdog& operator=(const HangWatchdog&) = delete;
+
+        /**
+         * 开始监视泵。泵销毁后自动停止监视。可以在任意线程中调用。
+         * @param name 报告中泵的名称。
+         */
+        void watch(const std::shared_ptr<MessagePump>& pump, const std::string& name);
+        void unwatch(const std::shared_ptr<MessagePump>& pump);
+
+        /**
+         * 替换默认的报告方式（输出日志）。在监视线程中调用，应在 watch() 之前设置。
+         */
+        void setHandler(Handler handler);
+
+        /**
+         * 已报告的卡死次数。
+         */
+        uint64_t getHangCount() const;
+
+    private:
+        struct Watched {
+            std::weak_ptr<MessagePump> pump;
+            std::string name;
+            // 最近一次报告的消息的开始时间，避免重复报告
+            int64_t reported_start_ns = 0;
+        };
+
+        void run();
+        void check(int64_t cur);
+
+        int64_t threshold_ns_;
+        int64_t interval_ns_;
+        Handler handler_;
+        std::vector<Watched> watched_;
+        std::atomic<uint64_t> hang_count_;
+
+        bool stopped_ = false;
+        std::mutex sync_;
+        std::condition_variable cv_;
+        std::thread thread_;
+    };
+
+}
+
+#endif  // UTILS_MESSAGE_HANG_WATCHDOG_H_
@@ -0,0 +1,291 @@
+// Copyright (c) 2016 ucclkp <ucclkp@gmail.com>.
+// This file is part of utils project.
+//
+// This program is licensed under GPLv3 license that can be
+// found in the LICENSE file.
+
+#include "utils/message/linux/message_pump_linux.h"
+
+#include <cerrno>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "utils/log.h"
+#include "utils/message/message_queue.h"
+
+
+namespace {
+
+    // epoll 事件的 data 高 32 位为注册序号，低 32 位为描述符。
+    // 泵自身的 eventfd 和 timerfd 的序号为 0。
+    uint64_t makeEventData(int fd, uint32_t seq) {
+        return (uint64_t(seq) << 32) | uint32_t(fd);
+    }
+
+    uint32_t toEpollEvents(unsigned int events) {
+        uint32_t result = 0;
+        if (events & utl::MessagePump::FE_READ) {
+            result |= EPOLLIN | EPOLLRDHUP;
+        }
+        if (events & utl::MessagePump::FE_WRITE) {
+            result |= EPOLLOUT;
+        }
+        if (events & utl::MessagePump::FE_EDGE) {
+            result |= EPOLLET;
+        }
+        return result;
+    }
+
+    unsigned int fromEpollEvents(uint32_t events) {
+        unsigned int result = 0;
+        if (events & (EPOLLIN | EPOLLRDHUP)) {
+            result |= utl::MessagePump::FE_READ;
+        }
+        if (events & EPOLLOUT) {
+            result |= utl::MessagePump::FE_WRITE;
+        }
+        if (events & (EPOLLERR | EPOLLHUP)) {
+            result |= utl::MessagePump::FE_ERROR;
+        }
+        return result;
+    }
+
+}
+
+namespace utl {
+namespace lnx {
+
+    MessagePumpLinux::MessagePumpLinux() {
+        epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_fd_ == -1) {
+            LOG(Log::ERR) << "Cannot create epoll: " << errno;
+            return;
+        }
+
+        event_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (event_fd_ == -1) {
+            LOG(Log::ERR) << "Cannot create eventfd: " << errno;
+            return;
+        }
+
+        timer_fd_ = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (timer_fd_ == -1) {
+            LOG(Log::ERR) << "Cannot create timerfd: " << errno;
+            return;
+        }
+
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.u64 = makeEventData(event_fd_, 0);
+        if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, event_fd_, &ev) != 0) {
+            LOG(Log::ERR) << "Cannot watch eventfd: " << errno;
+            return;
+        }
+
+        ev.events = EPOLLIN;
+        ev.data.u64 = makeEventData(timer_fd_, 0);
+        if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, timer_fd_, &ev) != 0) {
+            LOG(Log::ERR) << "Cannot watch timerfd: " << errno;
+            return;
+        }
+
+        is_initialized_ = true;
+    }
+
+    MessagePumpLinux::~MessagePumpLinux() {
+        if (timer_fd_ != -1) {
+            ::close(timer_fd_);
+        }
+        if (event_fd_ != -1) {
+            ::close(event_fd_);
+        }
+        if (epoll_fd_ != -1) {
+            ::close(epoll_fd_);
+        }
+        is_initialized_ = false;
+    }
+
+    void MessagePumpLinux::wakeup() {
+        if (is_initialized_) {
+            uint64_t val = 1;
+            ssize_t ret = ::write(event_fd_, &val, sizeof(val));
+            // EAGAIN 表示计数器已满，此时泵必然会被唤醒，可以忽略。
+            ubassert(ret == sizeof(val) || errno == EAGAIN);
+        }
+    }
+
+    void MessagePumpLinux::loop() {
+        for (;;) {
+            bool has_more_work = platformWork();
+            if (context_.top().quit_imm_) {
+                break;
+            }
+
+            has_more_work |= cosume();
+            if (context_.top().quit_imm_) {
+                break;
+            }
+
+            int64_t delay_ns;
+            has_more_work |= cosumeDelayed(&delay_ns);
+            if (context_.top().quit_imm_) {
+                break;
+            }
+
+            if (has_more_work) {
+                continue;
+            }
+
+            if (context_.top().quit_when_idle_) {
+                break;
+            }
+
+            if (cosumeIdle(delay_ns)) {
+                continue;
+            }
+
+            wait(delay_ns);
+        }
+    }
+
+    bool MessagePumpLinux::watchFd(int fd, unsigned int events, FdCallback callback) {
+        if (!is_initialized_ || fd < 0 || !callback) {
+            return false;
+        }
+        if (!(events & (FE_READ | FE_WRITE))) {
+            LOG(Log::ERR) << "No event to watch for fd: " << fd;
+            return false;
+        }
+
+        // 序号 0 留给泵自身的描述符
+        if (++watch_seq_ == 0) {
+            ++watch_seq_;
+        }
+
+        epoll_event ev{};
+        ev.events = toEpollEvents(events);
+        ev.data.u64 = makeEventData(fd, watch_seq_);
+
+        auto it = watches_.find(fd);
+        int op = (it == watches_.end()) ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+        if (::epoll_ctl(epoll_fd_, op, fd, &ev) != 0) {
+            LOG(Log::ERR) << "Cannot watch fd " << fd << ": " << errno;
+            return false;
+        }
+
+        // 不修改旧的 Watch，它可能正在执行回调
+        auto watch = std::make_shared<Watch>();
+        watch->callback = std::move(callback);
+        watch->seq = watch_seq_;
+        watches_[fd] = std::move(watch);
+        return true;
+    }
+
+    void MessagePumpLinux::unwatch(int fd) {
+        auto it = watches_.find(fd);
+        if (it == watches_.end()) {
+            return;
+        }
+
+        watches_.erase(it);
+        if (::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr) != 0) {
+            // 描述符已被关闭时，内核已自动将其移出 epoll
+            ubassert(errno == EBADF || errno == ENOENT);
+        }
+    }
+
+    void MessagePumpLinux::armTimer(int64_t delay_ns) {
+        itimerspec spec{};
+        if (delay_ns >= 0) {
+            // it_value 全为 0 会解除定时器，因此至少要设置 1ns。
+            if (delay_ns == 0) {
+                delay_ns = 1;
+            }
+            spec.it_value.tv_sec = time_t(delay_ns / 1000000000);
+            spec.it_value.tv_nsec = long(delay_ns % 1000000000);
+        } else if (!timer_armed_) {
+            return;
+        }
+
+        if (::timerfd_settime(timer_fd_, 0, &spec, nullptr) != 0) {
+            LOG(Log::ERR) << "Cannot arm timerfd: " << errno;
+            return;
+        }
+        timer_armed_ = delay_ns >= 0;
+    }
+
+    // static
+    void MessagePumpLinux::drainFd(int fd) {
+        uint64_t val;
+        while (::read(fd, &val, sizeof(val)) == sizeof(val)) {}
+    }
+
+    void MessagePumpLinux::wait(int64_t delay_ns) {
+        if (!is_initialized_) {
+            return;
+        }
+
+        armTimer(delay_ns);
+
+        epoll_event events[kMaxEvents];
+        int count = ::epoll_wait(epoll_fd_, events, kMaxEvents, -1);
+        if (count == -1) {
+            ubassert(errno == EINTR);
+            return;
+        }
+
+        dispatchEvents(events, count);
+    }
+
+    bool MessagePumpLinux::platformWork() {
+        if (!is_initialized_ || watches_.empty()) {
+            return false;
+        }
+
+        // 消息繁忙时泵不会进入 wait()，在这里轮询一次，以免描述符的事件被饿死。
+        epoll_event events[kMaxEvents];
+        int count = ::epoll_wait(epoll_fd_, events, kMaxEvents, 0);
+        if (count <= 0) {
+            ubassert(count == 0 || errno == EINTR);
+            return false;
+        }
+
+        return dispatchEvents(events, count);
+    }
+
+    bool MessagePumpLinux::dispatchEvents(const epoll_event* events, int count) {
+        bool dispatched = false;
+        for (int i = 0; i < count; ++i) {
+            int fd = int(uint32_t(events[i].data.u64));
+            auto seq = uint32_t(events[i].data.u64 >> 32);
+            if (seq == 0) {
+                if (fd == timer_fd_) {
+                    timer_armed_ = false;
+                }
+                drainFd(fd);
+                continue;
+            }
+
+            // 之前的回调可能已取消或替换了该描述符的监视
+            auto it = watches_.find(fd);
+            if (it == watches_.end() || it->second->seq != seq) {
+                continue;
+            }
+
+            // 持有一份引用，回调中可以安全地调用 unwatch()
+            auto watch = it->second;
+            watch->callback(fd, fromEpollEvents(events[i].events));
+            dispatched = true;
+
+            if (context_.top().quit_imm_) {
+                break;
+            }
+        }
+        return dispatched;
+    }
+
+}
+}
@@ -0,0 +1,69 @@
+// Copyright (c) 2016 ucclkp <ucclkp@gmail.com>.
+// This file is part of utils project.
+//
+// This program is licensed under GPLv3 license that can be
+// found in the LICENSE file.
+
+#ifndef UTILS_MESSAGE_LINUX_MESSAGE_PUMP_LINUX_H_
+#define UTILS_MESSAGE_LINUX_MESSAGE_PUMP_LINUX_H_
+
+#include <memory>
+#include <unordered_map>
+
+#include "utils/message/message_pump.h"
+
+struct epoll_event;
+
+
+namespace utl {
+namespace lnx {
+
+    class MessagePumpLinux : public MessagePump {
+    public:
+        ~MessagePumpLinux();
+
+        void wakeup() override;
+        void loop() override;
+
+        bool watchFd(int fd, unsigned int events, FdCallback callback) override;
+        void unwatch(int fd) override;
+
+    private:
+        friend class MessagePump;
+
+        struct Watch {
+            FdCallback callback;
+            // 注册序号，用于识别描述符被取消监视后仍留在本轮结果中的过期事件
+            uint32_t seq;
+        };
+
+        MessagePumpLinux();
+
+        void wait(int64_t delay_ns);
+        bool platformWork();
+
+        /**
+         * 处理 epoll 返回的事件。
+         * @return 如果执行了描述符的回调，返回 true。
+         */
+        bool dispatchEvents(const epoll_event* events, int count);
+
+        void armTimer(int64_t delay_ns);
+        static void drainFd(int fd);
+
+        int epoll_fd_ = -1;
+        int event_fd_ = -1;
+        int timer_fd_ = -1;
+        bool timer_armed_ = false;
+        bool is_initialized_ = false;
+
+        std::unordered_map<int, std::shared_ptr<Watch>> watches_;
+        uint32_t watch_seq_ = 0;
+
+        static constexpr int kMaxEvents = 16;
+    };
+
+}
+}
+
+#endif  // UTILS_MESSAGE_LINUX_MESSAGE_PUMP_LINUX_H_
@@ -0,0 +1,59 @@
+// Copyright (c) 2016 ucclkp <ucclkp@gmail.com>.
+// This file is part of utils project.
+//
+// This program is licensed under GPLv3 license that can be
+// found in the LICENSE file.
+
+#ifndef UTILS_MESSAGE_LOCATION_HPP_
+#define UTILS_MESSAGE_LOCATION_HPP_
+
+#if defined(__GNUC__) || defined(__clang__) || (defined(_MSC_VER) && _MSC_VER >= 1926)
+#define UTL_HAS_BUILTIN_LOCATION
+#endif
+
+
+namespace utl {
+
+    /**
+     * 源代码中的位置，用于记录消息是在哪里投递的。
+     * 作为函数参数的默认值 Location::current() 时，记录的是调用该函数的位置，
+     * 因此调用方不需要做任何改动。只保存指向字符串字面量的指针，复制的开销很小。
+     */
+    class Location {
+    public:
+        constexpr Location() = default;
+        constexpr Location(const char* file, const char* function, int line)
+            : file_(file), function_(function), line_(line) {}
+
+#ifdef UTL_HAS_BUILTIN_LOCATION
+        static constexpr Location current(
+            const char* file = __builtin_FILE(),
+            const char* function = __builtin_FUNCTION(),
+            int line = __builtin_LINE())
+        {
+            return Location(file, function, line);
+        }
+#else
+        static constexpr Location current() {
+            return Location();
+        }
+#endif
+
+        bool isNull() const { return !file_; }
+
+        /**
+         * 以下字符串均不会为 nullptr。
+         */
+        const char* getFile() const { return file_ ? file_ : ""; }
+        const char* getFunction() const { return function_ ? function_ : ""; }
+        int getLine() const { return line_; }
+
+    private:
+        const char* file_ = nullptr;
+        const char* function_ = nullptr;
+        int line_ = 0;
+    };
+
+}
+
+#endif  // UTILS_MESSAGE_LOCATION_HPP_
@@ -105,6 +105,10 @@ namespace mac {
                 break;
             }
 
+            if (cosumeIdle(delay_ns)) {
+                continue;
+            }
+
             wait(delay_ns);
         }
     }
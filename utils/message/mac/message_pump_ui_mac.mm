@@ -125,8 +125,14 @@ namespace mac {
             return false;
         }
 
-        if (!has_more_work && context_.top().quit_when_idle_) {
-            return false;
+        if (!has_more_work) {
+            if (context_.top().quit_when_idle_) {
+                return false;
+            }
+            if (cosumeIdle(delay)) {
+                // 空闲任务之后可能有新的工作，尽快再检查一次
+                delay = 0;
+            }
         }
 
         wait(delay);
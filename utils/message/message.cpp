@@ -12,19 +12,32 @@ namespace utl {
     // static
     Message::MessagePool Message::s_pool_;
 
+    // 各行按缓存行对齐。具体的大小随平台的 ABI 变化，只限制上限。
+    static_assert(alignof(Message) == 64, "Message must be cache line aligned");
+    static_assert(sizeof(Message) % 64 == 0, "Message must fill whole cache lines");
+    static_assert(sizeof(Message) <= 6 * 64, "Message is too large");
+
     Message::Message()
-        : id(-1),
+        : next(nullptr),
           time_ns(0),
           target(nullptr),
           callback(nullptr),
+          id(-1),
+          priority(PRI_NORMAL),
+          is_idle(false),
+          is_slack(false),
+          flow_id(0),
+          index_next(nullptr),
+          index_pprev(nullptr),
           ui1(0),
           ui2(0),
           data(nullptr),
-          next(nullptr),
-          is_barrier(false) {
+          payload_type_(nullptr),
+          state_(0) {
     }
 
     Message::~Message() {
+        destroyPayload();
     }
 
     // static
@@ -32,6 +45,26 @@ namespace utl {
         return s_pool_.get();
     }
 
+    // static
+    void Message::reservePool(size_t count) {
+        s_pool_.reserve(count);
+    }
+
+    // static
+    void Message::prefillLocalCache() {
+        s_pool_.prefillLocal();
+    }
+
+    // static
+    void Message::setPoolMagazineSize(size_t size) {
+        s_pool_.setMagazineSize(size);
+    }
+
+    // static
+    Message::PoolStats Message::getPoolStats() {
+        return s_pool_.getStats();
+    }
+
     void Message::reset() {
         id = -1;
         time_ns = 0;
@@ -42,17 +75,116 @@ namespace utl {
         ui2 = 0;
         data = nullptr;
         shared_data.reset();
-        is_barrier = false;
+        destroyPayload();
+        from = Location();
+        flow_id = 0;
+        priority = PRI_NORMAL;
+        is_idle = false;
+        is_slack = false;
+        index_next = nullptr;
+        index_pprev = nullptr;
+
+        // 进入下一代，同时清除所有标记。
+        auto state = state_.load(std::memory_order_relaxed);
+        state_.store(
+            ((state >> STATE_GEN_SHIFT) + 1) << STATE_GEN_SHIFT, std::memory_order_release);
 
         s_pool_.put(this);
     }
 
+    MessageHandle Message::getHandle(const void* owner) const {
+        return MessageHandle(
+            const_cast<Message*>(this),
+            state_.load(std::memory_order_relaxed) >> STATE_GEN_SHIFT, owner);
+    }
+
+    // static
+    bool Message::isPending(const MessageHandle& h) {
+        if (!h.msg_) {
+            return false;
+        }
+
+        auto state = h.msg_->state_.load(std::memory_order_acquire);
+        return (state >> STATE_GEN_SHIFT) == h.gen_ &&
+            !(state & (STATE_CANCELLED | STATE_CLAIMED));
+    }
+
+    // static
+    bool Message::cancel(const MessageHandle& h) {
+        if (!h.msg_) {
+            return false;
+        }
+
+        auto state = h.msg_->state_.load(std::memory_order_relaxed);
+        do {
+            if ((state >> STATE_GEN_SHIFT) != h.gen_ ||
+                (state & (STATE_CANCELLED | STATE_CLAIMED)))
+            {
+                return false;
+            }
+        } while (!h.msg_->state_.compare_exchange_weak(
+            state, state | STATE_CANCELLED,
+            std::memory_order_acq_rel, std::memory_order_relaxed));
+        return true;
+    }
+
+    bool Message::claim() {
+        auto state = state_.load(std::memory_order_relaxed);
+        do {
+            if (state & (STATE_CANCELLED | STATE_CLAIMED)) {
+                return false;
+            }
+        } while (!state_.compare_exchange_weak(
+            state, state | STATE_CLAIMED, std::memory_order_acq_rel, std::memory_order_relaxed));
+        return true;
+    }
+
+    bool Message::isCancelled() const {
+        return (state_.load(std::memory_order_acquire) & STATE_CANCELLED) != 0;
+    }
+
+    bool Message::isSettled() const {
+        return (state_.load(std::memory_order_acquire) &
+            (STATE_CANCELLED | STATE_CLAIMED)) != 0;
+    }
+
+    void Message::setInBatch(bool in_batch) {
+        if (in_batch) {
+            state_.fetch_or(STATE_IN_BATCH, std::memory_order_relaxed);
+        } else {
+            state_.fetch_and(~uint64_t(STATE_IN_BATCH), std::memory_order_relaxed);
+        }
+    }
+
+    bool Message::isInBatch() const {
+        return (state_.load(std::memory_order_relaxed) & STATE_IN_BATCH) != 0;
+    }
+
+    void Message::releasePayload() {
+        callback = nullptr;
+        func = nullptr;
+        shared_data.reset();
+        destroyPayload();
+    }
+
+    void Message::destroyPayload() {
+        if (payload_type_) {
+            // 先清除，析构中即使再访问本消息也不会重复析构。
+            auto type = payload_type_;
+            payload_type_ = nullptr;
+            type->destroy(payload_);
+        }
+    }
+
 
     // Message::MessagePool
+    thread_local Message::MessagePool::Magazine Message::MessagePool::magazine_;
+    thread_local bool Message::MessagePool::magazine_retired_ = false;
+
     Message::MessagePool::MessagePool()
-        : pool_(nullptr)
+        : magazine_size_(kDefaultMagazineSize)
     {
-        reserve(100);
+        reserve(kDefaultPoolReserve);
     }
 
     Message::MessagePool::~MessagePool() {
@@ -60,61 +192,228 @@ namespace utl {
     }
 
     void Message::MessagePool::reserve(size_t cnt) {
-        if (cnt == 0) {
-            return;
-        }
-
         std::lock_guard<std::mutex> lg(pool_sync_);
-        if (!pool_) {
-            pool_ = new Message();
-        }
 
-        auto it = pool_;
         size_t cur = 0;
-        while (it) {
-            ++cur;
-            if (!it->next) {
-                break;
+        for (const auto& b : depot_) {
+            cur += b.count;
+        }
+
+        auto size = magazine_size_.load(std::memory_order_relaxed);
+        while (cur < cnt) {
+            Batch b{ nullptr, 0 };
+            for (; b.count < size && cur < cnt; ++b.count, ++cur) {
+                auto msg = new Message();
+                msg->next = b.head;
+                b.head = msg;
             }
-            it = it->next;
+            depot_.push_back(b);
         }
+    }
 
-        for (; cur < cnt; ++cur) {
+    void Message::MessagePool::prefillLocal() {
+        if (magazine_retired_) {
+            return;
+        }
+
+        auto mag = getMagazine();
+        auto size = magazine_size_.load(std::memory_order_relaxed);
+        while (mag->count < size) {
             auto msg = new Message();
-            it->next = msg;
-            it = msg;
+            msg->next = mag->head;
+            mag->head = msg;
+            ++mag->count;
+            increase(mag->allocations);
         }
     }
 
+    void Message::MessagePool::setMagazineSize(size_t size) {
+        if (size == 0) {
+            return;
+        }
+        magazine_size_.store(size, std::memory_order_relaxed);
+    }
+
+    Message::PoolStats Message::MessagePool::getStats() {
+        std::lock_guard<std::mutex> lg(pool_sync_);
+
+        auto stats = retired_;
+        for (auto mag : magazines_) {
+            stats.hits += mag->hits.load(std::memory_order_relaxed);
+            stats.misses += mag->misses.load(std::memory_order_relaxed);
+            stats.refills += mag->refills.load(std::memory_order_relaxed);
+            stats.allocations += mag->allocations.load(std::memory_order_relaxed);
+            stats.flushes += mag->flushes.load(std::memory_order_relaxed);
+        }
+        return stats;
+    }
+
     void Message::MessagePool::clean() {
         std::lock_guard<std::mutex> lg(pool_sync_);
-        auto it = pool_;
-        while (it) {
-            auto tmp = it;
-            it = it->next;
-            delete tmp;
+        for (const auto& b : depot_) {
+            auto it = b.head;
+            while (it) {
+                auto tmp = it;
+                it = it->next;
+                delete tmp;
+            }
         }
-        pool_ = nullptr;
+        depot_.clear();
     }
 
     Message* Message::MessagePool::get() {
-        {
-            std::lock_guard<std::mutex> lg(pool_sync_);
-            auto msg = pool_;
-            if (msg) {
-                pool_ = msg->next;
-                msg->next = nullptr;
-                return msg;
+        if (magazine_retired_) {
+            return getFromDepot();
+        }
+
+        auto mag = getMagazine();
+        if (mag->head) {
+            increase(mag->hits);
+        } else {
+            increase(mag->misses);
+            refill(mag);
+            if (!mag->head) {
+                increase(mag->allocations);
+                return new Message();
             }
         }
 
-        return new Message();
+        auto msg = mag->head;
+        mag->head = msg->next;
+        --mag->count;
+        msg->next = nullptr;
+        return msg;
     }
 
     void Message::MessagePool::put(Message* m) {
+        if (magazine_retired_) {
+            putToDepot(m);
+            return;
+        }
+
+        auto mag = getMagazine();
+        m->next = mag->head;
+        mag->head = m;
+        ++mag->count;
+
+        // 留下一批，以免在取出和归还之间来回与全局仓库交换。
+        auto size = magazine_size_.load(std::memory_order_relaxed);
+        if (mag->count >= size * 2) {
+            flush(mag, size);
+        }
+    }
+
+    Message::MessagePool::Magazine* Message::MessagePool::getMagazine() {
+        auto mag = &magazine_;
+        if (!mag->registered) {
+            std::lock_guard<std::mutex> lg(pool_sync_);
+            magazines_.push_back(mag);
+            mag->registered = true;
+        }
+        return mag;
+    }
+
+    Message* Message::MessagePool::getFromDepot() {
+        std::lock_guard<std::mutex> lg(pool_sync_);
+        ++retired_.misses;
+        if (depot_.empty()) {
+            ++retired_.allocations;
+            return new Message();
+        }
+        ++retired_.refills;
+
+        auto& b = depot_.back();
+        auto msg = b.head;
+        b.head = msg->next;
+        if (--b.count == 0) {
+            depot_.pop_back();
+        }
+        msg->next = nullptr;
+        return msg;
+    }
+
+    void Message::MessagePool::putToDepot(Message* m) {
+        std::lock_guard<std::mutex> lg(pool_sync_);
+        auto size = magazine_size_.load(std::memory_order_relaxed);
+        if (depot_.empty() || depot_.back().count >= size) {
+            depot_.push_back(Batch{ nullptr, 0 });
+        }
+
+        auto& b = depot_.back();
+        m->next = b.head;
+        b.head = m;
+        ++b.count;
+        ++retired_.flushes;
+    }
+
+    void Message::MessagePool::refill(Magazine* mag) {
+        std::lock_guard<std::mutex> lg(pool_sync_);
+        if (depot_.empty()) {
+            return;
+        }
+
+        auto b = depot_.back();
+        depot_.pop_back();
+        mag->head = b.head;
+        mag->count = b.count;
+        increase(mag->refills);
+    }
+
+    void Message::MessagePool::flush(Magazine* mag, size_t cnt) {
+        if (cnt == 0 || !mag->head) {
+            return;
+        }
+        if (cnt > mag->count) {
+            cnt = mag->count;
+        }
+
+        Batch b{ mag->head, cnt };
+        auto tail = mag->head;
+        for (size_t i = 1; i < cnt; ++i) {
+            tail = tail->next;
+        }
+        mag->head = tail->next;
+        mag->count -= cnt;
+        tail->next = nullptr;
+
         std::lock_guard<std::mutex> lg(pool_sync_);
-        m->next = pool_;
-        pool_ = m;
+        depot_.push_back(b);
+        increase(mag->flushes);
+    }
+
+    void Message::MessagePool::retire(Magazine* mag) {
+        flush(mag, mag->count);
+
+        std::lock_guard<std::mutex> lg(pool_sync_);
+        retired_.hits += mag->hits.load(std::memory_order_relaxed);
+        retired_.misses += mag->misses.load(std::memory_order_relaxed);
+        retired_.refills += mag->refills.load(std::memory_order_relaxed);
+        retired_.allocations += mag->allocations.load(std::memory_order_relaxed);
+        retired_.flushes += mag->flushes.load(std::memory_order_relaxed);
+
+        for (auto it = magazines_.begin(); it != magazines_.end(); ++it) {
+            if (*it == mag) {
+                magazines_.erase(it);
+                break;
+            }
+        }
+        mag->registered = false;
+    }
+
+    // static
+    void Message::MessagePool::increase(std::atomic<uint64_t>& counter) {
+        // 只有所属线程会写入，不需要原子的读-改-写。
+        counter.store(
+            counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+
+    // Message::MessagePool::Magazine
+    Message::MessagePool::Magazine::~Magazine() {
+        if (registered) {
+            s_pool_.retire(this);
+        }
+        magazine_retired_ = true;
     }
 
 }
\ No newline at end of file
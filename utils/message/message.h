@@ -7,36 +7,232 @@
 #ifndef UTILS_MESSAGE_MESSAGE_H_
 #define UTILS_MESSAGE_MESSAGE_H_
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
 #include <functional>
+#include <memory>
 #include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "utils/message/closure.hpp"
+#include "utils/message/location.hpp"
 
 
 namespace utl {
 
     class Cycler;
     class Executable;
+    class Message;
+
+    /**
+     * 已投递消息的句柄。
+     * 由消息地址、投递时的代数和投递者组成。消息开始执行或被移除后句柄即失效，
+     * 消息回收后代数会改变，旧句柄不会误指新的消息，因此可以放心地长期持有。
+     * 只有投递该消息的对象才能通过句柄取消消息，交给其他对象时取消会失败。
+     */
+    class MessageHandle {
+    public:
+        MessageHandle() = default;
+
+        bool isNull() const { return !msg_; }
+
+    private:
+        friend class Message;
+        friend class MessageQueue;
+        friend class SequencedCycler;
+        friend class ThreadPool;
+
+        MessageHandle(Message* msg, uint64_t gen, const void* owner)
+            : msg_(msg), gen_(gen), owner_(owner) {}
 
-    class Message {
+        Message* msg_ = nullptr;
+        uint64_t gen_ = 0;
+        // 投递者，即 Cycler、ThreadPool 或 SequencedCycler 的内部状态
+        const void* owner_ = nullptr;
+    };
+
+    /**
+     * 消息按缓存行对齐，不同的消息不会共享缓存行。字段按访问方式分为四行：
+     * 第一行为队列和泵在排序、分派时读写的字段；第二行为可调用对象；
+     * 第三行为随消息携带的数据；第四行为内嵌数据和其他线程可能改写的状态。
+     */
+    class alignas(64) Message {
     public:
+        /**
+         * 消息池的统计数据，为所有线程的累计值。
+         */
+        struct PoolStats {
+            // 直接从线程缓存中取得消息的次数
+            uint64_t hits = 0;
+            // 线程缓存为空的次数，等于 refills 与 allocations 之和
+            uint64_t misses = 0;
+            // 从全局仓库整批补充线程缓存的次数
+            uint64_t refills = 0;
+            // 新分配消息的次数
+            uint64_t allocations = 0;
+            // 线程缓存过满，整批归还全局仓库的次数
+            uint64_t flushes = 0;
+        };
+
+        /**
+         * 消息的优先级，数值越小越优先。
+         * 同一个泵中已到期的消息先按优先级、再按先后顺序执行。
+         * 等待过久的低优先级消息会被提前执行，参见 MessageQueue::setAgingLimit()。
+         */
+        enum Priority : uint8_t {
+            PRI_CRITICAL = 0,
+            PRI_NORMAL,
+            PRI_BACKGROUND,
+            PRI_COUNT,
+        };
+
         static Message* get();
 
+        /**
+         * 确保全局仓库中至少有 count 个空闲消息，不足时立即分配。
+         * 消息池初始时预留 kDefaultPoolReserve 个。
+         */
+        static void reservePool(size_t count);
+
+        /**
+         * 为当前线程的缓存新分配一批消息，而不是从全局仓库中取。
+         * 在绑定了 CPU 的线程中调用时，这些消息按首次访问策略位于本地的 NUMA 节点上。
+         */
+        static void prefillLocalCache();
+
+        /**
+         * 设置每个线程缓存一批消息的数量，必须大于 0。
+         * 线程缓存中的消息达到两批时，会归还一批给全局仓库。
+         */
+        static void setPoolMagazineSize(size_t size);
+        static PoolStats getPoolStats();
+
         void reset();
 
-        int id;
+        /**
+         * 获取该消息当前代数的句柄。应在消息放入队列之前调用。
+         * @param owner 投递者，取消时会据此核对句柄是否属于调用者。
+         */
+        MessageHandle getHandle(const void* owner) const;
+
+        /**
+         * 判断句柄所指的消息是否仍在队列中等待执行。O(1)。
+         */
+        static bool isPending(const MessageHandle& h);
+
+        /**
+         * 由消息队列在取出消息准备执行时调用，使该消息的所有句柄失效。
+         * @return 如果消息已被取消，返回 false，此时消息不应被执行。
+         */
+        bool claim();
+        bool isCancelled() const;
+
+        /**
+         * 消息是否已开始执行或已被取消。
+         */
+        bool isSettled() const;
+
+        /**
+         * 标记消息已被消费线程整批取出。
+         * 取消这样的消息时不能释放其资源，而要留给取出它的线程处理。
+         * 只能在持有队列锁时调用。
+         */
+        void setInBatch(bool in_batch);
+        bool isInBatch() const;
+
+        /**
+         * 释放消息持有的回调和数据，但不回收消息本身。
+         */
+        void releasePayload();
+
+        /**
+         * 在消息内部构造 T 类型的数据，较小的数据不必再通过 shared_data 额外分配。
+         * 已有的内嵌数据会先被析构。数据与 func 一样，在消息执行后或被取消时析构。
+         */
+        template <typename T, typename... Args>
+        T* emplacePayload(Args&&... args) {
+            static_assert(sizeof(T) <= kPayloadSize, "The payload is too large, use shared_data instead");
+            static_assert(alignof(T) <= alignof(std::max_align_t), "Unsupported payload alignment");
+
+            destroyPayload();
+            auto p = new (payload_) T(std::forward<Args>(args)...);
+            payload_type_ = &PayloadType<T>::instance;
+            return p;
+        }
+
+        /**
+         * 获取内嵌数据。没有数据或数据不是 T 类型时返回 nullptr。
+         */
+        template <typename T>
+        T* getPayload() {
+            if (payload_type_ != &PayloadType<T>::instance) {
+                return nullptr;
+            }
+            return std::launder(reinterpret_cast<T*>(payload_));
+        }
+
+        template <typename T>
+        const T* getPayload() const {
+            return const_cast<Message*>(this)->getPayload<T>();
+        }
+
+        // 第一行
+        Message* next;
         uint64_t time_ns;
         Cycler* target;
         Executable* callback;
-        std::function<void()> func;
+        int id;
+        Priority priority;
+        // 空闲任务，参见 Cycler::postIdle()。
+        bool is_idle;
+        // 到期时间被 Cycler 的时间余量推迟过，参见 Cycler::setTimerSlack()。
+        bool is_slack;
+        // 跟踪开启时分配的流 id，否则为 0，参见 TraceLog。
+        uint64_t flow_id;
+
+        // 所属 Cycler 的待执行消息链表，由 MessageQueue 持锁维护。
+        // index_pprev 指向前一个节点的 index_next 或链表头，为 nullptr 时表示不在链表中。
+        Message* index_next;
+        Message** index_pprev;
+
+        // 第二行
+        alignas(64) Closure func;
 
-        uint64_t ui1;
+        // 第三行
+        alignas(64) uint64_t ui1;
         uint64_t ui2;
         void* data;
         std::shared_ptr<void> shared_data;
+        // 投递位置，参见 TraceLog。
+        Location from;
 
-        Message* next;
-        bool is_barrier;
+        static constexpr size_t kPayloadSize = 48;
+        static constexpr size_t kDefaultPoolReserve = 100;
+        static constexpr size_t kDefaultMagazineSize = 32;
 
     private:
+        friend class MessageQueue;
+        friend class SequencedCycler;
+        friend class ThreadPool;
+
+        /**
+         * 将句柄所指的消息标记为已取消，被标记的消息不会再被执行，
+         * 由队列在之后遇到它时回收。O(1)，可以在任意线程中调用。
+         * 只供持有消息的队列使用：MessagePump 中的消息要经过 MessageQueue::cancel()
+         * 更新取消计数，外部应调用 Cycler::removeMessage() 等方法。
+         * @return 如果消息仍在等待执行且成功取消，返回 true；
+         *         如果消息已经开始执行、已被移除或已被取消，返回 false。
+         */
+        static bool cancel(const MessageHandle& h);
+
+        /**
+         * 两级消息池。
+         * 每个线程持有一个小的缓存（弹匣），取出和归还消息时只访问本线程的缓存，不需要持锁。
+         * 缓存为空或过满时，才持锁从全局仓库中整批取出或整批归还。
+         */
         class MessagePool {
         public:
             MessagePool();
@@ -45,17 +241,92 @@ namespace utl {
             Message* get();
             void put(Message* m);
 
-        private:
             void reserve(size_t cnt);
+            void prefillLocal();
+            void setMagazineSize(size_t size);
+            PoolStats getStats();
+
+        private:
+            struct Batch {
+                Message* head;
+                size_t count;
+            };
+
+            struct Magazine {
+                ~Magazine();
+
+                Message* head = nullptr;
+                size_t count = 0;
+                bool registered = false;
+
+                // 只由所属线程写入，其他线程仅在统计时读取。
+                std::atomic<uint64_t> hits{ 0 };
+                std::atomic<uint64_t> misses{ 0 };
+                std::atomic<uint64_t> refills{ 0 };
+                std::atomic<uint64_t> allocations{ 0 };
+                std::atomic<uint64_t> flushes{ 0 };
+            };
+
+            Magazine* getMagazine();
+            Message* getFromDepot();
+            void putToDepot(Message* m);
+            void refill(Magazine* mag);
+            void flush(Magazine* mag, size_t cnt);
+            void retire(Magazine* mag);
             void clean();
 
-            Message* pool_;
+            static void increase(std::atomic<uint64_t>& counter);
+
+            std::vector<Batch> depot_;
+            std::vector<Magazine*> magazines_;
+            PoolStats retired_;
+            std::atomic<size_t> magazine_size_;
             std::mutex pool_sync_;
+
+            static thread_local Magazine magazine_;
+            // 本线程的 magazine_ 已析构。之后的其他 thread_local 对象的析构中
+            // 仍可能取用或回收消息，这时直接访问全局仓库，不再登记 magazine_。
+            static thread_local bool magazine_retired_;
         };
 
         Message();
         ~Message();
 
+        /**
+         * 内嵌数据的类型。每个 T 对应一个可写的静态对象，以它的地址识别类型。
+         * 不能用析构函数的地址识别：平凡类型的析构函数内容相同，
+         * 链接器合并相同代码（/OPT:ICF、--icf）后不同类型会得到同一个地址。
+         */
+        struct PayloadTypeInfo {
+            void (*destroy)(void* p);
+        };
+
+        template <typename T>
+        struct PayloadType {
+            static void destroy(void* p) {
+                static_cast<T*>(p)->~T();
+            }
+
+            static inline PayloadTypeInfo instance{ &destroy };
+        };
+
+        void destroyPayload();
+
+        enum StateBits : uint64_t {
+            STATE_CANCELLED = 1u << 0,
+            STATE_IN_BATCH  = 1u << 1,
+            STATE_CLAIMED   = 1u << 2,
+            STATE_GEN_SHIFT = 3,
+        };
+
+        // 第四行
+        alignas(64) unsigned char payload_[kPayloadSize];
+        // 内嵌数据的类型，没有数据时为 nullptr
+        PayloadTypeInfo* payload_type_;
+
+        // 低三位为状态标记，其余位为代数。
+        std::atomic<uint64_t> state_;
+
         static MessagePool s_pool_;
     };
 
@@ -6,11 +6,14 @@
 
 #include "utils/message/message_pump.h"
 
+#include <algorithm>
+
 #include "utils/log.h"
 #include "utils/message/executable.h"
 #include "utils/message/cycler.h"
 #include "utils/message/message.h"
 #include "utils/message/message_queue.h"
+#include "utils/message/trace_log.h"
 #include "utils/platform_utils.h"
 
 #ifdef OS_WINDOWS
@@ -19,6 +22,8 @@
 #elif defined OS_MAC
 #include "utils/message/mac/message_pump_mac.h"
 #include "utils/message/mac/message_pump_ui_mac.h"
+#elif defined OS_LINUX
+#include "utils/message/linux/message_pump_linux.h"
 #endif
 
 
@@ -27,9 +32,12 @@ namespace utl {
     std::mutex MessagePump::sync_;
     std::weak_ptr<MessagePump> MessagePump::main_pump_;
     thread_local std::shared_ptr<MessagePump> MessagePump::cur_pump_;
+    thread_local int64_t MessagePump::loop_time_ns_ = 0;
 
 
-    MessagePump::MessagePump() {
+    MessagePump::MessagePump()
+        : time_slice_ns_(kDefaultTimeSlice.count())
+    {
         msg_queue_ = new MessageQueue();
     }
 
@@ -45,6 +53,31 @@ namespace utl {
         return msg_queue_;
     }
 
+    bool MessagePump::watchFd(int /*fd*/, unsigned int /*events*/, FdCallback /*callback*/) {
+        LOG(Log::ERR) << "Watching file descriptors is not supported on this platform!";
+        return false;
+    }
+
+    void MessagePump::unwatch(int /*fd*/) {}
+
+    const IdleDeadline& MessagePump::getIdleDeadline() const {
+        return idle_deadline_;
+    }
+
+#ifdef UTL_MESSAGE_STATS
+    MessageStats::Snapshot MessagePump::getStats() const {
+        return stats_.snapshot();
+    }
+#endif
+
+    const PumpHeartbeat& MessagePump::getHeartbeat() const {
+        return heartbeat_;
+    }
+
+    void MessagePump::setTimeSlice(nsp slice) {
+        time_slice_ns_.store(std::max(slice.count(), int64_t(0)), std::memory_order_relaxed);
+    }
+
     // static
     void MessagePump::create() {
         std::lock_guard<std::mutex> lk(sync_);
@@ -59,10 +92,19 @@ namespace utl {
         pump.reset(new win::MessagePumpWin());
 #elif defined OS_MAC
         pump.reset(new mac::MessagePumpMac());
+#elif defined OS_LINUX
+        pump.reset(new lnx::MessagePumpLinux());
 #endif
         cur_pump_ = pump;
     }
 
+    // static
+    void MessagePump::create(const ThreadOptions& options) {
+        ThreadUtils::applyToCurrentThread(options);
+        create();
+        Message::prefillLocalCache();
+    }
+
     // static
     void MessagePump::createForUI() {
         std::lock_guard<std::mutex> lk(sync_);
@@ -77,6 +119,8 @@ namespace utl {
         pump.reset(new win::MessagePumpUIWin());
 #elif defined OS_MAC
         pump.reset(new mac::MessagePumpUIMac());
+#elif defined OS_LINUX
+        pump.reset(new lnx::MessagePumpLinux());
 #endif
         cur_pump_ = pump;
 
@@ -145,36 +189,99 @@ namespace utl {
         return cur_pump_;
     }
 
-    bool MessagePump::cosume() {
-        msg_queue_->addBarrier();
-        for (;;) {
-            Message* msg;
-            if (!msg_queue_->dequeue(&msg)) {
-                break;
-            }
-
-            if (msg->callback) {
-                msg->callback->onExecTask(*msg);
-            } else if (msg->func) {
-                msg->func();
-            } else if (msg->target) {
-                msg->target->dispatchMessage(*msg);
-            }
+    // static
+    MessagePump::ns MessagePump::getLoopTime() {
+        auto cur = loop_time_ns_;
+        return cur != 0 ? ns(cur) : Cycler::now();
+    }
 
+    // static
+    bool MessagePump::postTo(const std::weak_ptr<MessagePump>& pump, Message* msg) {
+        auto ptr = pump.lock();
+        if (!ptr) {
             msg->reset();
+            return false;
         }
-        msg_queue_->removeBarrier();
 
-        return msg_queue_->hasMessages(MessageQueue::ML_NORMAL);
+        // 与 Cycler::post() 一样按投递时间排序，保证先进先出。
+        msg->target = nullptr;
+        msg->time_ns = Cycler::now().count();
+        ptr->getQueue()->enqueue(msg);
+        ptr->wakeup();
+        return true;
+    }
+
+    bool MessagePump::cosume() {
+        // 整批取出后逐个执行，执行过程中不再获取队列锁。
+        auto depth = msg_queue_->takeBatch();
+#ifdef UTL_MESSAGE_STATS
+        if (depth > 0) {
+            stats_.recordDepth(depth);
+        }
+#else
+        (void)depth;
+#endif
+        return runBatch();
     }
 
     bool MessagePump::cosumeDelayed(int64_t* delay_ns) {
+        // 到期的延时消息与即时消息共用就绪队列，已在 cosume() 取出的那一批中按优先级执行。
+        *delay_ns = delayed_ns_;
+        return delayed_ns_ == 0;
+    }
+
+    bool MessagePump::cosumeIdle(int64_t delay_ns) {
+        if (!msg_queue_->takeIdle()) {
+            return false;
+        }
+
+        auto period = kMaxIdlePeriod.count();
+        if (delay_ns >= 0) {
+            period = std::min(period, delay_ns);
+        }
+        idle_deadline_ = IdleDeadline(Cycler::now() + ns(period), false);
+
+        in_idle_period_ = true;
+        runBatch();
+        in_idle_period_ = false;
+        return true;
+    }
+
+    bool MessagePump::runBatch() {
+        auto slice = time_slice_ns_.load(std::memory_order_relaxed);
+        auto start = Cycler::now().count();
+
+        // 在某个消息中嵌套运行时，结束后要恢复外层消息的循环时间和心跳。
+        // 心跳只由本线程写入，这里读取总是成功的。
+        auto outer_time = loop_time_ns_;
+        PumpHeartbeat::Snapshot outer;
+        heartbeat_.read(&outer);
+
+        Message* done = nullptr;
         for (;;) {
+            auto cur = Cycler::now().count();
+            if (slice > 0 && cur - start >= slice && done) {
+                break;
+            }
+            loop_time_ns_ = cur;
+
             Message* msg;
-            if (!msg_queue_->dequeueDelayed(delay_ns, &msg)) {
+            if (!msg_queue_->nextInBatch(cur, &done, &msg)) {
                 break;
             }
 
+            if (msg->is_idle && !in_idle_period_) {
+                // 等待超时的空闲任务，没有可用的空闲时间
+                idle_deadline_ = IdleDeadline(ns(cur), true);
+            }
+
+            heartbeat_.beat(msg->id, msg->from, cur);
+
+            bool traced = TraceLog::isEnabled();
+            if (traced) {
+                TraceLog::addEvent(TraceLog::PH_BEGIN, msg->from, msg->flow_id, msg->id, cur);
+            }
+
             if (msg->callback) {
                 msg->callback->onExecTask(*msg);
             } else if (msg->func) {
@@ -183,9 +290,31 @@ namespace utl {
                 msg->target->dispatchMessage(*msg);
             }
 
-            msg->reset();
+            if (traced) {
+                TraceLog::addEvent(
+                    TraceLog::PH_END, msg->from, msg->flow_id, msg->id, Cycler::now().count());
+            }
+
+#ifdef UTL_MESSAGE_STATS
+            // 空闲任务的 time_ns 是其最晚执行时间，不计排队时间。
+            auto end = Cycler::now().count();
+            auto delay = (!msg->is_idle && uint64_t(cur) > msg->time_ns) ?
+                uint64_t(cur) - msg->time_ns : 0;
+            stats_.recordRun(*msg, delay, uint64_t(end - cur));
+#endif
+
+            // 消息本身在本批结束时才回收，持有的资源则立即释放。
+            msg->releasePayload();
         }
-        return false;
+
+        // 不在嵌套中时，之后可能执行平台事件的回调，缓存的时间已不能代表当前时间。
+        loop_time_ns_ = outer_time;
+        if (outer.start_ns != 0) {
+            heartbeat_.beat(outer.id, outer.from, outer.start_ns);
+        } else {
+            heartbeat_.rest();
+        }
+        return msg_queue_->finishBatch(done, &delayed_ns_);
     }
 
     bool MessagePump::hasMessages(unsigned int lists) {
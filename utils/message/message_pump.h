@@ -7,10 +7,17 @@
 #ifndef UTILS_MESSAGE_MESSAGE_PUMP_H_
 #define UTILS_MESSAGE_MESSAGE_PUMP_H_
 
+#include <atomic>
+#include <functional>
 #include <memory>
 #include <mutex>
 #include <stack>
 
+#include "utils/message/location.hpp"
+#include "utils/message/message_stats.h"
+#include "utils/thread_utils.h"
+#include "utils/time_utils.h"
+
 
 namespace utl {
 
@@ -18,17 +25,175 @@ namespace utl {
     class Message;
     class MessageQueue;
 
+    /**
+     * 空闲任务本次可以使用的时间。参见 Cycler::postIdle()。
+     */
+    class IdleDeadline {
+    public:
+        IdleDeadline() = default;
+        IdleDeadline(TimeUtils::nsp deadline, bool timed_out)
+            : deadline_(deadline), timed_out_(timed_out) {}
+
+        TimeUtils::ns getDeadline() const { return deadline_; }
+
+        /**
+         * 距截止时间还剩多少时间，已超过时为 0。
+         */
+        TimeUtils::ns getTimeRemaining() const {
+            auto cur = TimeUtils::upTime();
+            return deadline_ > cur ? deadline_ - cur : TimeUtils::ns(0);
+        }
+
+        /**
+         * 任务是否因等待超时，而在泵不空闲时被执行。
+         */
+        bool isTimedOut() const { return timed_out_; }
+
+    private:
+        TimeUtils::ns deadline_{ 0 };
+        bool timed_out_ = false;
+    };
+
+
+    /**
+     * 泵的心跳，记录正在执行的消息及其开始时间，供 HangWatchdog 在其他线程中读取。
+     * 泵每执行一个消息只做几次普通的原子存储，没有读-改-写操作和锁。
+     */
+    class PumpHeartbeat {
+    public:
+        struct Snapshot {
+            // 开始执行的时间，为 0 时表示没有在执行消息
+            int64_t start_ns = 0;
+            int id = -1;
+            Location from;
+        };
+
+        void beat(int id, const Location& from, int64_t start_ns) {
+            // 顺序锁：写入期间序号为奇数，读者据此丢弃读到一半的数据。
+            auto seq = seq_.load(std::memory_order_relaxed);
+            seq_.store(seq + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+
+            start_ns_.store(start_ns, std::memory_order_relaxed);
+            id_.store(id, std::memory_order_relaxed);
+            file_.store(from.getFile(), std::memory_order_relaxed);
+            function_.store(from.getFunction(), std::memory_order_relaxed);
+            line_.store(from.getLine(), std::memory_order_relaxed);
+
+            seq_.store(seq + 2, std::memory_order_release);
+        }
+
+        void rest() {
+            // 只清除开始时间，消息的信息不变，不需要改动序号。
+            start_ns_.store(0, std::memory_order_relaxed);
+        }
+
+        /**
+         * 读取心跳。读取期间泵开始执行了下一个消息时，返回 false。
+         */
+        bool read(Snapshot* out) const {
+            auto seq = seq_.load(std::memory_order_acquire);
+            if (seq & 1) {
+                return false;
+            }
+
+            out->start_ns = start_ns_.load(std::memory_order_relaxed);
+            out->id = id_.load(std::memory_order_relaxed);
+            out->from = Location(
+                file_.load(std::memory_order_relaxed),
+                function_.load(std::memory_order_relaxed),
+                line_.load(std::memory_order_relaxed));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return seq_.load(std::memory_order_relaxed) == seq;
+        }
+
+    private:
+        std::atomic<uint32_t> seq_{ 0 };
+        std::atomic<int64_t> start_ns_{ 0 };
+        std::atomic<int> id_{ -1 };
+        std::atomic<const char*> file_{ nullptr };
+        std::atomic<const char*> function_{ nullptr };
+        std::atomic<int> line_{ 0 };
+    };
+
+
     class MessagePump {
     public:
+        using ns = TimeUtils::ns;
+        using nsp = TimeUtils::nsp;
+
+        enum FdEvent {
+            FE_READ  = 1 << 0,
+            FE_WRITE = 1 << 1,
+            // 只出现在回调中，表示出错或对端已关闭
+            FE_ERROR = 1 << 2,
+            // 只用于 watchFd()，表示边沿触发：就绪状态变化后只通知一次，
+            // 回调应读写到 EAGAIN 为止。默认为水平触发，只要仍就绪每轮都会通知。
+            FE_EDGE  = 1 << 3,
+        };
+
+        /**
+         * 文件描述符就绪时的回调，events 为 FdEvent 的组合。
+         */
+        using FdCallback = std::function<void(int fd, unsigned int events)>;
+
         virtual ~MessagePump();
 
         virtual void wakeup() = 0;
         virtual void loop() = 0;
 
+        /**
+         * 在泵所在的线程中监视文件描述符（如套接字、管道）的读写就绪事件。
+         * 回调直接在泵的线程中执行，与消息共用同一个等待原语，不经过其他线程。
+         * 对同一个描述符再次调用会替换其事件和回调。只能在泵所在的线程中调用。
+         * 目前只有 Linux 支持（基于 epoll），其他平台返回 false。
+         * @param events FE_READ 和/或 FE_WRITE，可以加上 FE_EDGE。
+         * @return 成功返回 true。
+         */
+        virtual bool watchFd(int fd, unsigned int events, FdCallback callback);
+
+        /**
+         * 停止监视文件描述符，可以在其回调中调用。应在关闭描述符之前调用。
+         */
+        virtual void unwatch(int fd);
+
         bool isNested() const;
         MessageQueue* getQueue() const;
 
+        /**
+         * 设置每一轮处理消息的时间片，为 0 时不限制。
+         * 一轮中已执行的消息超过该时间后，剩下的消息留到下一轮，
+         * 以便及时处理平台事件和到期的延时消息。可以在任意线程中调用。
+         */
+        void setTimeSlice(nsp slice);
+
+        /**
+         * 获取正在执行的空闲任务的截止时间，只应在空闲任务中调用。
+         */
+        const IdleDeadline& getIdleDeadline() const;
+
+        const PumpHeartbeat& getHeartbeat() const;
+
+#ifdef UTL_MESSAGE_STATS
+        /**
+         * 获取该泵的排队时间、执行时间和队列深度的统计。可以在任意线程中调用。
+         */
+        MessageStats::Snapshot getStats() const;
+#endif
+
+        static constexpr ns kDefaultTimeSlice = std::chrono::milliseconds(10);
+
+        // 一段空闲时间的最大长度。即使之后没有任何消息，也按此限制空闲任务的截止时间，
+        // 以便及时响应平台事件。
+        static constexpr ns kMaxIdlePeriod = std::chrono::milliseconds(50);
+
         static void create();
+
+        /**
+         * 先对当前线程应用 options，再创建泵并预先填充本线程的消息缓存，
+         * 使泵的队列和缓存的消息都分配在线程所绑定的 CPU 的本地节点上。参见 PumpThread。
+         */
+        static void create(const ThreadOptions& options);
         static void createForUI();
         static void run();
         static void quit();
@@ -38,6 +203,19 @@ namespace utl {
         static std::shared_ptr<MessagePump> getMain();
         static std::shared_ptr<MessagePump> getCurrent();
 
+        /**
+         * 当前线程的泵正在执行消息时，返回该消息开始执行的时间，不需要再读取时钟；
+         * 否则返回 Cycler::now()。Cycler 以此作为延时的起点。
+         */
+        static ns getLoopTime();
+
+        /**
+         * 将消息直接放入泵的队列并唤醒泵，该消息不属于任何 Cycler。
+         * 可以在任意线程中调用。如果泵已销毁，消息会被回收。
+         * @return 放入成功返回 true。
+         */
+        static bool postTo(const std::weak_ptr<MessagePump>& pump, Message* msg);
+
     protected:
         struct MPContext {
             bool quit_imm_ = false;
@@ -47,19 +225,51 @@ namespace utl {
         MessagePump();
 
         bool cosume();
+
+        /**
+         * 给出下一个延时消息的等待时间。到期的延时消息已在 cosume() 中与即时消息一起执行，
+         * 等待时间也已在那一批结束时算出，这里不再获取队列的锁。
+         * @return 已有延时消息到期时返回 true。
+         */
         bool cosumeDelayed(int64_t* delay_ns);
 
+        /**
+         * 在泵没有其他工作、即将等待时调用，执行一个空闲任务。
+         * @param delay_ns cosumeDelayed() 给出的等待时间，空闲任务不应超过这段时间。
+         * @return 执行了空闲任务时返回 true，此时调用方应重新检查是否有新的工作，而不是直接等待。
+         */
+        bool cosumeIdle(int64_t delay_ns);
+
         bool hasMessages(unsigned int lists);
         int64_t getDelayedTime();
 
         int nested_count_ = -1;
         MessageQueue* msg_queue_;
+        std::atomic<int64_t> time_slice_ns_;
         std::stack<MPContext> context_;
 
     private:
+        /**
+         * 执行队列中当前的一批消息，直到执行完或时间片用完。
+         */
+        bool runBatch();
+
+        // 为 true 时表示正处于空闲时间中
+        bool in_idle_period_ = false;
+        IdleDeadline idle_deadline_;
+        PumpHeartbeat heartbeat_;
+        // 上一批结束时算出的下一个延时消息的等待时间，参见 MessageQueue::finishBatch()。
+        int64_t delayed_ns_ = -1;
+
+#ifdef UTL_MESSAGE_STATS
+        MessageStats stats_;
+#endif
+
         static std::mutex sync_;
         static std::weak_ptr<MessagePump> main_pump_;
         static thread_local std::shared_ptr<MessagePump> cur_pump_;
+        // 当前线程的泵正在执行的消息开始执行的时间，不在执行消息时为 0
+        static thread_local int64_t loop_time_ns_;
     };
 
 }
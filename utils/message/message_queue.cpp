@@ -6,162 +6,451 @@
 
 #include "utils/message/message_queue.h"
 
+#include <algorithm>
+
 #include "utils/log.h"
 #include "utils/message/cycler.h"
 #include "utils/message/message.h"
+#include "utils/message/timer_queue.h"
+
 
+namespace {
+
+    /**
+     * 同一时刻到期的一组消息中，由余量合并掉的唤醒次数。
+     * 没有余量时，被推迟过的消息按各自的到期时间唤醒，未被推迟的消息共用一次唤醒。
+     */
+    uint64_t mergedWakeups(uint64_t slacked, uint64_t plain) {
+        if (slacked == 0) {
+            return 0;
+        }
+        return slacked + (plain > 0 ? 1 : 0) - 1;
+    }
+
+}
 
 namespace utl {
 
     MessageQueue::MessageQueue()
-        : message_(nullptr),
-          delayed_(nullptr),
-          has_barrier_(false) {}
+        : delayed_(new TimerQuaternaryHeap()),
+          incoming_(nullptr),
+          cancelled_(0),
+          batch_(nullptr)
+    {
+        ready_[Message::PRI_NORMAL].aging_limit = kDefaultNormalAgingLimit.count();
+        ready_[Message::PRI_BACKGROUND].aging_limit = kDefaultBackgroundAgingLimit.count();
+    }
 
     MessageQueue::~MessageQueue() {
         clear();
+        delete delayed_;
     }
 
-    bool MessageQueue::enqueue(Message* msg) {
-        if (msg->is_barrier) {
+    void MessageQueue::setTimerQueue(TimerQueue* timers) {
+        if (!timers) {
             ubassert(false);
-            msg->reset();
-            return false;
+            return;
         }
 
         std::lock_guard<std::mutex> lk(queue_sync_);
+        auto msg = delayed_->extract([](const Message&) { return true; });
+        while (msg) {
+            auto next = msg->next;
+            timers->push(msg);
+            msg = next;
+        }
 
-        for (auto it = message_; it != nullptr; it = it->next) {
-            if (it->is_barrier ||
-                msg->time_ns == 0 ||
-                msg->time_ns < it->time_ns)
-            {
-                break;
-            }
+        delete delayed_;
+        delayed_ = timers;
+    }
+
+    void MessageQueue::setAgingLimit(Message::Priority p, nsp limit) {
+        if (p <= Message::PRI_CRITICAL || p >= Message::PRI_COUNT) {
+            return;
         }
 
-        auto ptr = message_;
+        std::lock_guard<std::mutex> lk(queue_sync_);
+        ready_[p].aging_limit = limit.count();
+    }
 
-        if (!ptr ||
-            ptr->is_barrier ||
-            msg->time_ns == 0 ||
-            msg->time_ns < ptr->time_ns)
-        {
-            // push_front
-            msg->next = message_;
-            message_ = msg;
-        } else {
-            decltype(ptr) prev;
-            for (;;) {
-                prev = ptr;
-                ptr = ptr->next;
-                if (!ptr ||
-                    ptr->is_barrier ||
-                    msg->time_ns < ptr->time_ns)
-                {
-                    break;
+    bool MessageQueue::enqueue(Message* msg) {
+        if (msg->priority >= Message::PRI_COUNT) {
+            ubassert(false);
+            msg->priority = Message::PRI_NORMAL;
+        }
+
+        // push_front 到接收栈。生产者之间只竞争这一个原子指针，不需要持锁。
+        auto head = incoming_.load(std::memory_order_relaxed);
+        do {
+            msg->next = head;
+        } while (!incoming_.compare_exchange_weak(
+            head, msg, std::memory_order_release, std::memory_order_relaxed));
+
+        return true;
+    }
+
+    bool MessageQueue::enqueue(Message* head, Message* tail) {
+        // 链表的顺序与接收栈相同，整串压入即可，出栈时会一起被反转回投递顺序。
+        auto top = incoming_.load(std::memory_order_relaxed);
+        do {
+            tail->next = top;
+        } while (!incoming_.compare_exchange_weak(
+            top, head, std::memory_order_release, std::memory_order_relaxed));
+
+        return true;
+    }
+
+    void MessageQueue::drainIncoming() {
+        auto ptr = incoming_.exchange(nullptr, std::memory_order_acquire);
+        if (!ptr) {
+            return;
+        }
+
+        // 接收栈是后进先出的，先反转回入队顺序，以保证同一优先级的消息先进先出。
+        Message* fifo = nullptr;
+        while (ptr) {
+            auto next = ptr->next;
+            ptr->next = fifo;
+            fifo = ptr;
+            ptr = next;
+        }
+
+        auto cur = Cycler::now().count();
+        while (fifo) {
+            auto next = fifo->next;
+            if (fifo->isCancelled()) {
+                // 还在接收栈中就被取消了
+                recycle(fifo);
+            } else {
+                if (fifo->is_idle) {
+                    pushBack(idle_, fifo);
+                } else if (fifo->time_ns <= uint64_t(cur)) {
+                    enqueueReady(fifo);
+                } else {
+                    enqueueDelayed(fifo);
                 }
+                link(fifo);
             }
+            fifo = next;
+        }
+    }
 
-            // insert_after prev
-            msg->next = prev->next;
-            prev->next = msg;
+    // static
+    void MessageQueue::pushBack(ReadyQueue& q, Message* msg) {
+        msg->next = nullptr;
+        if (q.tail) {
+            q.tail->next = msg;
+        } else {
+            q.head = msg;
         }
+        q.tail = msg;
+        ++q.count;
+    }
 
-        return true;
+    // static
+    void MessageQueue::pushFront(ReadyQueue& q, const ReadyQueue& chain) {
+        if (!chain.head) {
+            return;
+        }
+
+        chain.tail->next = q.head;
+        q.head = chain.head;
+        if (!q.tail) {
+            q.tail = chain.tail;
+        }
+        q.count += chain.count;
+    }
+
+    void MessageQueue::enqueueReady(Message* msg) {
+        pushBack(ready_[msg->priority], msg);
     }
 
     void MessageQueue::enqueueDelayed(Message* msg) {
-        ubassert(!msg->is_barrier);
+        delayed_->push(msg);
+    }
 
-        auto ptr = delayed_;
+    void MessageQueue::promoteDelayed(uint64_t cur) {
+        uint64_t fired = 0;
+        // 时间相同的消息相邻取出，按组统计其中被余量推迟过的消息。
+        uint64_t group_time = 0;
+        uint64_t slacked = 0;
+        uint64_t plain = 0;
+        for (;;) {
+            auto ptr = topDelayed();
+            if (!ptr || ptr->time_ns > cur) {
+                break;
+            }
+            delayed_->pop();
 
-        if (!ptr ||
-            msg->time_ns == 0 ||
-            msg->time_ns < ptr->time_ns)
-        {
-            msg->next = delayed_;
-            delayed_ = msg;
-        } else {
-            decltype(ptr) prev;
-            for (;;) {
-                prev = ptr;
-                ptr = ptr->next;
-                if (!ptr || msg->time_ns < ptr->time_ns) {
+            if (fired == 0 || ptr->time_ns != group_time) {
+                timer_stats_.wakeups_saved += mergedWakeups(slacked, plain);
+                group_time = ptr->time_ns;
+                slacked = 0;
+                plain = 0;
+            }
+            if (ptr->is_slack) {
+                ++slacked;
+            } else {
+                ++plain;
+            }
+
+            enqueueReady(ptr);
+            ++fired;
+        }
+
+        if (fired > 0) {
+            timer_stats_.wakeups_saved += mergedWakeups(slacked, plain);
+            timer_stats_.fired += fired;
+            ++timer_stats_.wakeups;
+        }
+    }
+
+    Message* MessageQueue::popReady(uint64_t cur) {
+        for (;;) {
+            // 先找优先级最高的非空队列，再看更低优先级的队首是否已等待过久。
+            ReadyQueue* q = nullptr;
+            bool aged = false;
+            for (auto& it : ready_) {
+                if (!it.head) {
+                    continue;
+                }
+                if (!q) {
+                    q = &it;
+                } else if (cur >= it.head->time_ns &&
+                    int64_t(cur - it.head->time_ns) >= it.aging_limit)
+                {
+                    q = &it;
+                    aged = true;
                     break;
                 }
             }
 
-            // insert_after prev
-            msg->next = prev->next;
-            prev->next = msg;
+            if (!q) {
+                return nullptr;
+            }
+
+            // pop_front
+            auto msg = q->head;
+            q->head = msg->next;
+            if (!q->head) {
+                q->tail = nullptr;
+            }
+            --q->count;
+            msg->next = nullptr;
+
+            if (msg->isCancelled()) {
+                recycle(msg);
+                continue;
+            }
+
+            if (aged) {
+                ++q->stats.aged;
+            }
+            return msg;
         }
     }
 
-    bool MessageQueue::dequeue(Message** out) {
+    size_t MessageQueue::takeBatch() {
         std::lock_guard<std::mutex> lk(queue_sync_);
+        if (batch_) {
+            return 0;
+        }
 
-        auto ptr = message_;
+        drainIncoming();
+        purgeCancelled();
 
-        // find barrier
-        while (ptr && !ptr->is_barrier) {
-            ptr = ptr->next;
+        auto cur = Cycler::now().count();
+        promoteDelayed(cur);
+
+        // 一次持锁排好整批的顺序，之后的执行过程不再需要锁。
+        size_t count = 0;
+        Message* tail = nullptr;
+        while (auto msg = popReady(cur)) {
+            msg->setInBatch(true);
+            if (tail) {
+                tail->next = msg;
+            } else {
+                batch_ = msg;
+            }
+            tail = msg;
+            ++count;
         }
 
-        uthrow_if(!ptr, "Cannot find barrier!\n");
+        // 泵一直没有空闲时，等待超时的空闲任务排在最后执行。
+        takeExpiredIdle(cur, tail);
+        return count;
+    }
 
-        // over the barrier
-        auto prev = ptr;
-        ptr = ptr->next;
+    Message* MessageQueue::takeExpiredIdle(uint64_t cur, Message* tail) {
+        // 空闲任务通常很少，直接遍历即可。
+        Message* prev = nullptr;
+        auto msg = idle_.head;
+        while (msg) {
+            auto next = msg->next;
+            bool expired = msg->time_ns != 0 && msg->time_ns <= cur;
+            if (msg->isCancelled() || expired) {
+                // erase_after prev
+                if (prev) {
+                    prev->next = next;
+                } else {
+                    idle_.head = next;
+                }
+                if (idle_.tail == msg) {
+                    idle_.tail = prev;
+                }
+                --idle_.count;
 
-        auto cur = Cycler::now().count();
-        while (ptr) {
-            // 从队列中摘除该消息
-            // erase_after prev
-            prev->next = ptr->next;
+                if (msg->isCancelled()) {
+                    recycle(msg);
+                } else {
+                    msg->next = nullptr;
+                    msg->setInBatch(true);
+                    if (tail) {
+                        tail->next = msg;
+                    } else {
+                        batch_ = msg;
+                    }
+                    tail = msg;
+                }
+            } else {
+                prev = msg;
+            }
+            msg = next;
+        }
+        return tail;
+    }
 
-            // 发现可以执行的消息就立即返回，即使后面可能存在延时消息。
-            // 因此外部调用应循环调用 dequeue() 直到消息队列枯竭为止，
-            // 否则队列后面的消息可能永远无法执行。
-            if (ptr->time_ns <= uint64_t(cur)) {
-                *out = ptr;
-                return true;
+    bool MessageQueue::takeIdle() {
+        std::lock_guard<std::mutex> lk(queue_sync_);
+        if (batch_) {
+            return false;
+        }
+
+        while (auto msg = idle_.head) {
+            // pop_front
+            idle_.head = msg->next;
+            if (!idle_.head) {
+                idle_.tail = nullptr;
+            }
+            --idle_.count;
+            msg->next = nullptr;
+
+            if (msg->isCancelled()) {
+                recycle(msg);
+                continue;
             }
 
-            enqueueDelayed(ptr);
-            ptr = prev->next;
+            msg->setInBatch(true);
+            batch_ = msg;
+            return true;
         }
+        return false;
+    }
+
+    bool MessageQueue::nextInBatch(uint64_t cur, Message** done, Message** out) {
+        while (auto msg = batch_) {
+            batch_ = msg->next;
+            msg->next = *done;
+            *done = msg;
+
+            if (!msg->claim()) {
+                // 取出之后才被取消
+                continue;
+            }
 
+            if (!msg->is_idle) {
+                auto delay = cur > msg->time_ns ? cur - msg->time_ns : 0;
+                auto& stats = batch_stats_[msg->priority];
+                ++stats.count;
+                stats.total_delay_ns += delay;
+                stats.max_delay_ns = std::max(stats.max_delay_ns, delay);
+            }
+
+            *out = msg;
+            return true;
+        }
         return false;
     }
 
-    bool MessageQueue::dequeueDelayed(int64_t* delay_ns, Message** out) {
-        std::lock_guard<std::mutex> lk(queue_sync_);
+    bool MessageQueue::finishBatch(Message* done, int64_t* delay_ns) {
+        Message* dropped = nullptr;
+        bool has_more = false;
+        {
+            std::lock_guard<std::mutex> lk(queue_sync_);
+            for (auto it = done; it; it = it->next) {
+                unlink(it);
+            }
 
-        auto ptr = delayed_;
-        decltype(ptr) prev = nullptr;
+            if (batch_) {
+                // 时间片用完，剩下的消息按原顺序放回各自队列的头部。
+                ReadyQueue rest[Message::PRI_COUNT];
+                ReadyQueue rest_idle;
+                while (auto msg = batch_) {
+                    batch_ = msg->next;
+                    if (msg->isCancelled()) {
+                        msg->next = dropped;
+                        dropped = msg;
+                        continue;
+                    }
+
+                    msg->setInBatch(false);
+                    pushBack(msg->is_idle ? rest_idle : rest[msg->priority], msg);
+                }
 
-        if (ptr) {
-            auto cur = Cycler::now().count();
-            if (ptr->time_ns <= uint64_t(cur)) {
-                // 从队列中摘除该消息
-                *out = ptr;
-                if (prev) {
-                    // erase_after prev
-                    prev->next = ptr->next;
-                } else {
-                    // pop_front
-                    delayed_ = ptr->next;
+                for (size_t p = 0; p < Message::PRI_COUNT; ++p) {
+                    pushFront(ready_[p], rest[p]);
                 }
-                return true;
+                pushFront(idle_, rest_idle);
             }
 
-            *delay_ns = ptr->time_ns - cur;
-        } else {
-            *delay_ns = -1;
+            for (size_t p = 0; p < Message::PRI_COUNT; ++p) {
+                auto& src = batch_stats_[p];
+                auto& dst = ready_[p].stats;
+                dst.count += src.count;
+                dst.total_delay_ns += src.total_delay_ns;
+                dst.max_delay_ns = std::max(dst.max_delay_ns, src.max_delay_ns);
+                src = PriorityStats();
+
+                has_more |= !!ready_[p].head;
+            }
+            has_more |= !!incoming_.load(std::memory_order_relaxed);
+
+            // 执行本批期间到期的延时消息需要立即处理。
+            *delay_ns = computeDelayedTime();
+            has_more |= *delay_ns == 0;
         }
 
-        return false;
+        // 这些消息已不在任何结构中，也不再被索引引用，可以在锁外回收。
+        while (done) {
+            auto next = done->next;
+            done->reset();
+            done = next;
+        }
+        while (dropped) {
+            auto next = dropped->next;
+            dropped->reset();
+            dropped = next;
+        }
+        return has_more;
+    }
+
+    bool MessageQueue::cancel(Cycler* c, const MessageHandle& h) {
+        // 其他对象投递的消息不在本队列中，不能访问，更不能按本队列的状态处理。
+        if (!c || h.owner_ != c) {
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lk(queue_sync_);
+        if (!Message::isPending(h) || h.msg_->target != c) {
+            return false;
+        }
+        if (!Message::cancel(h)) {
+            return false;
+        }
+
+        // 消息由 c 投递且句柄有效，因此它一定还在本队列中，且未被回收。
+        discard(h.msg_);
+        return true;
     }
 
     void MessageQueue::remove(Cycler* c) {
@@ -170,90 +459,150 @@ namespace utl {
         }
 
         std::lock_guard<std::mutex> lk(queue_sync_);
-        remove(&message_, c);
-        remove(&delayed_, c);
+        drainIncoming();
+
+        while (auto msg = c->queued_) {
+            removeLinked(msg);
+        }
     }
 
-    void MessageQueue::remove(Message** head, Cycler* c) {
-        auto ptr = *head;
-        decltype(ptr) prev = nullptr;
-        for (; ptr; ) {
-            if (ptr->target == c) {
-                if (prev) {
-                    // erase_after prev
-                    prev->next = ptr->next;
-                    ptr->reset();
+    void MessageQueue::remove(Cycler* c, int id) {
+        if (!c) {
+            return;
+        }
 
-                    ptr = prev->next;
-                } else {
-                    // pop_front
-                    *head = ptr->next;
-                    ptr->reset();
+        std::lock_guard<std::mutex> lk(queue_sync_);
+        drainIncoming();
 
-                    ptr = *head;
-                }
-                continue;
+        auto msg = c->queued_;
+        while (msg) {
+            auto next = msg->index_next;
+            if (msg->id == id) {
+                removeLinked(msg);
             }
-
-            prev = ptr;
-            ptr = ptr->next;
+            msg = next;
         }
     }
 
-    void MessageQueue::remove(Cycler* c, int id) {
+    void MessageQueue::detach(Cycler* c) {
         if (!c) {
             return;
         }
 
         std::lock_guard<std::mutex> lk(queue_sync_);
-        remove(&message_, c, id);
-        remove(&delayed_, c, id);
+        drainIncoming();
+
+        while (auto msg = c->queued_) {
+            unlink(msg);
+        }
     }
 
-    void MessageQueue::remove(Message** head, Cycler* c, int id) {
-        auto ptr = *head;
-        decltype(ptr) prev = nullptr;
-        for (; ptr; ) {
-            if (ptr->target == c &&
-                ptr->id == id)
-            {
-                if (prev) {
-                    // erase_after prev
-                    prev->next = ptr->next;
-                    ptr->reset();
+    // static
+    void MessageQueue::link(Message* msg) {
+        auto c = msg->target;
+        if (!c) {
+            return;
+        }
 
-                    ptr = prev->next;
-                } else {
-                    // pop_front
-                    *head = ptr->next;
-                    ptr->reset();
+        // push_front
+        msg->index_next = c->queued_;
+        if (c->queued_) {
+            c->queued_->index_pprev = &msg->index_next;
+        }
+        c->queued_ = msg;
+        msg->index_pprev = &c->queued_;
+    }
 
-                    ptr = *head;
-                }
-                continue;
-            }
+    // static
+    void MessageQueue::unlink(Message* msg) {
+        if (!msg->index_pprev) {
+            return;
+        }
 
-            prev = ptr;
-            ptr = ptr->next;
+        *msg->index_pprev = msg->index_next;
+        if (msg->index_next) {
+            msg->index_next->index_pprev = msg->index_pprev;
         }
+        msg->index_next = nullptr;
+        msg->index_pprev = nullptr;
     }
 
-    void MessageQueue::clear() {
-        std::lock_guard<std::mutex> lk(queue_sync_);
+    void MessageQueue::removeLinked(Message* msg) {
+        if (Message::cancel(msg->getHandle(msg->target))) {
+            discard(msg);
+        } else {
+            // 已在本批中开始执行
+            unlink(msg);
+        }
+    }
 
-        auto msg = message_;
-        while (msg) {
-            auto tmp = msg;
-            msg = msg->next;
-            tmp->reset();
+    void MessageQueue::discard(Message* msg) {
+        ubassert(msg->isCancelled());
+
+        unlink(msg);
+        if (msg->isInBatch()) {
+            // 消费线程正持有该消息，由它在跳过时回收。
+            return;
         }
 
-        msg = delayed_;
-        while (msg) {
-            auto tmp = msg;
-            msg = msg->next;
-            tmp->reset();
+        // 先释放消息持有的资源，消息本身留待之后回收。
+        msg->releasePayload();
+        ++cancelled_;
+    }
+
+    void MessageQueue::recycle(Message* msg) {
+        if (msg->isCancelled()) {
+            ubassert(cancelled_ > 0);
+            --cancelled_;
+        }
+        unlink(msg);
+        msg->reset();
+    }
+
+    void MessageQueue::recycleAll(Message* head) {
+        while (head) {
+            auto tmp = head;
+            head = head->next;
+            recycle(tmp);
+        }
+    }
+
+    Message* MessageQueue::topDelayed() {
+        auto ptr = delayed_->top();
+        while (ptr && ptr->isCancelled()) {
+            delayed_->pop();
+            recycle(ptr);
+            ptr = delayed_->top();
         }
+        return ptr;
+    }
+
+    void MessageQueue::purgeCancelled() {
+        // 就绪队列很快就会被取空，已取消的消息基本都积压在延时结构中。
+        // 只在其占到一半以上时才清理，使每次清理的 O(n) 开销能够均摊到之前的取消操作上。
+        if (cancelled_ < 64 || cancelled_ * 2 < delayed_->size()) {
+            return;
+        }
+
+        recycleAll(delayed_->extract(
+            [](const Message& m) { return m.isCancelled(); }));
+    }
+
+    void MessageQueue::clear() {
+        std::lock_guard<std::mutex> lk(queue_sync_);
+        drainIncoming();
+
+        for (auto& q : ready_) {
+            recycleAll(q.head);
+            q.head = nullptr;
+            q.tail = nullptr;
+            q.count = 0;
+        }
+        recycleAll(idle_.head);
+        idle_.head = nullptr;
+        idle_.tail = nullptr;
+        idle_.count = 0;
+        recycleAll(delayed_->extract([](const Message&) { return true; }));
     }
 
     bool MessageQueue::contains(Cycler* c, int id) {
@@ -262,14 +611,10 @@ namespace utl {
         }
 
         std::lock_guard<std::mutex> lk(queue_sync_);
-        return contains(message_, c, id) || contains(delayed_, c, id);
-    }
+        drainIncoming();
 
-    bool MessageQueue::contains(Message* head, Cycler* c, int id) {
-        for (auto it = head; it; it = it->next) {
-            if (it->target == c &&
-                it->id == id)
-            {
+        for (auto it = c->queued_; it; it = it->index_next) {
+            if (it->id == id && !it->isSettled()) {
                 return true;
             }
         }
@@ -280,18 +625,27 @@ namespace utl {
         std::lock_guard<std::mutex> lk(queue_sync_);
         bool result = false;
         if (lists & ML_NORMAL) {
-            result |= !!message_;
+            for (const auto& q : ready_) {
+                result |= !!q.head;
+            }
+            result |= !!incoming_.load(std::memory_order_relaxed);
         }
         if (lists & ML_DELAYED) {
-            result |= !!delayed_;
+            result |= !!topDelayed();
+        }
+        if (lists & ML_IDLE) {
+            result |= !!idle_.head;
         }
         return result;
     }
 
     int64_t MessageQueue::getDelayedTime() {
         std::lock_guard<std::mutex> lk(queue_sync_);
+        return computeDelayedTime();
+    }
 
-        auto ptr = delayed_;
+    int64_t MessageQueue::computeDelayedTime() {
+        auto ptr = topDelayed();
         if (ptr) {
             auto cur = Cycler::now().count();
             if (ptr->time_ns <= uint64_t(cur)) {
@@ -302,44 +656,19 @@ namespace utl {
         return -1;
     }
 
-    void MessageQueue::addBarrier() {
+    MessageQueue::TimerStats MessageQueue::getTimerStats() {
         std::lock_guard<std::mutex> lk(queue_sync_);
-
-        if (has_barrier_) {
-            return;
-        }
-
-        Message* barrier = Message::get();
-        barrier->is_barrier = true;
-        // push_front
-        barrier->next = message_;
-        message_ = barrier;
-
-        has_barrier_ = true;
+        return timer_stats_;
     }
 
-    void MessageQueue::removeBarrier() {
-        std::lock_guard<std::mutex> lk(queue_sync_);
-
-        auto ptr = message_;
-        Message* prev = nullptr;
-        for (; ptr; ptr = ptr->next) {
-            if (ptr->is_barrier) {
-                if (prev) {
-                    // erase_after prev
-                    prev->next = ptr->next;
-                } else {
-                    // pop_front
-                    message_ = ptr->next;
-                }
-                ptr->reset();
-                break;
-            }
-
-            prev = ptr;
+    MessageQueue::PriorityStats MessageQueue::getPriorityStats(Message::Priority p) {
+        if (p >= Message::PRI_COUNT) {
+            ubassert(false);
+            return {};
         }
 
-        has_barrier_ = false;
+        std::lock_guard<std::mutex> lk(queue_sync_);
+        return ready_[p].stats;
     }
 
 }
@@ -7,50 +7,150 @@
 #ifndef UTILS_MESSAGE_MESSAGE_QUEUE_H_
 #define UTILS_MESSAGE_MESSAGE_QUEUE_H_
 
+#include <atomic>
 #include <mutex>
 
+#include "utils/message/message.h"
+#include "utils/time_utils.h"
+
 
 namespace utl {
 
     class Cycler;
-    class Message;
+    class TimerQueue;
 
     class MessageQueue {
     public:
+        using ns = TimeUtils::ns;
+        using nsp = TimeUtils::nsp;
+
         enum MessageList {
             ML_NORMAL  = 1 << 0,
             ML_DELAYED = 1 << 1,
+            ML_IDLE    = 1 << 2,
+        };
+
+        /**
+         * 每个优先级的排队统计，排队时间为消息到期到被取出执行之间的时间。
+         */
+        struct PriorityStats {
+            // 被取出执行的消息数量
+            uint64_t count = 0;
+            uint64_t total_delay_ns = 0;
+            uint64_t max_delay_ns = 0;
+            // 因等待超过时限而被提前执行的次数
+            uint64_t aged = 0;
+        };
+
+        /**
+         * 延时消息的到期统计。
+         * 到期时间被余量推迟、并与其他消息落在同一时刻的消息，不再需要单独唤醒一次，
+         * 这样合并掉的唤醒次数记为 wakeups_saved。参见 Cycler::setTimerSlack()。
+         */
+        struct TimerStats {
+            // 到期的延时消息数量
+            uint64_t fired = 0;
+            // 处理到期消息的次数，每次至少有一个消息到期
+            uint64_t wakeups = 0;
+            // 由余量合并掉的唤醒次数，按被推迟的消息原到期时间互不相同计算
+            uint64_t wakeups_saved = 0;
         };
 
         MessageQueue();
         ~MessageQueue();
 
+        /**
+         * 替换存放延时消息的结构。默认使用四叉堆。
+         * 已有的延时消息会被移入新的结构中。
+         * @param timers 新的结构，MessageQueue 将接管其所有权。
+         */
+        void setTimerQueue(TimerQueue* timers);
+
+        /**
+         * 设置某一优先级的消息在就绪队列中最多等待多长时间。
+         * 超过该时间后，即使存在更高优先级的消息，也会先执行它，以免低优先级的消息被饿死。
+         * 对 PRI_CRITICAL 设置无效。
+         */
+        void setAgingLimit(Message::Priority p, nsp limit);
+
+        /**
+         * 将消息放入队列。
+         * 该方法不会获取队列锁，消息首先被压入无锁的接收栈中，
+         * 直到消费端（通常是泵所在线程）持锁时才会按优先级并入就绪队列，未到期的则放入延时结构。
+         * 可以在任意线程中调用。
+         */
         bool enqueue(Message* msg);
 
         /**
-         * 尝试从即时队列中获取一个消息。
-         * 如果发现延时消息，则将该消息放入延时队列，直到发现一个可用消息或到达队列尾部。
-         * 因此调用该方法时应使用循环，直到方法返回 false 以防止尾部消息永远不会被执行到。
-         * @param out 消息
-         * @return 如果队列中无消息，或没有达到指定时间的消息，返回 false，否则返回消息。
+         * 将一串消息一次性放入队列，只需要一次原子操作。参见 PostBatch。
+         * @param head 链表头，为最后投递的消息，通过 Message::next 依次指向更早投递的消息。
+         * @param tail 链表尾，为最早投递的消息。
          */
-        bool dequeue(Message** out);
+        bool enqueue(Message* head, Message* tail);
 
         /**
-         * 尝试从延时队列中获取一个消息。
-         * @param delay_ns 如果返回值不为 false，该参数的值未定义。
-         *              否则，当存在延时消息时，该参数的值为剩余延时；
-         *              当不存在任何消息时，该参数的值为 -1。
+         * 将接收栈中的消息和已到期的延时消息并入就绪队列，然后一次性取出所有就绪的消息作为新的一批，
+         * 批内按优先级和时限排好执行顺序。之后由 nextInBatch() 逐个取出，不需要再获取锁。
+         * 如果上一批还有未处理的消息（例如在嵌套的消息循环中），则继续处理上一批，不取新的。
+         * 以下三个方法只能在消费线程中调用。
+         * @return 新取出的消息数量，继续处理上一批时返回 0。
+         */
+        size_t takeBatch();
+
+        /**
+         * 从当前批次中取出下一个可以执行的消息，不获取锁。
+         * 批内的消息在执行前仍可以被取消，被取消的消息会被跳过。
+         * @param cur 当前时间，用于统计排队时间。
+         * @param done 处理过的消息（包括被跳过的）会被串到该链表中，之后交给 finishBatch()。
          * @param out 消息
-         * @return 如果队列中无消息，或没有达到指定时间的消息，返回 false，否则返回 true。
+         * @return 本批中已没有可以执行的消息时，返回 false。
+         */
+        bool nextInBatch(uint64_t cur, Message** done, Message** out);
+
+        /**
+         * 取出最早的一个空闲任务作为新的一批，之后同样由 nextInBatch() 和 finishBatch() 处理。
+         * 应在没有其他可执行的消息时调用。
+         * @return 没有空闲任务，或上一批还有未处理的消息时，返回 false。
+         */
+        bool takeIdle();
+
+        /**
+         * 结束本批的处理。回收 done 中的消息，并将本批中未处理的消息按原顺序放回就绪队列的头部。
+         * 同时在这次持锁中算出下一个延时消息的等待时间，泵不需要再为此获取锁。
+         * @param delay_ns 下一个延时消息的等待时间，取值与 getDelayedTime() 相同。
+         * @return 如果仍有就绪、刚放入或已到期的消息，返回 true。
          */
-        bool dequeueDelayed(int64_t* delay_ns, Message** out);
+        bool finishBatch(Message* done, int64_t* delay_ns);
 
+        /**
+         * 取消 c 投递的、句柄所指的消息。O(1)。
+         * 消息会被立即移出 Cycler 的索引并释放其持有的资源，
+         * 但其本身仍留在原结构中，直到被取出或被批量清理时才会回收。
+         * @return 如果消息由 c 投递、仍在等待执行且成功取消，返回 true；
+         *         句柄属于其他 Cycler、泵或线程池时返回 false，消息不受影响。
+         */
+        bool cancel(Cycler* c, const MessageHandle& h);
+
+        /**
+         * 移除 Cycler 的消息。
+         * 以下方法只遍历该 Cycler 自己的待执行消息，与队列中的消息总数无关。
+         */
         void remove(Cycler* c);
         void remove(Cycler* c, int id);
         void clear();
 
+        /**
+         * 将 Cycler 的所有消息移出其索引，但不移除消息。
+         * 在 Cycler 析构而又不需要清除消息时调用。
+         */
+        void detach(Cycler* c);
+
         bool contains(Cycler* c, int id);
+
+        /**
+         * ML_NORMAL 表示已就绪或刚放入的消息，ML_DELAYED 表示未到期的延时消息，
+         * ML_IDLE 表示空闲任务。
+         */
         bool hasMessages(unsigned int lists);
 
         /**
@@ -61,19 +161,94 @@ namespace utl {
          */
         int64_t getDelayedTime();
 
-        void addBarrier();
-        void removeBarrier();
+        PriorityStats getPriorityStats(Message::Priority p);
+        TimerStats getTimerStats();
+
+        static constexpr ns kDefaultNormalAgingLimit = std::chrono::milliseconds(50);
+        static constexpr ns kDefaultBackgroundAgingLimit = std::chrono::milliseconds(200);
 
     private:
+        struct ReadyQueue {
+            Message* head = nullptr;
+            Message* tail = nullptr;
+            size_t count = 0;
+            // 超过该时间未执行的消息优先执行，单位为纳秒
+            int64_t aging_limit = 0;
+            PriorityStats stats;
+        };
+
+        static void pushBack(ReadyQueue& q, Message* msg);
+        static void pushFront(ReadyQueue& q, const ReadyQueue& chain);
+
+        void enqueueReady(Message* msg);
         void enqueueDelayed(Message* msg);
 
-        void remove(Message** head, Cycler* c);
-        void remove(Message** head, Cycler* c, int id);
-        bool contains(Message* head, Cycler* c, int id);
+        /**
+         * 将已超过等待时限的空闲任务从空闲队列中取出，串到 tail 之后。
+         * @return 新的链表尾部。
+         */
+        Message* takeExpiredIdle(uint64_t cur, Message* tail);
+
+        /**
+         * 将接收栈中的消息按入栈顺序分发到就绪队列或延时结构中。
+         * 调用前必须持有 queue_sync_。
+         */
+        void drainIncoming();
+
+        /**
+         * 将已到期的延时消息移入就绪队列。调用前必须持有 queue_sync_。
+         */
+        void promoteDelayed(uint64_t cur);
+
+        /**
+         * 按优先级和时限选出一个就绪队列并取出其队首，途经的已取消消息会被回收。
+         */
+        Message* popReady(uint64_t cur);
+
+        /**
+         * 移除 Cycler 索引中的消息：仍在等待的将被取消，已开始执行的只移出索引。
+         */
+        void removeLinked(Message* msg);
+
+        /**
+         * 将消息加入或移出其所属 Cycler 的索引。调用前必须持有 queue_sync_。
+         */
+        static void link(Message* msg);
+        static void unlink(Message* msg);
+
+        void discard(Message* msg);
+        void recycle(Message* msg);
+        void recycleAll(Message* head);
+
+        /**
+         * 获取延时结构中最早到期且未被取消的消息，途经的已取消消息会被回收。
+         */
+        Message* topDelayed();
+
+        /**
+         * getDelayedTime() 的实现。调用前必须持有 queue_sync_。
+         */
+        int64_t computeDelayedTime();
+
+        /**
+         * 已取消的消息过多时，从延时结构中一次性清理掉它们。
+         */
+        void purgeCancelled();
+
+        ReadyQueue ready_[Message::PRI_COUNT];
+        // 空闲任务，先进先出。Message::time_ns 为其最晚执行时间，为 0 时不限制。
+        ReadyQueue idle_;
+        TimerQueue* delayed_;
+        TimerStats timer_stats_;
+
+        std::atomic<Message*> incoming_;
+        // 已取消但仍留在队列中的消息数量。
+        size_t cancelled_;
 
-        Message* message_;
-        Message* delayed_;
-        bool has_barrier_;
+        // 消费线程当前正在处理的一批消息，只由消费线程访问。
+        Message* batch_;
+        // 本批消息的排队统计，结束时并入 ready_ 中。
+        PriorityStats batch_stats_[Message::PRI_COUNT];
         std::mutex queue_sync_;
     };
 
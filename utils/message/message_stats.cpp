@@ -0,0 +1,189 @@
+// Copyright (c) 2016 ucclkp <ucclkp@gmail.com>.
+// This file is part of utils project.
+//
+// This program is licensed under GPLv3 license that can be
+// found in the LICENSE file.
+
+#include "utils/message/message_stats.h"
+
+#ifdef UTL_MESSAGE_STATS
+
+#include <algorithm>
+#include <limits>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "utils/message/message.h"
+
+
+namespace {
+
+    unsigned highestBit(uint64_t val) {
+#if defined(_MSC_VER) && defined(_WIN64)
+        unsigned long r;
+        _BitScanReverse64(&r, val);
+        return unsigned(r);
+#elif defined(_MSC_VER)
+        unsigned long r;
+        if (_BitScanReverse(&r, static_cast<unsigned long>(val >> 32))) {
+            return unsigned(r) + 32;
+        }
+        _BitScanReverse(&r, static_cast<unsigned long>(val));
+        return unsigned(r);
+#else
+        return 63u - unsigned(__builtin_clzll(val));
+#endif
+    }
+
+}
+
+namespace utl {
+
+    // Histogram::Snapshot
+    uint64_t Histogram::Snapshot::mean() const {
+        return count ? total / count : 0;
+    }
+
+    uint64_t Histogram::Snapshot::percentile(double p) const {
+        if (count == 0) {
+            return 0;
+        }
+
+        p = std::min(std::max(p, 0.0), 100.0);
+        auto rank = uint64_t(p / 100.0 * double(count) + 0.5);
+        rank = std::min(std::max(rank, uint64_t(1)), count);
+
+        uint64_t seen = 0;
+        for (size_t i = 0; i < buckets.size(); ++i) {
+            seen += buckets[i];
+            if (seen >= rank) {
+                return std::min(bucketUpperBound(i), max);
+            }
+        }
+        return max;
+    }
+
+
+    // Histogram
+    Histogram::Histogram()
+        : total_(0),
+          min_(std::numeric_limits<uint64_t>::max()),
+          max_(0)
+    {
+        for (auto& b : buckets_) {
+            b.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // static
+    void Histogram::store(std::atomic<uint64_t>& counter, uint64_t val) {
+        // 只有一个写入者，不需要原子的读-改-写操作。
+        counter.store(val, std::memory_order_relaxed);
+    }
+
+    void Histogram::record(uint64_t value) {
+        auto& b = buckets_[bucketIndex(value)];
+        store(b, b.load(std::memory_order_relaxed) + 1);
+        store(total_, total_.load(std::memory_order_relaxed) + value);
+        if (value < min_.load(std::memory_order_relaxed)) {
+            store(min_, value);
+        }
+        if (value > max_.load(std::memory_order_relaxed)) {
+            store(max_, value);
+        }
+    }
+
+    Histogram::Snapshot Histogram::snapshot() const {
+        Snapshot s;
+        s.buckets.resize(kBucketCount);
+        for (size_t i = 0; i < kBucketCount; ++i) {
+            s.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+            s.count += s.buckets[i];
+        }
+        if (s.count) {
+            s.total = total_.load(std::memory_order_relaxed);
+            s.min = min_.load(std::memory_order_relaxed);
+            s.max = max_.load(std::memory_order_relaxed);
+        }
+        return s;
+    }
+
+    // static
+    size_t Histogram::bucketIndex(uint64_t value) {
+        if (value < 2 * kSubBuckets) {
+            return size_t(value);
+        }
+
+        auto exp = highestBit(value);
+        if (exp > kMaxExponent) {
+            return kBucketCount - 1;
+        }
+
+        auto sub = size_t(value >> (exp - kSubBucketBits)) & (kSubBuckets - 1);
+        return (exp - kSubBucketBits + 1) * kSubBuckets + sub;
+    }
+
+    // static
+    uint64_t Histogram::bucketUpperBound(size_t index) {
+        if (index < 2 * kSubBuckets) {
+            return index;
+        }
+        if (index >= kBucketCount - 1) {
+            return std::numeric_limits<uint64_t>::max();
+        }
+
+        auto exp = unsigned(index / kSubBuckets) + kSubBucketBits - 1;
+        auto sub = uint64_t(index % kSubBuckets);
+        auto width = uint64_t(1) << (exp - kSubBucketBits);
+        return ((kSubBuckets + sub) << (exp - kSubBucketBits)) + width - 1;
+    }
+
+
+    // MessageStats
+    MessageStats::~MessageStats() {
+        for (auto& pair : by_id_) {
+            delete pair.second;
+        }
+    }
+
+    void MessageStats::recordDepth(size_t depth) {
+        depth_.record(depth);
+    }
+
+    void MessageStats::recordRun(const Message& msg, uint64_t delay_ns, uint64_t run_ns) {
+        queue_delay_.record(delay_ns);
+        run_time_.record(run_ns);
+
+        Histogram* h;
+        auto it = by_id_.find(msg.id);
+        if (it != by_id_.end()) {
+            h = it->second;
+        } else {
+            if (by_id_.size() >= kMaxTrackedIds) {
+                return;
+            }
+            h = new Histogram();
+            std::lock_guard<std::mutex> lk(by_id_sync_);
+            by_id_[msg.id] = h;
+        }
+        h->record(run_ns);
+    }
+
+    MessageStats::Snapshot MessageStats::snapshot() const {
+        Snapshot s;
+        s.queue_delay = queue_delay_.snapshot();
+        s.run_time = run_time_.snapshot();
+        s.depth = depth_.snapshot();
+
+        std::lock_guard<std::mutex> lk(by_id_sync_);
+        for (const auto& pair : by_id_) {
+            s.run_time_by_id[pair.first] = pair.second->snapshot();
+        }
+        return s;
+    }
+
+}
+
+#endif  // UTL_MESSAGE_STATS
@@ -0,0 +1,125 @@
+// Copyright (c) 2016 ucclkp <ucclkp@gmail.com>.
+// This file is part of utils project.
+//
+// This program is licensed under GPLv3 license that can be
+// found in the LICENSE file.
+
+#ifndef UTILS_MESSAGE_MESSAGE_STATS_H_
+#define UTILS_MESSAGE_MESSAGE_STATS_H_
+
+/**
+ * 消息循环的统计，只有在构建时定义了 UTL_MESSAGE_STATS 才会编译进来，
+ * 否则 MessagePump 中不存在相关的成员和调用。
+ * 该宏会改变 MessagePump 的布局，所有翻译单元必须一致。
+ */
+#ifdef UTL_MESSAGE_STATS
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+
+namespace utl {
+
+    class Message;
+
+    /**
+     * 对数分桶的直方图。
+     * 每个 2 的幂区间再等分为 kSubBuckets 个桶，相对误差不超过 1/kSubBuckets，
+     * 记录一个值只需要计算桶号并更新几个计数器，不需要分配内存。
+     * 只允许一个线程记录，其他线程可以随时读取快照。
+     */
+    class Histogram {
+    public:
+        struct Snapshot {
+            uint64_t count = 0;
+            uint64_t total = 0;
+            uint64_t min = 0;
+            uint64_t max = 0;
+            // 下标为桶号，参见 bucketIndex()
+            std::vector<uint64_t> buckets;
+
+            uint64_t mean() const;
+
+            /**
+             * 获取百分位数，返回所在桶的上界。
+             * @param p 取值范围为 [0, 100]。
+             */
+            uint64_t percentile(double p) const;
+        };
+
+        Histogram();
+
+        void record(uint64_t value);
+        Snapshot snapshot() const;
+
+        static size_t bucketIndex(uint64_t value);
+        static uint64_t bucketUpperBound(size_t index);
+
+        static constexpr unsigned kSubBucketBits = 4;
+        static constexpr size_t kSubBuckets = size_t(1) << kSubBucketBits;
+        // 超过 2^kMaxExponent 的值计入最后一个桶。纳秒计时约为 18 分钟。
+        static constexpr unsigned kMaxExponent = 40;
+        static constexpr size_t kBucketCount = (kMaxExponent - kSubBucketBits + 2) * kSubBuckets;
+
+    private:
+        static void store(std::atomic<uint64_t>& counter, uint64_t val);
+
+        std::atomic<uint64_t> buckets_[kBucketCount];
+        std::atomic<uint64_t> total_;
+        std::atomic<uint64_t> min_;
+        std::atomic<uint64_t> max_;
+    };
+
+    /**
+     * 一个泵的消息统计，由泵所在的线程记录。
+     */
+    class MessageStats {
+    public:
+        struct Snapshot {
+            // 消息到期到开始执行之间的时间，单位为纳秒
+            Histogram::Snapshot queue_delay;
+            // 消息的执行时间，单位为纳秒
+            Histogram::Snapshot run_time;
+            // 每一批取出的就绪消息数量
+            Histogram::Snapshot depth;
+            // 按 Message::id 分类的执行时间，未指定 id 的消息归入 -1
+            std::map<int, Histogram::Snapshot> run_time_by_id;
+        };
+
+        MessageStats() = default;
+        ~MessageStats();
+
+        MessageStats(const MessageStats&) = delete;
+        MessageStats& operator=(const MessageStats&) = delete;
+
+        void recordDepth(size_t depth);
+        void recordRun(const Message& msg, uint64_t delay_ns, uint64_t run_ns);
+
+        /**
+         * 可以在任意线程中调用。
+         */
+        Snapshot snapshot() const;
+
+        // 单独统计执行时间的 id 数量上限，超出的 id 只计入总体统计
+        static constexpr size_t kMaxTrackedIds = 64;
+
+    private:
+        Histogram queue_delay_;
+        Histogram run_time_;
+        Histogram depth_;
+
+        // 只由记录线程增加元素，增加时持锁；记录线程自己查找时不需要持锁。
+        std::unordered_map<int, Histogram*> by_id_;
+        mutable std::mutex by_id_sync_;
+    };
+
+}
+
+#endif  // UTL_MESSAGE_STATS
+
+#endif  // UTILS_MESSAGE_MESSAGE_STATS_H_
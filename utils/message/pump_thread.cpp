@@ -0,0 +1,50 @@
+// Copyright (c) 2016 ucclkp <ucclkp@gmail.com>.
+// This file is part of utils project.
+//
+// This program is licensed under GPLv3 license that can be
+// found in the LICENSE file.
+
+#include "utils/message/pump_thread.h"
+
+#include <future>
+
+#include "utils/message/message.h"
+#include "utils/message/message_pump.h"
+
+
+namespace utl {
+
+    PumpThread::PumpThread(const ThreadOptions& options) {
+        std::promise<std::weak_ptr<MessagePump>> ready;
+        auto future = ready.get_future();
+
+        // promise 随线程函数移走，构造函数返回后不再被引用。
+        thread_ = std::thread([options, ready = std::move(ready)]() mutable {
+            MessagePump::create(options);
+            ready.set_value(MessagePump::getCurrent());
+            MessagePump::run();
+            MessagePump::destroy();
+        });
+        pump_ = future.get();
+    }
+
+    PumpThread::~PumpThread() {
+        stop();
+    }
+
+    const std::weak_ptr<MessagePump>& PumpThread::getPump() const {
+        return pump_;
+    }
+
+    void PumpThread::stop() {
+        if (!thread_.joinable()) {
+            return;
+        }
+
+        auto msg = Message::get();
+        msg->func.emplace([]() { MessagePump::quit(); });
+        MessagePump::postTo(pump_, msg);
+        thread_.join();
+    }
+
+}
@@ -0,0 +1,50 @@
+// Copyright (c) 2016 ucclkp <ucclkp@gmail.com>.
+// This file is part of utils project.
+//
+// This program is licensed under GPLv3 license that can be
+// found in the LICENSE file.
+
+#ifndef UTILS_MESSAGE_PUMP_THREAD_H_
+#define UTILS_MESSAGE_PUMP_THREAD_H_
+
+#include <memory>
+#include <thread>
+
+#include "utils/thread_utils.h"
+
+
+namespace utl {
+
+    class MessagePump;
+
+    /**
+     * 运行着 MessagePump 的线程。
+     * 构造时启动线程，按 options 设置线程后在其中创建泵（参见 MessagePump::create(const ThreadOptions&)），
+     * 泵开始运行后构造函数才返回。通过 getPump() 创建 Cycler 即可向该线程投递消息：
+     *   PumpThread io({ "io", ThreadUtils::getCpusOfNode(0) });
+     *   Cycler cycler(io.getPump());
+     */
+    class PumpThread {
+    public:
+        explicit PumpThread(const ThreadOptions& options = ThreadOptions());
+        ~PumpThread();
+
+        PumpThread(const PumpThread&) = delete;
+        PumpThread& operator=(const PumpThread&) = delete;
+
+        const std::weak_ptr<MessagePump>& getPump() const;
+
+        /**
+         * 让泵在处理完已到期的消息后退出，并等待线程结束。析构时会自动调用。
+         * 不能在该线程自身中调用。
+         */
+        void stop();
+
+    private:
+        std::weak_ptr<MessagePump> pump_;
+        std::thread thread_;
+    };
+
+}
+
+#endif  // UTILS_MESSAGE_PUMP_THREAD_H_
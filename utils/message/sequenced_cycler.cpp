@@ -0,0 +1,399 @@
+// Copyright (c) 2016 ucclkp <ucclkp@gmail.com>.
+// This file is part of utils project.
+//
+// This program is licensed under GPLv3 license that can be
+// found in the LICENSE file.
+
+#include "utils/message/sequenced_cycler.h"
+
+#include <limits>
+#include <mutex>
+
+#include "utils/message/cycler.h"
+#include "utils/message/executable.h"
+#include "utils/message/thread_pool.h"
+#include "utils/message/timer_queue.h"
+
+
+namespace {
+
+    // 每次连续执行的最大消息数量，超过后让出工作线程，避免其他序列饥饿。
+    constexpr int kDrainBatch = 16;
+
+    constexpr int64_t kNoDeadline = std::numeric_limits<int64_t>::max();
+
+}
+
+namespace utl {
+
+    struct SequencedCycler::State {
+        explicit State(ThreadPool* p)
+            : pool(p) {}
+
+        ~State() {
+            resetAll();
+        }
+
+        // 调用前必须持有 sync
+        void append(Message* msg) {
+            msg->next = nullptr;
+            if (tail) {
+                tail->next = msg;
+            } else {
+                head = msg;
+            }
+            tail = msg;
+        }
+
+        // 调用前必须持有 sync
+        void recycle(Message* msg) {
+            if (msg->isCancelled()) {
+                --cancelled;
+            }
+            msg->reset();
+        }
+
+        // 调用前必须持有 sync
+        void resetAll() {
+            while (head) {
+                auto msg = head;
+                head = head->next;
+                recycle(msg);
+            }
+            tail = nullptr;
+
+            auto msg = timers.extract([](const Message&) { return true; });
+            while (msg) {
+                auto next = msg->next;
+                recycle(msg);
+                msg = next;
+            }
+        }
+
+        // 获取最早到期且未被取消的延时消息，途经的已取消消息会被回收。调用前必须持有 sync
+        Message* topTimer() {
+            auto top = timers.top();
+            while (top && top->isCancelled()) {
+                timers.pop();
+                recycle(top);
+                top = timers.top();
+            }
+            return top;
+        }
+
+        // 已取消的延时消息过多时，一次性清理掉它们。调用前必须持有 sync
+        void purgeCancelled() {
+            if (cancelled < 64 || cancelled * 2 < timers.size()) {
+                return;
+            }
+
+            auto msg = timers.extract([](const Message& m) { return m.isCancelled(); });
+            while (msg) {
+                auto next = msg->next;
+                recycle(msg);
+                msg = next;
+            }
+        }
+
+        ThreadPool* pool;
+        CyclerListener* listener = nullptr;
+
+        // 已到期的消息，先进先出
+        Message* head = nullptr;
+        Message* tail = nullptr;
+        TimerQuaternaryHeap timers;
+
+        // 是否已有 drain() 在线程池中等待或正在执行
+        bool running = false;
+        // 已取消但仍留在队列中的消息数量
+        size_t cancelled = 0;
+
+        // 已投递给线程池的定时任务及其到期时间，同一时刻只有一个
+        MessageHandle timer;
+        int64_t scheduled_due = kNoDeadline;
+        std::mutex sync;
+    };
+
+    thread_local const SequencedCycler::State* SequencedCycler::cur_state_ = nullptr;
+
+    SequencedCycler::SequencedCycler(ThreadPool* pool)
+        : state_(std::make_shared<State>(pool)) {}
+
+    SequencedCycler::~SequencedCycler() {
+        // 线程池中可能还有持有 state_ 的任务，它们会发现队列已空而直接返回。
+        clear();
+    }
+
+    void SequencedCycler::setListener(CyclerListener* l) {
+        std::lock_guard<std::mutex> lk(state_->sync);
+        state_->listener = l;
+    }
+
+    MessageHandle SequencedCycler::post(Executable* exec, int id) {
+        return postDelayed(exec, ns(0), id);
+    }
+
+    MessageHandle SequencedCycler::postDelayed(Executable* exec, nsp delay, int id) {
+        return postAtTime(exec, delay + now(), id);
+    }
+
+    MessageHandle SequencedCycler::postAtTime(Executable* exec, nsp at_time, int id) {
+        Message* msg = Message::get();
+        msg->callback = exec;
+        msg->id = id;
+
+        return postAtTime(msg, at_time);
+    }
+
+    MessageHandle SequencedCycler::post(int id) {
+        return postDelayed(id, ns(0));
+    }
+
+    MessageHandle SequencedCycler::postDelayed(int id, nsp delay) {
+        return postAtTime(id, delay + now());
+    }
+
+    MessageHandle SequencedCycler::postAtTime(int id, nsp at_time) {
+        Message* msg = Message::get();
+        msg->id = id;
+
+        return postAtTime(msg, at_time);
+    }
+
+    MessageHandle SequencedCycler::post(Message* msg) {
+        return postDelayed(msg, ns(0));
+    }
+
+    MessageHandle SequencedCycler::postDelayed(Message* msg, nsp delay) {
+        return postAtTime(msg, delay + now());
+    }
+
+    MessageHandle SequencedCycler::postAtTime(Message* msg, nsp at_time) {
+        msg->time_ns = at_time.count();
+        msg->target = nullptr;
+
+        // 必须在入队前获取，入队后消息随时可能被执行并回收。
+        auto handle = msg->getHandle(state_.get());
+
+        bool need_drain = false;
+        {
+            std::lock_guard<std::mutex> lk(state_->sync);
+            if (at_time <= now()) {
+                state_->append(msg);
+                if (!state_->running) {
+                    state_->running = true;
+                    need_drain = true;
+                }
+            } else {
+                state_->timers.push(msg);
+                if (int64_t(msg->time_ns) < state_->scheduled_due) {
+                    armTimer(state_, int64_t(msg->time_ns));
+                }
+            }
+        }
+
+        if (need_drain) {
+            scheduleDrain(state_);
+        }
+        return handle;
+    }
+
+    void SequencedCycler::clear() {
+        std::lock_guard<std::mutex> lk(state_->sync);
+        state_->resetAll();
+        armTimer(state_, kNoDeadline);
+    }
+
+    bool SequencedCycler::hasMessages(int id) {
+        std::lock_guard<std::mutex> lk(state_->sync);
+        for (auto it = state_->head; it; it = it->next) {
+            if (it->id == id && !it->isCancelled()) {
+                return true;
+            }
+        }
+        return state_->timers.contains(
+            [id](const Message& m) { return m.id == id && !m.isCancelled(); });
+    }
+
+    void SequencedCycler::removeMessages(int id) {
+        std::lock_guard<std::mutex> lk(state_->sync);
+
+        Message* prev = nullptr;
+        auto msg = state_->head;
+        while (msg) {
+            auto next = msg->next;
+            if (msg->id == id) {
+                if (prev) {
+                    prev->next = next;
+                } else {
+                    state_->head = next;
+                }
+                if (state_->tail == msg) {
+                    state_->tail = prev;
+                }
+                state_->recycle(msg);
+            } else {
+                prev = msg;
+            }
+            msg = next;
+        }
+
+        msg = state_->timers.extract([id](const Message& m) { return m.id == id; });
+        while (msg) {
+            auto next = msg->next;
+            state_->recycle(msg);
+            msg = next;
+        }
+    }
+
+    bool SequencedCycler::hasMessage(const MessageHandle& h) const {
+        return Message::isPending(h);
+    }
+
+    bool SequencedCycler::removeMessage(const MessageHandle& h) {
+        if (h.owner_ != state_.get()) {
+            return false;
+        }
+
+        // 回调和数据移到锁外析构，其中可能会再向本序列投递消息。
+        Closure func;
+        std::shared_ptr<void> data;
+        {
+            std::lock_guard<std::mutex> lk(state_->sync);
+            if (!Message::cancel(h)) {
+                return false;
+            }
+
+            // drain() 在锁内认领消息，因此取消成功时消息一定还在本序列的队列中。
+            // 消息本身留在队列中，轮到它或被批量清理时回收。
+            auto msg = h.msg_;
+            func = std::move(msg->func);
+            data = std::move(msg->shared_data);
+            msg->releasePayload();
+            ++state_->cancelled;
+            state_->purgeCancelled();
+        }
+        return true;
+    }
+
+    bool SequencedCycler::isCurrent() const {
+        return cur_state_ == state_.get();
+    }
+
+    // static
+    SequencedCycler::ns SequencedCycler::now() {
+        return TimeUtils::upTime();
+    }
+
+    // static
+    void SequencedCycler::drain(const std::shared_ptr<State>& state) {
+        auto prev_state = cur_state_;
+        cur_state_ = state.get();
+
+        for (int i = 0; i < kDrainBatch; ++i) {
+            Message* msg;
+            CyclerListener* listener;
+            {
+                std::lock_guard<std::mutex> lk(state->sync);
+                msg = state->head;
+                if (!msg) {
+                    state->running = false;
+                    cur_state_ = prev_state;
+                    return;
+                }
+
+                state->head = msg->next;
+                if (!state->head) {
+                    state->tail = nullptr;
+                }
+                msg->next = nullptr;
+                listener = state->listener;
+
+                // 在锁内认领，之后的 removeMessage() 都会失败。
+                if (!msg->claim()) {
+                    state->recycle(msg);
+                    continue;
+                }
+            }
+
+            if (msg->callback) {
+                msg->callback->onExecTask(*msg);
+            } else if (msg->func) {
+                msg->func();
+            } else if (listener) {
+                listener->onHandleMessage(*msg);
+            }
+            msg->reset();
+        }
+
+        cur_state_ = prev_state;
+
+        // 还有消息，重新排队以便让出工作线程。running 保持为 true。
+        bool has_more;
+        {
+            std::lock_guard<std::mutex> lk(state->sync);
+            has_more = !!state->head;
+            if (!has_more) {
+                state->running = false;
+            }
+        }
+        if (has_more) {
+            scheduleDrain(state);
+        }
+    }
+
+    // static
+    void SequencedCycler::fireTimers(const std::shared_ptr<State>& state, int64_t due) {
+        bool need_drain = false;
+        {
+            std::lock_guard<std::mutex> lk(state->sync);
+
+            // 已被更早的定时任务取代，或序列已被清空。
+            // 取代它时的取消可能因其已开始执行而失败，这里直接返回即可。
+            if (due != state->scheduled_due) {
+                return;
+            }
+
+            // 按到期顺序并入即时队列
+            auto cur = now().count();
+            auto top = state->topTimer();
+            while (top && top->time_ns <= uint64_t(cur)) {
+                state->timers.pop();
+                state->append(top);
+                top = state->topTimer();
+            }
+
+            if (state->head && !state->running) {
+                state->running = true;
+                need_drain = true;
+            }
+
+            armTimer(state, top ? int64_t(top->time_ns) : kNoDeadline);
+        }
+
+        if (need_drain) {
+            scheduleDrain(state);
+        }
+    }
+
+    // static
+    void SequencedCycler::scheduleDrain(const std::shared_ptr<State>& state) {
+        state->pool->post([state]() { drain(state); });
+    }
+
+    // static
+    void SequencedCycler::armTimer(const std::shared_ptr<State>& state, int64_t due) {
+        // 取消之前的定时任务，否则每个被取代的任务到期后都会再排一次，唤醒次数随延时消息的数量平方增长。
+        if (!state->timer.isNull()) {
+            state->pool->removeMessage(state->timer);
+            state->timer = MessageHandle();
+        }
+
+        state->scheduled_due = due;
+        if (due != kNoDeadline) {
+            state->timer = state->pool->postAtTime(
+                [state, due]() { fireTimers(state, due); }, ns(due));
+        }
+    }
+
+}
@@ -0,0 +1,113 @@
+// Copyright (c) 2016 ucclkp <ucclkp@gmail.com>.
+// This file is part of utils project.
+//
+// This program is licensed under GPLv3 license that can be
+// found in the LICENSE file.
+
+#ifndef UTILS_MESSAGE_SEQUENCED_CYCLER_H_
+#define UTILS_MESSAGE_SEQUENCED_CYCLER_H_
+
+#include <memory>
+
+#include "utils/message/message.h"
+#include "utils/time_utils.h"
+
+
+namespace utl {
+
+    class CyclerListener;
+    class Executable;
+    class ThreadPool;
+
+    /**
+     * 运行在 ThreadPool 上的“逻辑线程”。
+     * 投递方法与 Cycler 相同，并提供相同的顺序保证：即时消息先进先出，
+     * 延时消息按到期时间执行，时间相同的按投递顺序执行；同一个 SequencedCycler 的消息
+     * 不会同时执行，但可能先后在不同的工作线程中执行。
+     * 每个 SequencedCycler 只占用一个小的共享状态，没有独立的线程，可以大量创建。
+     * 析构时会移除所有未执行的消息，但不会等待正在其他线程中执行的消息。
+     * 线程池必须比 SequencedCycler 存在得更久。
+     */
+    class SequencedCycler {
+    public:
+        using ns = TimeUtils::ns;
+        using nsp = TimeUtils::nsp;
+
+        explicit SequencedCycler(ThreadPool* pool);
+        ~SequencedCycler();
+
+        SequencedCycler(const SequencedCycler&) = delete;
+        SequencedCycler& operator=(const SequencedCycler&) = delete;
+
+        /**
+         * 只有 id 的消息会交给 listener 处理。
+         */
+        void setListener(CyclerListener* l);
+
+        MessageHandle post(Executable* exec, int id = -1);
+        MessageHandle postDelayed(Executable* exec, nsp delay, int id = -1);
+        MessageHandle postAtTime(Executable* exec, nsp at_time, int id = -1);
+
+        template <typename F, typename = Closure::EnableIfCallable<F>>
+        MessageHandle post(F&& func, int id = -1) {
+            return postDelayed(std::forward<F>(func), ns(0), id);
+        }
+
+        template <typename F, typename = Closure::EnableIfCallable<F>>
+        MessageHandle postDelayed(F&& func, nsp delay, int id = -1) {
+            return postAtTime(std::forward<F>(func), delay + now(), id);
+        }
+
+        template <typename F, typename = Closure::EnableIfCallable<F>>
+        MessageHandle postAtTime(F&& func, nsp at_time, int id = -1) {
+            Message* msg = Message::get();
+            msg->func.emplace(std::forward<F>(func));
+            msg->id = id;
+
+            return postAtTime(msg, at_time);
+        }
+
+        MessageHandle post(Message* msg);
+        MessageHandle postDelayed(Message* msg, nsp delay);
+        MessageHandle postAtTime(Message* msg, nsp at_time);
+
+        MessageHandle post(int id);
+        MessageHandle postDelayed(int id, nsp delay);
+        MessageHandle postAtTime(int id, nsp at_time);
+
+        void clear();
+
+        bool hasMessages(int id);
+        void removeMessages(int id);
+
+        bool hasMessage(const MessageHandle& h) const;
+        bool removeMessage(const MessageHandle& h);
+
+        /**
+         * 判断当前线程是否正在执行本 SequencedCycler 的消息。
+         */
+        bool isCurrent() const;
+
+        static ns now();
+
+    private:
+        struct State;
+
+        static void drain(const std::shared_ptr<State>& state);
+        static void fireTimers(const std::shared_ptr<State>& state, int64_t due);
+        static void scheduleDrain(const std::shared_ptr<State>& state);
+
+        /**
+         * 取消已投递给线程池的定时任务，按 due 重新投递。due 为 INT64_MAX 时不再投递。
+         * 调用前必须持有 state->sync。
+         */
+        static void armTimer(const std::shared_ptr<State>& state, int64_t due);
+
+        std::shared_ptr<State> state_;
+
+        static thread_local const State* cur_state_;
+    };
+
+}
+
+#endif  // UTILS_MESSAGE_SEQUENCED_CYCLER_H_
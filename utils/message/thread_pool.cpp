@@ -0,0 +1,489 @@
+// Copyright (c) 2016 ucclkp <ucclkp@gmail.com>.
+// This file is part of utils project.
+//
+// This program is licensed under GPLv3 license that can be
+// found in the LICENSE file.
+
+#include "utils/message/thread_pool.h"
+
+#include <limits>
+
+#include "utils/log.h"
+#include "utils/message/executable.h"
+#include "utils/message/timer_queue.h"
+
+
+namespace {
+
+    // 从注入队列中一次最多取出的消息数量，多出的部分放入自己的队列以供窃取。
+    constexpr size_t kInjectBatch = 32;
+
+    constexpr int64_t kNoDeadline = std::numeric_limits<int64_t>::max();
+
+}
+
+namespace utl {
+
+    thread_local ThreadPool* ThreadPool::cur_pool_ = nullptr;
+    thread_local size_t ThreadPool::cur_index_ = 0;
+
+    ThreadPool::ThreadPool(size_t thread_count)
+        : ThreadPool(thread_count, ThreadOptions()) {}
+
+    ThreadPool::ThreadPool(size_t thread_count, const ThreadOptions& options)
+        : options_(options),
+          injected_head_(nullptr),
+          injected_tail_(nullptr),
+          injected_count_(0),
+          timers_(new TimerQuaternaryHeap()),
+          cancelled_(0),
+          next_due_(kNoDeadline),
+          sleepers_(0),
+          stopping_(false),
+          stopped_(false)
+    {
+        if (thread_count == 0) {
+            thread_count = std::thread::hardware_concurrency();
+            if (thread_count == 0) {
+                thread_count = 1;
+            }
+        }
+
+        for (size_t i = 0; i < thread_count; ++i) {
+            auto worker = new Worker();
+            worker->rand_state = 0x9E3779B97F4A7C15ull * (i + 1);
+            workers_.push_back(worker);
+        }
+
+        // 所有 Worker 创建完毕后再启动线程，线程中会访问 workers_。
+        for (size_t i = 0; i < thread_count; ++i) {
+            workers_[i]->thread = std::thread(&ThreadPool::run, this, i);
+        }
+    }
+
+    ThreadPool::~ThreadPool() {
+        shutdown();
+
+        for (auto worker : workers_) {
+            delete worker;
+        }
+        delete timers_;
+    }
+
+    MessageHandle ThreadPool::post(Executable* exec, int id) {
+        return postDelayed(exec, ns(0), id);
+    }
+
+    MessageHandle ThreadPool::postDelayed(Executable* exec, nsp delay, int id) {
+        return postAtTime(exec, delay + now(), id);
+    }
+
+    MessageHandle ThreadPool::postAtTime(Executable* exec, nsp at_time, int id) {
+        Message* msg = Message::get();
+        msg->callback = exec;
+        msg->id = id;
+
+        return postAtTime(msg, at_time);
+    }
+
+    MessageHandle ThreadPool::post(Message* msg) {
+        return postDelayed(msg, ns(0));
+    }
+
+    MessageHandle ThreadPool::postDelayed(Message* msg, nsp delay) {
+        return postAtTime(msg, delay + now());
+    }
+
+    MessageHandle ThreadPool::postAtTime(Message* msg, nsp at_time) {
+        msg->time_ns = at_time.count();
+
+        // 必须在入队前获取，入队后消息随时可能被执行并回收。
+        auto handle = msg->getHandle(this);
+
+        // 停止过程中，工作线程自己投递的消息仍然接受，它们会在线程退出前执行。
+        if (stopped_.load(std::memory_order_acquire) && cur_pool_ != this) {
+            msg->reset();
+            return handle;
+        }
+
+        if (at_time <= now()) {
+            // 不经过延时结构，之后由取到它的工作线程回收。
+            msg->setInBatch(true);
+            enqueue(msg);
+            return handle;
+        }
+
+        bool earliest = false;
+        {
+            std::lock_guard<std::mutex> lk(timer_sync_);
+            timers_->push(msg);
+            if (int64_t(msg->time_ns) < next_due_.load(std::memory_order_relaxed)) {
+                next_due_.store(int64_t(msg->time_ns), std::memory_order_release);
+                earliest = true;
+            }
+        }
+
+        // 让一个休眠的线程按新的到期时间重新等待
+        if (earliest) {
+            wakeupOne();
+        }
+        return handle;
+    }
+
+    bool ThreadPool::hasMessage(const MessageHandle& h) const {
+        return Message::isPending(h);
+    }
+
+    bool ThreadPool::removeMessage(const MessageHandle& h) {
+        // 其他对象投递的消息可能在某个泵的队列中，由其自己持锁取消。
+        if (h.owner_ != this) {
+            return false;
+        }
+
+        // 回调和数据移到锁外析构，其中可能会再向本线程池投递消息。
+        Closure func;
+        std::shared_ptr<void> data;
+        {
+            std::lock_guard<std::mutex> lk(timer_sync_);
+            if (!Message::cancel(h)) {
+                return false;
+            }
+
+            auto msg = h.msg_;
+            if (!msg->isInBatch()) {
+                // 仍在延时结构中，只有持有 timer_sync_ 时才会被取出。
+                func = std::move(msg->func);
+                data = std::move(msg->shared_data);
+                msg->releasePayload();
+                ++cancelled_;
+                purgeCancelled();
+            }
+        }
+        return true;
+    }
+
+    void ThreadPool::shutdown() {
+        // 先检查，以免在工作线程中把线程池标记为已停止，析构时却不再等待线程结束。
+        if (isWorkerThread()) {
+            LOG(Log::ERR) << "ThreadPool cannot be shut down from its own worker!";
+            ubassert(false);
+            return;
+        }
+        if (stopped_.exchange(true, std::memory_order_acq_rel)) {
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lk(sleep_sync_);
+            stopping_ = true;
+        }
+        sleep_cv_.notify_all();
+
+        for (auto worker : workers_) {
+            if (worker->thread.joinable()) {
+                worker->thread.join();
+            }
+        }
+
+        // 丢弃剩下的消息
+        for (auto worker : workers_) {
+            Message* msg;
+            while (worker->deque.take(&msg)) {
+                msg->reset();
+            }
+        }
+        while (auto msg = takeInjected()) {
+            msg->reset();
+        }
+
+        std::lock_guard<std::mutex> lk(timer_sync_);
+        auto msg = timers_->extract([](const Message&) { return true; });
+        while (msg) {
+            auto next = msg->next;
+            msg->reset();
+            msg = next;
+        }
+        cancelled_ = 0;
+        next_due_.store(kNoDeadline, std::memory_order_relaxed);
+    }
+
+    size_t ThreadPool::getThreadCount() const {
+        return workers_.size();
+    }
+
+    bool ThreadPool::isWorkerThread() const {
+        return cur_pool_ == this;
+    }
+
+    // static
+    ThreadPool::ns ThreadPool::now() {
+        return TimeUtils::upTime();
+    }
+
+    void ThreadPool::run(size_t index) {
+        cur_pool_ = this;
+        cur_index_ = index;
+
+        if (!options_.name.empty() || !options_.cpus.empty()) {
+            auto options = options_;
+            if (!options.name.empty()) {
+                options.name += "-" + std::to_string(index);
+            }
+            ThreadUtils::applyToCurrentThread(options);
+            Message::prefillLocalCache();
+        }
+
+        for (;;) {
+            auto msg = findWork(index);
+            if (msg) {
+                execute(msg);
+                continue;
+            }
+
+            if (!waitForWork()) {
+                break;
+            }
+        }
+
+        cur_pool_ = nullptr;
+    }
+
+    void ThreadPool::execute(Message* msg) {
+        if (!msg->claim()) {
+            // 已被取消
+            msg->reset();
+            return;
+        }
+
+        if (msg->callback) {
+            msg->callback->onExecTask(*msg);
+        } else if (msg->func) {
+            msg->func();
+        }
+
+        msg->reset();
+    }
+
+    void ThreadPool::enqueue(Message* msg) {
+        if (cur_pool_ == this) {
+            workers_[cur_index_]->deque.push(msg);
+        } else {
+            std::lock_guard<std::mutex> lk(inject_sync_);
+            msg->next = nullptr;
+            if (injected_tail_) {
+                injected_tail_->next = msg;
+            } else {
+                injected_head_ = msg;
+            }
+            injected_tail_ = msg;
+            injected_count_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        wakeupOne();
+    }
+
+    void ThreadPool::wakeupOne() {
+        // 与 waitForWork() 中的栅栏配对：要么这里看到休眠者，要么休眠者看到新消息。
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleepers_.load(std::memory_order_relaxed) == 0) {
+            return;
+        }
+
+        // 持锁后再通知，保证休眠者已经进入等待，不会错过通知。
+        {
+            std::lock_guard<std::mutex> lk(sleep_sync_);
+        }
+        sleep_cv_.notify_one();
+    }
+
+    Message* ThreadPool::findWork(size_t index) {
+        Message* msg;
+        if (workers_[index]->deque.take(&msg)) {
+            return msg;
+        }
+        if ((msg = fireTimers(index))) {
+            return msg;
+        }
+        if ((msg = takeInjected())) {
+            return msg;
+        }
+        return stealFrom(index);
+    }
+
+    Message* ThreadPool::takeInjected() {
+        if (injected_count_.load(std::memory_order_relaxed) == 0) {
+            return nullptr;
+        }
+
+        Message* first;
+        bool has_more = false;
+        {
+            std::lock_guard<std::mutex> lk(inject_sync_);
+            first = injected_head_;
+            if (!first) {
+                return nullptr;
+            }
+
+            auto msg = first->next;
+            size_t taken = 1;
+            if (cur_pool_ == this) {
+                auto& deque = workers_[cur_index_]->deque;
+                for (; msg && taken < kInjectBatch; ++taken) {
+                    auto next = msg->next;
+                    msg->next = nullptr;
+                    deque.push(msg);
+                    msg = next;
+                }
+                has_more = taken > 1;
+            }
+
+            injected_head_ = msg;
+            if (!msg) {
+                injected_tail_ = nullptr;
+            }
+            injected_count_.fetch_sub(taken, std::memory_order_relaxed);
+        }
+
+        first->next = nullptr;
+        if (has_more) {
+            wakeupOne();
+        }
+        return first;
+    }
+
+    Message* ThreadPool::fireTimers(size_t index) {
+        auto due = next_due_.load(std::memory_order_acquire);
+        if (due == kNoDeadline) {
+            return nullptr;
+        }
+
+        auto cur = now().count();
+        if (due > cur) {
+            return nullptr;
+        }
+
+        // 已有其他线程在处理到期消息
+        std::unique_lock<std::mutex> lk(timer_sync_, std::try_to_lock);
+        if (!lk.owns_lock()) {
+            return nullptr;
+        }
+
+        Message* first = nullptr;
+        bool has_more = false;
+        auto top = topTimer();
+        while (top && top->time_ns <= uint64_t(cur)) {
+            timers_->pop();
+            top->setInBatch(true);
+            if (first) {
+                workers_[index]->deque.push(top);
+                has_more = true;
+            } else {
+                first = top;
+            }
+            top = topTimer();
+        }
+        next_due_.store(
+            top ? int64_t(top->time_ns) : kNoDeadline, std::memory_order_release);
+        lk.unlock();
+
+        if (has_more) {
+            wakeupOne();
+        }
+        return first;
+    }
+
+    Message* ThreadPool::topTimer() {
+        auto top = timers_->top();
+        while (top && top->isCancelled()) {
+            timers_->pop();
+            --cancelled_;
+            top->reset();
+            top = timers_->top();
+        }
+        return top;
+    }
+
+    void ThreadPool::purgeCancelled() {
+        // 与 MessageQueue 相同，只在已取消的消息占到一半以上时才清理，使开销均摊到取消操作上。
+        if (cancelled_ < 64 || cancelled_ * 2 < timers_->size()) {
+            return;
+        }
+
+        auto msg = timers_->extract([](const Message& m) { return m.isCancelled(); });
+        while (msg) {
+            auto next = msg->next;
+            msg->reset();
+            msg = next;
+        }
+        cancelled_ = 0;
+
+        auto top = timers_->top();
+        next_due_.store(
+            top ? int64_t(top->time_ns) : kNoDeadline, std::memory_order_release);
+    }
+
+    Message* ThreadPool::stealFrom(size_t index) {
+        auto count = workers_.size();
+        if (count < 2) {
+            return nullptr;
+        }
+
+        // xorshift64，从随机的位置开始，避免所有窃取者都盯着同一个线程。
+        auto& state = workers_[index]->rand_state;
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        auto start = size_t(state % count);
+
+        Message* msg;
+        for (size_t i = 0; i < count; ++i) {
+            auto victim = (start + i) % count;
+            if (victim == index) {
+                continue;
+            }
+            if (workers_[victim]->deque.steal(&msg)) {
+                return msg;
+            }
+        }
+        return nullptr;
+    }
+
+    bool ThreadPool::hasWork() {
+        if (injected_count_.load(std::memory_order_relaxed) > 0) {
+            return true;
+        }
+        for (auto worker : workers_) {
+            if (!worker->deque.empty()) {
+                return true;
+            }
+        }
+        return next_due_.load(std::memory_order_relaxed) <= now().count();
+    }
+
+    bool ThreadPool::waitForWork() {
+        std::unique_lock<std::mutex> lk(sleep_sync_);
+        sleepers_.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        bool result = true;
+        if (!hasWork()) {
+            if (stopping_) {
+                result = false;
+            } else {
+                auto due = next_due_.load(std::memory_order_acquire);
+                if (due == kNoDeadline) {
+                    sleep_cv_.wait(lk);
+                } else {
+                    auto delay = due - now().count();
+                    if (delay > 0) {
+                        sleep_cv_.wait_for(lk, ns(delay));
+                    }
+                }
+            }
+        }
+
+        sleepers_.fetch_sub(1, std::memory_order_relaxed);
+        return result;
+    }
+
+}
@@ -0,0 +1,175 @@
+// Copyright (c) 2016 ucclkp <ucclkp@gmail.com>.
+// This file is part of utils project.
+//
+// This program is licensed under GPLv3 license that can be
+// found in the LICENSE file.
+
+#ifndef UTILS_MESSAGE_THREAD_POOL_H_
+#define UTILS_MESSAGE_THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "utils/message/message.h"
+#include "utils/message/work_stealing_deque.hpp"
+#include "utils/thread_utils.h"
+#include "utils/time_utils.h"
+
+
+namespace utl {
+
+    class Executable;
+    class TimerQueue;
+
+    /**
+     * 工作窃取线程池。
+     * 每个工作线程持有一个 Chase-Lev 双端队列，工作线程中投递的消息直接放入自己的队列，
+     * 其他线程投递的消息放入公共的注入队列。工作线程空闲时依次从自己的队列、
+     * 到期的延时消息、注入队列中取消息，都没有时从其他工作线程的队列中窃取。
+     * 消息之间没有顺序保证。
+     * 投递方法与 Cycler 相同，但由于没有 CyclerListener，不支持只有 id 的消息。
+     */
+    class ThreadPool {
+    public:
+        using ns = TimeUtils::ns;
+        using nsp = TimeUtils::nsp;
+
+        /**
+         * @param thread_count 工作线程数量，为 0 时使用硬件线程数量。
+         */
+        explicit ThreadPool(size_t thread_count = 0);
+
+        /**
+         * 每个工作线程启动时先应用 options，并预先填充本线程的消息缓存。
+         * 线程名称后会加上 "-序号"，所有线程共用 options.cpus 中的 CPU。
+         */
+        ThreadPool(size_t thread_count, const ThreadOptions& options);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        MessageHandle post(Executable* exec, int id = -1);
+        MessageHandle postDelayed(Executable* exec, nsp delay, int id = -1);
+        MessageHandle postAtTime(Executable* exec, nsp at_time, int id = -1);
+
+        template <typename F, typename = Closure::EnableIfCallable<F>>
+        MessageHandle post(F&& func, int id = -1) {
+            return postDelayed(std::forward<F>(func), ns(0), id);
+        }
+
+        template <typename F, typename = Closure::EnableIfCallable<F>>
+        MessageHandle postDelayed(F&& func, nsp delay, int id = -1) {
+            return postAtTime(std::forward<F>(func), delay + now(), id);
+        }
+
+        template <typename F, typename = Closure::EnableIfCallable<F>>
+        MessageHandle postAtTime(F&& func, nsp at_time, int id = -1) {
+            Message* msg = Message::get();
+            msg->func.emplace(std::forward<F>(func));
+            msg->id = id;
+
+            return postAtTime(msg, at_time);
+        }
+
+        MessageHandle post(Message* msg);
+        MessageHandle postDelayed(Message* msg, nsp delay);
+        MessageHandle postAtTime(Message* msg, nsp at_time);
+
+        /**
+         * 判断句柄所指的消息是否仍在等待执行。O(1)。
+         */
+        bool hasMessage(const MessageHandle& h) const;
+
+        /**
+         * 取消句柄所指的消息。O(1)。
+         * 未到期的延时消息会立即释放其持有的回调和数据，消息本身留在延时结构中，
+         * 到期或被批量清理时回收；其他消息留在队列中，直到被工作线程取到时才回收。
+         * @return 如果消息由本线程池投递、仍在等待执行且成功取消，返回 true。
+         */
+        bool removeMessage(const MessageHandle& h);
+
+        /**
+         * 停止线程池并等待所有工作线程退出。
+         * 已到期的消息会在退出前执行完，未到期的延时消息则被丢弃。
+         * 之后投递的消息会被直接丢弃。析构时会自动调用。
+         */
+        void shutdown();
+
+        size_t getThreadCount() const;
+
+        /**
+         * 判断当前线程是否为本线程池的工作线程。
+         */
+        bool isWorkerThread() const;
+
+        static ns now();
+
+    private:
+        struct Worker {
+            WorkStealingDeque<Message*> deque;
+            std::thread thread;
+            uint64_t rand_state;
+        };
+
+        void run(size_t index);
+        void execute(Message* msg);
+        void enqueue(Message* msg);
+        void wakeupOne();
+
+        Message* findWork(size_t index);
+        Message* takeInjected();
+        Message* fireTimers(size_t index);
+
+        /**
+         * 获取最早到期且未被取消的延时消息，途经的已取消消息会被回收。
+         * 调用前必须持有 timer_sync_。
+         */
+        Message* topTimer();
+
+        /**
+         * 已取消的延时消息过多时，一次性清理掉它们。调用前必须持有 timer_sync_。
+         */
+        void purgeCancelled();
+        Message* stealFrom(size_t index);
+        bool hasWork();
+
+        /**
+         * 没有可做的事时休眠，直到有新的消息或最近的延时消息到期。
+         * @return 线程池已停止且没有已到期的消息时，返回 false。
+         */
+        bool waitForWork();
+
+        std::vector<Worker*> workers_;
+        ThreadOptions options_;
+
+        // 非工作线程投递的消息
+        Message* injected_head_;
+        Message* injected_tail_;
+        std::atomic<size_t> injected_count_;
+        std::mutex inject_sync_;
+
+        // 延时消息。已离开该结构的消息标记为 Message::isInBatch()，取消时不能再释放其资源。
+        TimerQueue* timers_;
+        // 已取消但仍留在 timers_ 中的消息数量
+        size_t cancelled_;
+        // 最早的延时消息的到期时间，没有时为 INT64_MAX
+        std::atomic<int64_t> next_due_;
+        std::mutex timer_sync_;
+
+        std::atomic<size_t> sleepers_;
+        bool stopping_;
+        std::atomic_bool stopped_;
+        std::condition_variable sleep_cv_;
+        std::mutex sleep_sync_;
+
+        static thread_local ThreadPool* cur_pool_;
+        static thread_local size_t cur_index_;
+    };
+
+}
+
+#endif  // UTILS_MESSAGE_THREAD_POOL_H_
@@ -0,0 +1,487 @@
+// Copyright (c) 2016 ucclkp <ucclkp@gmail.com>.
+// This file is part of utils project.
+//
+// This program is licensed under GPLv3 license that can be
+// found in the LICENSE file.
+
+#include "utils/message/timer_queue.h"
+
+#include <algorithm>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "utils/log.h"
+#include "utils/message/message.h"
+
+
+namespace {
+
+    unsigned highestBit(uint64_t val) {
+#if defined(_MSC_VER) && defined(_WIN64)
+        unsigned long r;
+        _BitScanReverse64(&r, val);
+        return unsigned(r);
+#elif defined(_MSC_VER)
+        unsigned long r;
+        if (_BitScanReverse(&r, static_cast<unsigned long>(val >> 32))) {
+            return unsigned(r) + 32;
+        }
+        _BitScanReverse(&r, static_cast<unsigned long>(val));
+        return unsigned(r);
+#else
+        return 63u - unsigned(__builtin_clzll(val));
+#endif
+    }
+
+    unsigned lowestBit(uint64_t val) {
+#if defined(_MSC_VER) && defined(_WIN64)
+        unsigned long r;
+        _BitScanForward64(&r, val);
+        return unsigned(r);
+#elif defined(_MSC_VER)
+        unsigned long r;
+        if (_BitScanForward(&r, static_cast<unsigned long>(val))) {
+            return unsigned(r);
+        }
+        _BitScanForward(&r, static_cast<unsigned long>(val >> 32));
+        return unsigned(r) + 32;
+#else
+        return unsigned(__builtin_ctzll(val));
+#endif
+    }
+
+}
+
+namespace utl {
+
+    // TimerList
+    TimerList::~TimerList() {
+        while (head_) {
+            auto tmp = head_;
+            head_ = head_->next;
+            tmp->reset();
+        }
+    }
+
+    void TimerList::push(Message* msg) {
+        auto ptr = head_;
+
+        if (!ptr || msg->time_ns < ptr->time_ns) {
+            // push_front
+            msg->next = head_;
+            head_ = msg;
+        } else {
+            decltype(ptr) prev;
+            for (;;) {
+                prev = ptr;
+                ptr = ptr->next;
+                if (!ptr || msg->time_ns < ptr->time_ns) {
+                    break;
+                }
+            }
+
+            // insert_after prev
+            msg->next = prev->next;
+            prev->next = msg;
+        }
+        ++size_;
+    }
+
+    Message* TimerList::top() {
+        return head_;
+    }
+
+    void TimerList::pop() {
+        if (head_) {
+            // pop_front
+            auto msg = head_;
+            head_ = msg->next;
+            msg->next = nullptr;
+            --size_;
+        }
+    }
+
+    bool TimerList::empty() const {
+        return !head_;
+    }
+
+    size_t TimerList::size() const {
+        return size_;
+    }
+
+    Message* TimerList::extract(const Predicate& pred) {
+        Message* out = nullptr;
+        Message** out_tail = &out;
+
+        auto ptr = head_;
+        decltype(ptr) prev = nullptr;
+        for (; ptr; ) {
+            if (pred(*ptr)) {
+                auto next = ptr->next;
+                if (prev) {
+                    // erase_after prev
+                    prev->next = next;
+                } else {
+                    // pop_front
+                    head_ = next;
+                }
+
+                ptr->next = nullptr;
+                *out_tail = ptr;
+                out_tail = &ptr->next;
+                --size_;
+
+                ptr = next;
+                continue;
+            }
+
+            prev = ptr;
+            ptr = ptr->next;
+        }
+        return out;
+    }
+
+    bool TimerList::contains(const Predicate& pred) const {
+        for (auto it = head_; it; it = it->next) {
+            if (pred(*it)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+
+    // TimerHeap
+    template <size_t Arity>
+    TimerHeap<Arity>::~TimerHeap() {
+        for (auto& e : heap_) {
+            e.msg->reset();
+        }
+    }
+
+    template <size_t Arity>
+    void TimerHeap<Arity>::push(Message* msg) {
+        msg->next = nullptr;
+        heap_.push_back({ msg->time_ns, seq_++, msg });
+        siftUp(heap_.size() - 1);
+    }
+
+    template <size_t Arity>
+    Message* TimerHeap<Arity>::top() {
+        return heap_.empty() ? nullptr : heap_.front().msg;
+    }
+
+    template <size_t Arity>
+    void TimerHeap<Arity>::pop() {
+        if (heap_.empty()) {
+            return;
+        }
+
+        heap_.front() = heap_.back();
+        heap_.pop_back();
+        if (!heap_.empty()) {
+            siftDown(0);
+        }
+    }
+
+    template <size_t Arity>
+    bool TimerHeap<Arity>::empty() const {
+        return heap_.empty();
+    }
+
+    template <size_t Arity>
+    size_t TimerHeap<Arity>::size() const {
+        return heap_.size();
+    }
+
+    template <size_t Arity>
+    Message* TimerHeap<Arity>::extract(const Predicate& pred) {
+        Message* out = nullptr;
+        Message** out_tail = &out;
+
+        auto it = std::remove_if(
+            heap_.begin(), heap_.end(),
+            [&](const Entry& e) {
+                if (!pred(*e.msg)) {
+                    return false;
+                }
+                e.msg->next = nullptr;
+                *out_tail = e.msg;
+                out_tail = &e.msg->next;
+                return true;
+            });
+        if (it == heap_.end()) {
+            return nullptr;
+        }
+
+        heap_.erase(it, heap_.end());
+        for (size_t i = heap_.size() / Arity + 1; i-- > 0; ) {
+            if (i < heap_.size()) {
+                siftDown(i);
+            }
+        }
+        return out;
+    }
+
+    template <size_t Arity>
+    bool TimerHeap<Arity>::contains(const Predicate& pred) const {
+        for (auto& e : heap_) {
+            if (pred(*e.msg)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    template <size_t Arity>
+    void TimerHeap<Arity>::siftUp(size_t i) {
+        auto e = heap_[i];
+        while (i > 0) {
+            size_t parent = (i - 1) / Arity;
+            if (!(e < heap_[parent])) {
+                break;
+            }
+            heap_[i] = heap_[parent];
+            i = parent;
+        }
+        heap_[i] = e;
+    }
+
+    template <size_t Arity>
+    void TimerHeap<Arity>::siftDown(size_t i) {
+        auto e = heap_[i];
+        size_t count = heap_.size();
+        for (;;) {
+            size_t first = i * Arity + 1;
+            if (first >= count) {
+                break;
+            }
+
+            size_t last = (std::min)(first + Arity, count);
+            size_t min_child = first;
+            for (size_t c = first + 1; c < last; ++c) {
+                if (heap_[c] < heap_[min_child]) {
+                    min_child = c;
+                }
+            }
+
+            if (!(heap_[min_child] < e)) {
+                break;
+            }
+            heap_[i] = heap_[min_child];
+            i = min_child;
+        }
+        heap_[i] = e;
+    }
+
+    template class TimerHeap<2>;
+    template class TimerHeap<4>;
+
+
+    // TimerWheel
+    TimerWheel::TimerWheel(uint64_t tick_ns)
+        : tick_ns_(tick_ns)
+    {
+        ubassert(tick_ns_ > 0);
+        if (tick_ns_ == 0) {
+            tick_ns_ = 1;
+        }
+    }
+
+    TimerWheel::~TimerWheel() {
+        for (auto& level : slots_) {
+            for (auto& slot : level) {
+                for (auto& e : slot) {
+                    e.msg->reset();
+                }
+            }
+        }
+        for (auto& e : due_) {
+            e.msg->reset();
+        }
+    }
+
+    void TimerWheel::push(Message* msg) {
+        msg->next = nullptr;
+
+        uint64_t tick = msg->time_ns / tick_ns_;
+        if (size_ == 0) {
+            // 时间轮为空时可以直接把当前位置移动过去，省去逐层展开。
+            cur_tick_ = tick;
+        }
+
+        place({ msg->time_ns, seq_++, msg });
+        ++size_;
+    }
+
+    Message* TimerWheel::top() {
+        settle();
+        return due_.empty() ? nullptr : due_.front().msg;
+    }
+
+    void TimerWheel::pop() {
+        settle();
+        if (due_.empty()) {
+            return;
+        }
+
+        std::pop_heap(due_.begin(), due_.end(), std::greater<Entry>());
+        due_.pop_back();
+        --size_;
+    }
+
+    bool TimerWheel::empty() const {
+        return size_ == 0;
+    }
+
+    size_t TimerWheel::size() const {
+        return size_;
+    }
+
+    Message* TimerWheel::extract(const Predicate& pred) {
+        Message* out = nullptr;
+        Message** out_tail = &out;
+
+        auto filter = [&](std::vector<Entry>& entries) {
+            auto it = std::remove_if(
+                entries.begin(), entries.end(),
+                [&](const Entry& e) {
+                    if (!pred(*e.msg)) {
+                        return false;
+                    }
+                    e.msg->next = nullptr;
+                    *out_tail = e.msg;
+                    out_tail = &e.msg->next;
+                    return true;
+                });
+            size_ -= size_t(entries.end() - it);
+            entries.erase(it, entries.end());
+        };
+
+        for (unsigned k = 0; k < kLevelCount; ++k) {
+            for (auto bits = occupied_[k]; bits; bits &= bits - 1) {
+                auto idx = lowestBit(bits);
+                auto& slot = slots_[k][idx];
+                filter(slot);
+                if (slot.empty()) {
+                    occupied_[k] &= ~(uint64_t(1) << idx);
+                }
+            }
+        }
+
+        filter(due_);
+        std::make_heap(due_.begin(), due_.end(), std::greater<Entry>());
+        return out;
+    }
+
+    bool TimerWheel::contains(const Predicate& pred) const {
+        for (unsigned k = 0; k < kLevelCount; ++k) {
+            for (auto bits = occupied_[k]; bits; bits &= bits - 1) {
+                for (auto& e : slots_[k][lowestBit(bits)]) {
+                    if (pred(*e.msg)) {
+                        return true;
+                    }
+                }
+            }
+        }
+        for (auto& e : due_) {
+            if (pred(*e.msg)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    uint64_t TimerWheel::getTickNs() const {
+        return tick_ns_;
+    }
+
+    void TimerWheel::place(const Entry& e) {
+        uint64_t tick = e.time_ns / tick_ns_;
+        if (tick < cur_tick_) {
+            pushDue(e);
+            return;
+        }
+
+        // 放在 tick 与当前位置最高的不同位所在的层，
+        // 这样除第 0 层外，各层中消息的槽位置总是严格大于当前位置在该层的槽位置。
+        uint64_t diff = tick ^ cur_tick_;
+        unsigned level = diff < kSlotCount ? 0 : highestBit(diff) / kSlotBits;
+        unsigned idx = unsigned(tick >> (level * kSlotBits)) & (kSlotCount - 1);
+
+        slots_[level][idx].push_back(e);
+        occupied_[level] |= uint64_t(1) << idx;
+    }
+
+    void TimerWheel::pushDue(const Entry& e) {
+        due_.push_back(e);
+        std::push_heap(due_.begin(), due_.end(), std::greater<Entry>());
+    }
+
+    void TimerWheel::settle() {
+        while (due_.empty() && size_ > 0) {
+            // 找到最早的非空槽，第 0 层包括当前槽，其他层从当前槽的下一个开始。
+            unsigned level = 0;
+            unsigned idx = 0;
+            for (; level < kLevelCount; ++level) {
+                unsigned shift = level * kSlotBits;
+                unsigned cur_idx = unsigned(cur_tick_ >> shift) & (kSlotCount - 1);
+                unsigned from = level == 0 ? cur_idx : cur_idx + 1;
+                if (from >= kSlotCount) {
+                    continue;
+                }
+
+                uint64_t mask = occupied_[level] & (~uint64_t(0) << from);
+                if (mask) {
+                    idx = lowestBit(mask);
+                    break;
+                }
+            }
+
+            if (level == kLevelCount) {
+                ubassert(false);
+                return;
+            }
+
+            unsigned shift = level * kSlotBits;
+            unsigned high_shift = shift + kSlotBits;
+            uint64_t start = high_shift >= 64 ? 0 : (cur_tick_ >> high_shift) << high_shift;
+            start |= uint64_t(idx) << shift;
+
+            // 与 scratch_ 交换而不是移出，这样槽和 scratch_ 的内存都能被重复使用。
+            scratch_.swap(slots_[level][idx]);
+            occupied_[level] &= ~(uint64_t(1) << idx);
+
+            if (level == 0) {
+                cur_tick_ = start + 1;
+                for (auto& e : scratch_) {
+                    pushDue(e);
+                }
+            } else {
+                cur_tick_ = start;
+                for (auto& e : scratch_) {
+                    place(e);
+                }
+            }
+            scratch_.clear();
+
+            // 当前位置进入了新的槽，该槽中的消息需要向下展开，以维持上面的不变式。
+            for (unsigned k = kLevelCount; k-- > 1; ) {
+                unsigned cur_idx = unsigned(cur_tick_ >> (k * kSlotBits)) & (kSlotCount - 1);
+                if (!(occupied_[k] & (uint64_t(1) << cur_idx))) {
+                    continue;
+                }
+
+                scratch_.swap(slots_[k][cur_idx]);
+                occupied_[k] &= ~(uint64_t(1) << cur_idx);
+                for (auto& e : scratch_) {
+                    place(e);
+                }
+                scratch_.clear();
+            }
+        }
+    }
+
+}
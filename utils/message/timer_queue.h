@@ -0,0 +1,182 @@
+// Copyright (c) 2016 ucclkp <ucclkp@gmail.com>.
+// This file is part of utils project.
+//
+// This program is licensed under GPLv3 license that can be
+// found in the LICENSE file.
+
+#ifndef UTILS_MESSAGE_TIMER_QUEUE_H_
+#define UTILS_MESSAGE_TIMER_QUEUE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+
+namespace utl {
+
+    class Message;
+
+    /**
+     * 延时消息的存储结构。
+     * 按 Message::time_ns 从小到大取出消息，时间相同的消息按放入的先后顺序取出。
+     * 该类本身不是线程安全的，由 MessageQueue 持锁调用。
+     */
+    class TimerQueue {
+    public:
+        using Predicate = std::function<bool(const Message&)>;
+
+        virtual ~TimerQueue() = default;
+
+        virtual void push(Message* msg) = 0;
+
+        /**
+         * 获取最早到期的消息。
+         * @return 如果为空，返回 nullptr。
+         */
+        virtual Message* top() = 0;
+        virtual void pop() = 0;
+
+        virtual bool empty() const = 0;
+        virtual size_t size() const = 0;
+
+        /**
+         * 取出所有满足条件的消息。
+         * @return 由 Message::next 串起来的消息链表，没有则返回 nullptr。
+         */
+        virtual Message* extract(const Predicate& pred) = 0;
+        virtual bool contains(const Predicate& pred) const = 0;
+    };
+
+
+    /**
+     * 有序单链表。插入为 O(n)，仅用于对比。
+     */
+    class TimerList : public TimerQueue {
+    public:
+        TimerList() = default;
+        ~TimerList();
+
+        void push(Message* msg) override;
+        Message* top() override;
+        void pop() override;
+
+        bool empty() const override;
+        size_t size() const override;
+
+        Message* extract(const Predicate& pred) override;
+        bool contains(const Predicate& pred) const override;
+
+    private:
+        Message* head_ = nullptr;
+        size_t size_ = 0;
+    };
+
+
+    /**
+     * d 叉最小堆。插入和取出为 O(log n)，查看堆顶为 O(1)。
+     */
+    template <size_t Arity>
+    class TimerHeap : public TimerQueue {
+    public:
+        static_assert(Arity >= 2, "Arity must be at least 2");
+
+        TimerHeap() = default;
+        ~TimerHeap();
+
+        void push(Message* msg) override;
+        Message* top() override;
+        void pop() override;
+
+        bool empty() const override;
+        size_t size() const override;
+
+        Message* extract(const Predicate& pred) override;
+        bool contains(const Predicate& pred) const override;
+
+    private:
+        struct Entry {
+            uint64_t time_ns;
+            uint64_t seq;
+            Message* msg;
+
+            bool operator<(const Entry& rhs) const {
+                return time_ns < rhs.time_ns ||
+                    (time_ns == rhs.time_ns && seq < rhs.seq);
+            }
+        };
+
+        void siftUp(size_t i);
+        void siftDown(size_t i);
+
+        uint64_t seq_ = 0;
+        std::vector<Entry> heap_;
+    };
+
+    using TimerBinaryHeap = TimerHeap<2>;
+    using TimerQuaternaryHeap = TimerHeap<4>;
+
+
+    /**
+     * 分层时间轮。
+     * 每层 64 个槽，槽位置由到期时刻换算成的 tick 决定，插入为 O(1)。
+     * 最早的非空槽只有在需要时才会逐层向下展开，展开到最底层的槽会被并入
+     * 一个按精确时间排序的小堆，因此 tick 只影响分桶粒度，不影响消息的取出顺序。
+     */
+    class TimerWheel : public TimerQueue {
+    public:
+        /**
+         * @param tick_ns 时间轮一格的长度，单位为纳秒，必须大于 0。
+         */
+        explicit TimerWheel(uint64_t tick_ns = 1000000);
+        ~TimerWheel();
+
+        void push(Message* msg) override;
+        Message* top() override;
+        void pop() override;
+
+        bool empty() const override;
+        size_t size() const override;
+
+        Message* extract(const Predicate& pred) override;
+        bool contains(const Predicate& pred) const override;
+
+        uint64_t getTickNs() const;
+
+    private:
+        struct Entry {
+            uint64_t time_ns;
+            uint64_t seq;
+            Message* msg;
+
+            bool operator>(const Entry& rhs) const {
+                return time_ns > rhs.time_ns ||
+                    (time_ns == rhs.time_ns && seq > rhs.seq);
+            }
+        };
+
+        static constexpr unsigned kSlotBits = 6;
+        static constexpr unsigned kSlotCount = 1u << kSlotBits;
+        // 11 层共 66 位，足以覆盖任意 64 位的 tick，不需要溢出链表。
+        static constexpr unsigned kLevelCount = 11;
+
+        void place(const Entry& e);
+        void pushDue(const Entry& e);
+        void settle();
+
+        uint64_t tick_ns_;
+        uint64_t cur_tick_ = 0;
+        uint64_t seq_ = 0;
+        size_t size_ = 0;
+
+        uint64_t occupied_[kLevelCount] = {};
+        std::vector<Entry> slots_[kLevelCount][kSlotCount];
+
+        // tick 小于 cur_tick_ 的消息，按精确时间组成最小堆。
+        std::vector<Entry> due_;
+        std::vector<Entry> scratch_;
+    };
+
+}
+
+#endif  // UTILS_MESSAGE_TIMER_QUEUE_H_
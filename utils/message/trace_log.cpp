@@ -0,0 +1,326 @@
+// Copyright (c) 2016 ucclkp <ucclkp@gmail.com>.
+// This file is part of utils project.
+//
+// This program is licensed under GPLv3 license that can be
+// found in the LICENSE file.
+
+#include "utils/message/trace_log.h"
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+#include "utils/time_utils.h"
+
+
+namespace {
+
+    void writeString(std::ostream& s, const char* str) {
+        s << '"';
+        for (auto p = str; *p; ++p) {
+            auto c = *p;
+            if (c == '"' || c == '\\') {
+                s << '\\' << c;
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                static const char kHex[] = "0123456789abcdef";
+                s << "\\u00" << kHex[(c >> 4) & 0xF] << kHex[c & 0xF];
+            } else {
+                s << c;
+            }
+        }
+        s << '"';
+    }
+
+    void writeTimestamp(std::ostream& s, int64_t ts_ns) {
+        // Chrome trace 的时间单位为微秒，保留到纳秒，避免使用浮点数。
+        auto frac = int(ts_ns % 1000);
+        s << ts_ns / 1000 << '.'
+          << char('0' + frac / 100) << char('0' + frac / 10 % 10) << char('0' + frac % 10);
+    }
+
+}
+
+namespace utl {
+
+    /**
+     * 单个线程的事件环形缓冲区，只有所属线程写入。
+     * 每个槽位带有序号，导出线程据此判断读到的事件是否完整（seqlock），
+     * 因此写入时只需要几次普通的存储，不需要原子的读-改-写操作。
+     */
+    class TraceLog::Buffer {
+    public:
+        struct Event {
+            int64_t ts_ns;
+            uint64_t flow_id;
+            const char* file;
+            const char* function;
+            int line;
+            int id;
+            char phase;
+        };
+
+        Buffer(int tid, size_t capacity)
+            : tid_(tid),
+              capacity_(capacity),
+              slots_(new Slot[capacity]),
+              pos_(0) {}
+
+        ~Buffer() {
+            delete[] slots_;
+        }
+
+        /**
+         * 以新的容量重新分配，丢弃所有事件。只能在没有线程写入时调用。
+         */
+        void resize(size_t capacity) {
+            delete[] slots_;
+            capacity_ = capacity;
+            slots_ = new Slot[capacity];
+            pos_.store(0, std::memory_order_relaxed);
+        }
+
+        void add(const Event& e) {
+            auto pos = pos_.load(std::memory_order_relaxed);
+            auto& slot = slots_[pos % capacity_];
+
+            slot.seq.store(0, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            slot.ts_ns.store(e.ts_ns, std::memory_order_relaxed);
+            slot.flow_id.store(e.flow_id, std::memory_order_relaxed);
+            slot.file.store(e.file, std::memory_order_relaxed);
+            slot.function.store(e.function, std::memory_order_relaxed);
+            slot.line.store(e.line, std::memory_order_relaxed);
+            slot.id.store(e.id, std::memory_order_relaxed);
+            slot.phase.store(e.phase, std::memory_order_relaxed);
+            slot.seq.store(pos + 1, std::memory_order_release);
+
+            pos_.store(pos + 1, std::memory_order_release);
+        }
+
+        /**
+         * 按记录顺序取出缓冲区中完整的事件。
+         */
+        void collect(std::vector<Event>* out) const {
+            auto end = pos_.load(std::memory_order_acquire);
+            auto begin = end > capacity_ ? end - capacity_ : 0;
+            for (auto pos = begin; pos < end; ++pos) {
+                auto& slot = slots_[pos % capacity_];
+                if (slot.seq.load(std::memory_order_acquire) != pos + 1) {
+                    continue;
+                }
+
+                Event e;
+                e.ts_ns = slot.ts_ns.load(std::memory_order_relaxed);
+                e.flow_id = slot.flow_id.load(std::memory_order_relaxed);
+                e.file = slot.file.load(std::memory_order_relaxed);
+                e.function = slot.function.load(std::memory_order_relaxed);
+                e.line = slot.line.load(std::memory_order_relaxed);
+                e.id = slot.id.load(std::memory_order_relaxed);
+                e.phase = slot.phase.load(std::memory_order_relaxed);
+
+                // 读取期间被覆盖的事件不完整，丢弃
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (slot.seq.load(std::memory_order_relaxed) == pos + 1) {
+                    out->push_back(e);
+                }
+            }
+        }
+
+        int getTid() const { return tid_; }
+        size_t getCapacity() const { return capacity_; }
+
+    private:
+        struct Slot {
+            // 为 0 时表示正在写入，否则为写入位置加 1
+            std::atomic<uint64_t> seq{ 0 };
+            std::atomic<int64_t> ts_ns{ 0 };
+            std::atomic<uint64_t> flow_id{ 0 };
+            std::atomic<const char*> file{ nullptr };
+            std::atomic<const char*> function{ nullptr };
+            std::atomic<int> line{ 0 };
+            std::atomic<int> id{ 0 };
+            std::atomic<char> phase{ 0 };
+        };
+
+        int tid_;
+        size_t capacity_;
+        Slot* slots_;
+        std::atomic<uint64_t> pos_;
+    };
+
+
+    struct TraceLog::Registry {
+        Buffer* acquire() {
+            auto cap = capacity.load(std::memory_order_relaxed);
+
+            std::lock_guard<std::mutex> lk(sync);
+            if (!free_buffers.empty()) {
+                auto buf = free_buffers.back();
+                free_buffers.pop_back();
+                if (buf->getCapacity() != cap) {
+                    buf->resize(cap);
+                }
+                return buf;
+            }
+
+            auto buf = new Buffer(int(buffers.size()) + 1, cap);
+            buffers.push_back(buf);
+            return buf;
+        }
+
+        void release(Buffer* buf) {
+            std::lock_guard<std::mutex> lk(sync);
+            free_buffers.push_back(buf);
+        }
+
+        // 分配过的所有缓冲区，tid 与之一一对应，复用时不变
+        std::vector<Buffer*> buffers;
+        // 所属线程已退出，等待复用的缓冲区
+        std::vector<Buffer*> free_buffers;
+        std::atomic<size_t> capacity{ kDefaultBufferCapacity };
+        std::atomic<uint64_t> next_flow_id{ 1 };
+        // clear() 的时间，之前的事件不再导出
+        std::atomic<int64_t> cleared_ns{ 0 };
+        std::mutex sync;
+    };
+
+
+    /**
+     * 当前线程持有的缓冲区，线程退出时交还给 Registry。
+     */
+    struct TraceLog::ThreadBuffer {
+        ~ThreadBuffer() {
+            if (buffer) {
+                getRegistry().release(buffer);
+            }
+            released = true;
+        }
+
+        Buffer* buffer = nullptr;
+
+        // 为 true 时本线程的 ThreadBuffer 已析构，之后的事件直接丢弃。
+        // 平凡类型的 thread_local 没有析构，在线程退出的过程中仍可访问。
+        static thread_local bool released;
+    };
+
+    thread_local bool TraceLog::ThreadBuffer::released = false;
+
+
+    std::atomic<bool> TraceLog::enabled_{ false };
+
+    // static
+    TraceLog::Registry& TraceLog::getRegistry() {
+        // 有意不析构：分离的线程可能在静态对象析构之后仍在记录，缓冲区必须一直有效。
+        static auto registry = new Registry();
+        return *registry;
+    }
+
+    // static
+    void TraceLog::setEnabled(bool enabled) {
+        enabled_.store(enabled, std::memory_order_relaxed);
+    }
+
+    // static
+    void TraceLog::setBufferCapacity(size_t capacity) {
+        getRegistry().capacity.store(std::max(capacity, size_t(1)), std::memory_order_relaxed);
+    }
+
+    // static
+    uint64_t TraceLog::newFlowId() {
+        return getRegistry().next_flow_id.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // static
+    TraceLog::Buffer* TraceLog::getBuffer() {
+        if (ThreadBuffer::released) {
+            return nullptr;
+        }
+
+        static thread_local ThreadBuffer owner;
+        if (!owner.buffer) {
+            owner.buffer = getRegistry().acquire();
+        }
+        return owner.buffer;
+    }
+
+    // static
+    void TraceLog::addEvent(
+        Phase phase, const Location& loc, uint64_t flow_id, int id, int64_t ts_ns)
+    {
+        Buffer::Event e;
+        e.ts_ns = ts_ns;
+        e.flow_id = flow_id;
+        e.file = loc.getFile();
+        e.function = loc.getFunction();
+        e.line = loc.getLine();
+        e.id = id;
+        e.phase = phase;
+
+        auto buffer = getBuffer();
+        if (buffer) {
+            buffer->add(e);
+        }
+    }
+
+    // static
+    void TraceLog::exportJSON(std::ostream& s) {
+        auto& reg = getRegistry();
+        auto cleared = reg.cleared_ns.load(std::memory_order_relaxed);
+
+        s << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+
+        bool first = true;
+        std::vector<Buffer::Event> events;
+        std::lock_guard<std::mutex> lk(reg.sync);
+        for (auto buf : reg.buffers) {
+            events.clear();
+            buf->collect(&events);
+
+            int tid = buf->getTid();
+            for (const auto& e : events) {
+                if (e.ts_ns < cleared) {
+                    continue;
+                }
+
+                s << (first ? "\n" : ",\n");
+                first = false;
+
+                s << "{\"ph\":\"" << e.phase << "\",\"pid\":1,\"tid\":" << tid << ",\"ts\":";
+                writeTimestamp(s, e.ts_ns);
+
+                switch (e.phase) {
+                case PH_BEGIN:
+                    s << ",\"cat\":\"message\",\"name\":";
+                    writeString(s, *e.function ? e.function : "Message");
+                    s << ",\"args\":{\"file\":";
+                    writeString(s, e.file);
+                    s << ",\"line\":" << e.line << ",\"id\":" << e.id << '}';
+                    break;
+                case PH_FLOW_START:
+                    s << ",\"cat\":\"message\",\"name\":\"post\",\"id\":" << e.flow_id;
+                    break;
+                default:
+                    break;
+                }
+                s << '}';
+
+                if (e.phase == PH_BEGIN && e.flow_id != 0) {
+                    // 流的终点绑定到本次执行上
+                    s << ",\n{\"ph\":\"f\",\"bp\":\"e\",\"pid\":1,\"tid\":" << tid << ",\"ts\":";
+                    writeTimestamp(s, e.ts_ns);
+                    s << ",\"cat\":\"message\",\"name\":\"post\",\"id\":" << e.flow_id << '}';
+                }
+            }
+        }
+
+        s << "\n]}\n";
+    }
+
+    // static
+    void TraceLog::clear() {
+        // 缓冲区只能由所属线程写入，这里只记下时间，导出时跳过之前的事件。
+        getRegistry().cleared_ns.store(
+            TimeUtils::upTime().count() + 1, std::memory_order_relaxed);
+    }
+
+}
@@ -0,0 +1,93 @@
+// Copyright (c) 2016 ucclkp <ucclkp@gmail.com>.
+// This file is part of utils project.
+//
+// This program is licensed under GPLv3 license that can be
+// found in the LICENSE file.
+
+#ifndef UTILS_MESSAGE_TRACE_LOG_H_
+#define UTILS_MESSAGE_TRACE_LOG_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+#include "utils/message/location.hpp"
+
+
+namespace utl {
+
+    /**
+     * 消息的跟踪记录。
+     * 开启后，Cycler 投递消息时记录投递位置并分配一个流 id，MessagePump 执行消息时记录开始和结束。
+     * 每个线程将事件写入自己的环形缓冲区，写满后覆盖最旧的事件，记录时不需要持锁也不需要分配内存。
+     * 记录的事件可以导出为 Chrome 的 trace 格式（chrome://tracing 或 Perfetto），
+     * 通过流 id 将投递和执行连接起来，用于分析跨泵的延迟。
+     */
+    class TraceLog {
+    public:
+        /**
+         * 事件类型，取值与 Chrome trace 格式相同。
+         * 带有流 id 的 PH_BEGIN 在导出时同时作为该流的终点。
+         */
+        enum Phase : char {
+            PH_BEGIN      = 'B',
+            PH_END        = 'E',
+            PH_FLOW_START = 's',
+        };
+
+        /**
+         * 开启或关闭记录，可以在任意线程中调用。默认关闭。
+         */
+        static void setEnabled(bool enabled);
+
+        static bool isEnabled() {
+            return enabled_.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * 设置每个线程的缓冲区能容纳的事件数量，只影响之后才开始记录的线程。
+         * 缓冲区在线程第一次记录时获取，线程退出后交还，其事件仍可导出，直到被之后开始记录的线程复用。
+         * 因此缓冲区的数量不超过同时在记录的线程数，线程频繁创建和退出时也不会增长。
+         */
+        static void setBufferCapacity(size_t capacity);
+
+        static uint64_t newFlowId();
+
+        /**
+         * 在当前线程的缓冲区中记录一个事件。
+         * @param loc 投递位置，其函数名用作事件的名称。
+         * @param flow_id 为 0 时不关联流。
+         * @param id Message::id
+         * @param ts_ns 时间戳，与 Cycler::now() 相同，即 TimeUtils::upTime()。
+         */
+        static void addEvent(
+            Phase phase, const Location& loc, uint64_t flow_id, int id, int64_t ts_ns);
+
+        /**
+         * 以 Chrome trace 的 JSON 格式导出所有线程缓冲区中的事件。
+         * 可以在记录的同时调用，正被写入的事件会被跳过。
+         */
+        static void exportJSON(std::ostream& s);
+
+        /**
+         * 丢弃此前记录的所有事件。
+         */
+        static void clear();
+
+        static constexpr size_t kDefaultBufferCapacity = 4096;
+
+    private:
+        class Buffer;
+        struct Registry;
+        struct ThreadBuffer;
+
+        static Buffer* getBuffer();
+        static Registry& getRegistry();
+
+        static std::atomic<bool> enabled_;
+    };
+
+}
+
+#endif  // UTILS_MESSAGE_TRACE_LOG_H_
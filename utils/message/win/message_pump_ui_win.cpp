@@ -136,6 +136,10 @@ namespace win {
                 break;
             }
 
+            if (cosumeIdle(delay_ns)) {
+                continue;
+            }
+
             wait(delay_ns);
         }
     }
@@ -280,9 +284,7 @@ namespace win {
             }
 
             if (should_process) {
-                int64_t delay_ns;
                 This->cosume();
-                This->cosumeDelayed(&delay_ns);
             }
         }
 
@@ -52,6 +52,10 @@ namespace win {
                 break;
             }
 
+            if (cosumeIdle(delay_ns)) {
+                continue;
+            }
+
             wait(delay_ns);
         }
     }
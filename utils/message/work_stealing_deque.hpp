@@ -0,0 +1,178 @@
+// Copyright (c) 2016 ucclkp <ucclkp@gmail.com>.
+// This file is part of utils project.
+//
+// This program is licensed under GPLv3 license that can be
+// found in the LICENSE file.
+
+#ifndef UTILS_MESSAGE_WORK_STEALING_DEQUE_HPP_
+#define UTILS_MESSAGE_WORK_STEALING_DEQUE_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+
+namespace utl {
+
+    /**
+     * Chase-Lev 工作窃取双端队列。
+     * 只有所有者线程可以调用 push() 和 take()，在底部后进先出地存取；
+     * 其他线程通过 steal() 从顶部先进先出地窃取。
+     * 容量不足时自动翻倍，旧的数组保留到队列析构，以免窃取者读到已释放的内存。
+     * 内存序参照 Lê 等人的 "Correct and Efficient Work-Stealing for Weak Memory Models"。
+     */
+    template <typename Ty>
+    class WorkStealingDeque {
+    public:
+        static_assert(std::is_trivially_copyable<Ty>::value, "Ty must be trivially copyable");
+
+        explicit WorkStealingDeque(size_t capacity = 256)
+            : top_(0),
+              bottom_(0)
+        {
+            size_t cap = 2;
+            while (cap < capacity) {
+                cap <<= 1;
+            }
+            auto arr = new Array(cap);
+            arrays_.push_back(arr);
+            array_.store(arr, std::memory_order_relaxed);
+        }
+
+        ~WorkStealingDeque() {
+            for (auto arr : arrays_) {
+                delete arr;
+            }
+        }
+
+        WorkStealingDeque(const WorkStealingDeque&) = delete;
+        WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+        /**
+         * 仅所有者线程可以调用。
+         */
+        void push(Ty val) {
+            auto b = bottom_.load(std::memory_order_relaxed);
+            auto t = top_.load(std::memory_order_acquire);
+            auto arr = array_.load(std::memory_order_relaxed);
+            if (b - t > int64_t(arr->capacity) - 1) {
+                arr = grow(arr, t, b);
+            }
+            arr->put(b, val);
+            // 论文中为 release 栅栏加 relaxed 写入，这里直接用 release 写入，效果相同。
+            bottom_.store(b + 1, std::memory_order_release);
+        }
+
+        /**
+         * 仅所有者线程可以调用。
+         * @return 如果队列为空，返回 false。
+         */
+        bool take(Ty* out) {
+            auto b = bottom_.load(std::memory_order_relaxed) - 1;
+            auto arr = array_.load(std::memory_order_relaxed);
+            bottom_.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            auto t = top_.load(std::memory_order_relaxed);
+
+            if (t > b) {
+                // 队列为空
+                bottom_.store(b + 1, std::memory_order_relaxed);
+                return false;
+            }
+
+            *out = arr->get(b);
+            if (t == b) {
+                // 最后一个元素，与窃取者竞争
+                bool won = top_.compare_exchange_strong(
+                    t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+                bottom_.store(b + 1, std::memory_order_relaxed);
+                return won;
+            }
+            return true;
+        }
+
+        /**
+         * 可以在任意线程中调用。
+         * @return 如果队列为空，或与其他线程竞争失败，返回 false。
+         */
+        bool steal(Ty* out) {
+            auto t = top_.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            auto b = bottom_.load(std::memory_order_acquire);
+            if (t >= b) {
+                return false;
+            }
+
+            auto arr = array_.load(std::memory_order_acquire);
+            auto val = arr->get(t);
+            if (!top_.compare_exchange_strong(
+                t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            {
+                return false;
+            }
+
+            *out = val;
+            return true;
+        }
+
+        /**
+         * 元素数量的近似值，在其他线程中调用时仅作参考。
+         */
+        size_t size() const {
+            auto b = bottom_.load(std::memory_order_relaxed);
+            auto t = top_.load(std::memory_order_relaxed);
+            return b > t ? size_t(b - t) : 0;
+        }
+
+        bool empty() const {
+            return size() == 0;
+        }
+
+    private:
+        struct Array {
+            explicit Array(size_t cap)
+                : capacity(cap),
+                  mask(cap - 1),
+                  buffer(new std::atomic<Ty>[cap]) {}
+
+            ~Array() {
+                delete[] buffer;
+            }
+
+            Ty get(int64_t i) const {
+                return buffer[size_t(i) & mask].load(std::memory_order_relaxed);
+            }
+
+            void put(int64_t i, Ty val) {
+                buffer[size_t(i) & mask].store(val, std::memory_order_relaxed);
+            }
+
+            size_t capacity;
+            size_t mask;
+            std::atomic<Ty>* buffer;
+        };
+
+        Array* grow(Array* old, int64_t t, int64_t b) {
+            auto arr = new Array(old->capacity * 2);
+            for (auto i = t; i < b; ++i) {
+                arr->put(i, old->get(i));
+            }
+            arrays_.push_back(arr);
+            array_.store(arr, std::memory_order_release);
+            return arr;
+        }
+
+        // top_ 与 bottom_ 分别由窃取者和所有者频繁写入，分开放置以免伪共享。
+        alignas(64) std::atomic<int64_t> top_;
+        alignas(64) std::atomic<int64_t> bottom_;
+        alignas(64) std::atomic<Array*> array_;
+
+        // 仅所有者线程访问
+        std::vector<Array*> arrays_;
+    };
+
+}
+
+#endif  // UTILS_MESSAGE_WORK_STEALING_DEQUE_HPP_
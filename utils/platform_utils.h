@@ -16,6 +16,8 @@
 #define OS_WINDOWS
 #elif defined(__APPLE__)
 #define OS_MAC
+#elif defined(__linux__)
+#define OS_LINUX
 #else
 #define OS_UNKNOWN
 #endif
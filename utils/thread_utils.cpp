@@ -0,0 +1,197 @@
+// Copyright (c) 2016 ucclkp <ucclkp@gmail.com>.
+// This file is part of utils project.
+//
+// This program is licensed under GPLv3 license that can be
+// found in the LICENSE file.
+
+#include "thread_utils.h"
+
+#include "utils/log.h"
+#include "utils/platform_utils.h"
+
+#ifdef OS_WINDOWS
+#include "utils/strings/utfccpp.h"
+#elif defined(OS_LINUX)
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#elif defined(OS_MAC)
+#include <pthread.h>
+#endif
+
+
+namespace {
+
+#ifdef OS_LINUX
+    // 解析 sysfs 中形如 "0-3,8,10-11" 的 CPU 列表。
+    std::vector<int> parseCpuList(const std::string& list) {
+        std::vector<int> cpus;
+        const char* p = list.c_str();
+        while (*p) {
+            char* end;
+            long first = std::strtol(p, &end, 10);
+            if (end == p) {
+                break;
+            }
+            long last = first;
+            p = end;
+            if (*p == '-') {
+                last = std::strtol(p + 1, &end, 10);
+                p = end;
+            }
+            for (long i = first; i <= last; ++i) {
+                cpus.push_back(int(i));
+            }
+            if (*p != ',') {
+                break;
+            }
+            ++p;
+        }
+        return cpus;
+    }
+#endif
+
+}
+
+namespace utl {
+
+    // static
+    bool ThreadUtils::setCurrentThreadName(const std::string& name) {
+#ifdef OS_WINDOWS
+        std::wstring wname;
+        if (utf8_to_wchar(name, &wname, UTFCF_IGN) != 0) {
+            return false;
+        }
+        return SUCCEEDED(::SetThreadDescription(::GetCurrentThread(), wname.c_str()));
+#elif defined(OS_LINUX)
+        // 包括结尾的 0 在内最多 16 个字节，超出时 pthread_setname_np() 会直接失败。
+        return ::pthread_setname_np(::pthread_self(), name.substr(0, 15).c_str()) == 0;
+#elif defined(OS_MAC)
+        return ::pthread_setname_np(name.c_str()) == 0;
+#else
+        return false;
+#endif
+    }
+
+    // static
+    bool ThreadUtils::setCurrentThreadAffinity(const std::vector<int>& cpus) {
+        if (cpus.empty()) {
+            return false;
+        }
+
+#ifdef OS_WINDOWS
+        DWORD_PTR mask = 0;
+        for (int cpu : cpus) {
+            if (cpu < 0 || cpu >= int(sizeof(DWORD_PTR) * 8)) {
+                return false;
+            }
+            mask |= DWORD_PTR(1) << cpu;
+        }
+        return ::SetThreadAffinityMask(::GetCurrentThread(), mask) != 0;
+#elif defined(OS_LINUX)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : cpus) {
+            if (cpu < 0 || cpu >= CPU_SETSIZE) {
+                return false;
+            }
+            CPU_SET(cpu, &set);
+        }
+        return ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set) == 0;
+#else
+        return false;
+#endif
+    }
+
+    // static
+    bool ThreadUtils::applyToCurrentThread(const ThreadOptions& options) {
+        bool succeeded = true;
+        if (!options.cpus.empty() && !setCurrentThreadAffinity(options.cpus)) {
+            LOG(Log::WARNING) << "Cannot set affinity of thread \"" << options.name << "\"";
+            succeeded = false;
+        }
+        if (!options.name.empty() && !setCurrentThreadName(options.name)) {
+            LOG(Log::WARNING) << "Cannot set name of thread \"" << options.name << "\"";
+            succeeded = false;
+        }
+        return succeeded;
+    }
+
+    // static
+    int ThreadUtils::getCurrentCpu() {
+#ifdef OS_WINDOWS
+        return int(::GetCurrentProcessorNumber());
+#elif defined(OS_LINUX)
+        return ::sched_getcpu();
+#else
+        return -1;
+#endif
+    }
+
+    // static
+    int ThreadUtils::getNodeOfCpu(int cpu) {
+        if (cpu < 0) {
+            return -1;
+        }
+
+#ifdef OS_WINDOWS
+        UCHAR node;
+        if (cpu > 0xFF || !::GetNumaProcessorNode(UCHAR(cpu), &node) || node == 0xFF) {
+            return -1;
+        }
+        return node;
+#elif defined(OS_LINUX)
+        // CPU 的 sysfs 目录下有一个指向所在节点的 nodeN 链接。
+        auto path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+        auto dir = ::opendir(path.c_str());
+        if (!dir) {
+            return -1;
+        }
+
+        int node = -1;
+        while (auto entry = ::readdir(dir)) {
+            int n;
+            if (std::sscanf(entry->d_name, "node%d", &n) == 1) {
+                node = n;
+                break;
+            }
+        }
+        ::closedir(dir);
+        return node;
+#else
+        return -1;
+#endif
+    }
+
+    // static
+    std::vector<int> ThreadUtils::getCpusOfNode(int node) {
+        std::vector<int> cpus;
+        if (node < 0) {
+            return cpus;
+        }
+
+#ifdef OS_WINDOWS
+        ULONGLONG mask;
+        if (node > 0xFF || !::GetNumaNodeProcessorMask(UCHAR(node), &mask)) {
+            return cpus;
+        }
+        for (int i = 0; i < 64; ++i) {
+            if (mask & (ULONGLONG(1) << i)) {
+                cpus.push_back(i);
+            }
+        }
+#elif defined(OS_LINUX)
+        std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        std::string list;
+        if (file && std::getline(file, list)) {
+            cpus = parseCpuList(list);
+        }
+#endif
+        return cpus;
+    }
+
+}
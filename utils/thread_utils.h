@@ -0,0 +1,67 @@
+// Copyright (c) 2016 ucclkp <ucclkp@gmail.com>.
+// This file is part of utils project.
+//
+// This program is licensed under GPLv3 license that can be
+// found in the LICENSE file.
+
+#ifndef UTILS_THREAD_UTILS_H_
+#define UTILS_THREAD_UTILS_H_
+
+#include <string>
+#include <vector>
+
+
+namespace utl {
+
+    /**
+     * 线程的放置选项，在线程开始工作之前应用。
+     */
+    struct ThreadOptions {
+        // 线程名称，便于在调试器和 top -H 等工具中辨认。为空时不设置。
+        // Linux 上最多保留前 15 个字节。
+        std::string name;
+
+        // 允许线程运行的 CPU 编号，为空时不限制。
+        // 可以通过 ThreadUtils::getCpusOfNode() 将线程限制在某个 NUMA 节点上。
+        std::vector<int> cpus;
+    };
+
+    class ThreadUtils {
+    public:
+        /**
+         * 设置当前线程的名称。Mac 和 Linux 上只能设置当前线程。
+         */
+        static bool setCurrentThreadName(const std::string& name);
+
+        /**
+         * 将当前线程限制在 cpus 中的 CPU 上运行。
+         * Mac 不支持绑定，总是返回 false；Windows 上只支持前 64 个 CPU。
+         */
+        static bool setCurrentThreadAffinity(const std::vector<int>& cpus);
+
+        /**
+         * 对当前线程应用 options，失败的项会输出警告，不影响其他项。
+         * 先绑定 CPU 再分配内存，在默认的首次访问策略下，之后分配的内存会位于本地的 NUMA 节点上。
+         * @return 所有的项都成功时返回 true。
+         */
+        static bool applyToCurrentThread(const ThreadOptions& options);
+
+        /**
+         * 当前线程正运行在哪个 CPU 上，不支持时返回 -1。
+         */
+        static int getCurrentCpu();
+
+        /**
+         * CPU 所在的 NUMA 节点，未知时返回 -1。非 NUMA 系统上通常为 0。
+         */
+        static int getNodeOfCpu(int cpu);
+
+        /**
+         * NUMA 节点上的所有 CPU，未知时返回空。
+         */
+        static std::vector<int> getCpusOfNode(int node);
+    };
+
+}
+
+#endif  // UTILS_THREAD_UTILS_H_
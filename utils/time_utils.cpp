@@ -7,13 +7,166 @@
 #include "time_utils.h"
 
 #include <chrono>
+#include <thread>
 
+#include "utils/platform_utils.h"
+
+#ifdef OS_LINUX
+#include <time.h>
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define UTL_HAS_TSC
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+#endif
+
+
+namespace {
+
+#ifdef OS_LINUX
+    int64_t readClock(clockid_t id) {
+        timespec ts;
+        ::clock_gettime(id, &ts);
+        return int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+    }
+#endif
+
+#ifdef UTL_HAS_TSC
+    // CPUID 0x80000007 的 EDX 第 8 位：TSC 频率恒定，不随降频和休眠变化，且各核同步。
+    bool hasInvariantTSC() {
+#ifdef _MSC_VER
+        int regs[4];
+        __cpuid(regs, 0x80000000);
+        if (unsigned(regs[0]) < 0x80000007u) {
+            return false;
+        }
+        __cpuid(regs, 0x80000007);
+        return (regs[3] & (1 << 8)) != 0;
+#else
+        unsigned int eax, ebx, ecx, edx;
+        if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx)) {
+            return false;
+        }
+        return (edx & (1u << 8)) != 0;
+#endif
+    }
+
+    class TSCClock {
+    public:
+        TSCClock() {
+            if (!hasInvariantTSC()) {
+                return;
+            }
+
+            // 在间隔两端各取一个样本，按两者之差换算频率。频率的相对误差约为
+            // 两端样本的误差之和除以间隔，间隔越长越准，但首次调用也要等待这么久。
+            int64_t t0 = 0, t1 = 0;
+            uint64_t c0 = 0, c1 = 0;
+            if (!sample(&t0, &c0)) {
+                return;
+            }
+            std::this_thread::sleep_for(std::chrono::nanoseconds(kCalibrationNs));
+            if (!sample(&t1, &c1) || c1 <= c0 || t1 - t0 < kCalibrationNs) {
+                return;
+            }
+            ns_per_tick_ = double(t1 - t0) / double(c1 - c0);
+            base_ns_ = t1;
+            base_tick_ = c1;
+            enabled_ = true;
+        }
+
+        bool isEnabled() const { return enabled_; }
+
+        int64_t now() const {
+            auto delta = int64_t(__rdtsc() - base_tick_);
+            return base_ns_ + int64_t(double(delta) * ns_per_tick_);
+        }
+
+    private:
+        static constexpr int64_t kCalibrationNs = 20000000;
+        static constexpr int kSampleCount = 16;
+        static constexpr uint64_t kMaxSampleTicks = 2000;
+
+        /**
+         * 读取 upTime() 前后各读一次 TSC，取中点作为与之对应的 TSC，误差不超过两次读取间隔的一半。
+         * 读取期间被抢占或遇到虚拟机退出时，间隔会很大，因此取多次中间隔最小的一个。
+         * 最小的间隔仍超过 kMaxSampleTicks 时，说明 upTime() 本身读取很慢或一直被打断，返回 false。
+         */
+        static bool sample(int64_t* t, uint64_t* tick) {
+            uint64_t best = ~uint64_t(0);
+            for (int i = 0; i < kSampleCount; ++i) {
+                auto before = __rdtsc();
+                auto cur = utl::TimeUtils::upTime().count();
+                auto after = __rdtsc();
+                if (after < before || after - before >= best) {
+                    continue;
+                }
+
+                best = after - before;
+                *t = cur;
+                *tick = before + best / 2;
+            }
+            return best <= kMaxSampleTicks;
+        }
+
+        bool enabled_ = false;
+        double ns_per_tick_ = 0;
+        int64_t base_ns_ = 0;
+        uint64_t base_tick_ = 0;
+    };
+
+    const TSCClock& getTSCClock() {
+        static const TSCClock clock;
+        return clock;
+    }
+#endif
+
+}
 
 namespace utl {
 
     // static
     TimeUtils::ns TimeUtils::upTime() {
-        return std::chrono::high_resolution_clock::now().time_since_epoch();
+#ifdef OS_LINUX
+        return ns(readClock(CLOCK_MONOTONIC));
+#else
+        return std::chrono::duration_cast<ns>(
+            std::chrono::steady_clock::now().time_since_epoch());
+#endif
+    }
+
+    // static
+    TimeUtils::ns TimeUtils::coarseUpTime() {
+#ifdef OS_LINUX
+        return ns(readClock(CLOCK_MONOTONIC_COARSE));
+#else
+        return upTime();
+#endif
+    }
+
+    // static
+    TimeUtils::ns TimeUtils::fastUpTime() {
+#ifdef UTL_HAS_TSC
+        auto& clock = getTSCClock();
+        if (clock.isEnabled()) {
+            return ns(clock.now());
+        }
+#endif
+        return upTime();
+    }
+
+    // static
+    bool TimeUtils::isFastUpTimeTSC() {
+#ifdef UTL_HAS_TSC
+        return getTSCClock().isEnabled();
+#else
+        return false;
+#endif
     }
 
     // static
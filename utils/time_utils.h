@@ -18,8 +18,35 @@ namespace utl {
         using ns = std::chrono::nanoseconds;
         using nsp = const ns&;
 
+        /**
+         * 单调递增的时间，不受系统时间调整的影响，起点不确定，只能用于计算时间差。
+         * Linux 上为 CLOCK_MONOTONIC，其他平台为 std::chrono::steady_clock。
+         */
         static ns upTime();
 
+        /**
+         * 与 upTime() 同一时钟，精度较低但读取更快。
+         * Linux 上为 CLOCK_MONOTONIC_COARSE，精度通常为 1~4ms；其他平台等同于 upTime()。
+         * 适合精度要求不高而调用频繁的场合，例如大量超时的粗略判断。
+         */
+        static ns coarseUpTime();
+
+        /**
+         * 在具有恒定频率 TSC 的 x86-64 处理器上直接读取 TSC 并换算为纳秒，不进入内核；
+         * 其他情况下等同于 upTime()。首次调用时会阻塞约 20ms，与 upTime() 对照校准频率，
+         * 校准时读取过慢或一直被打断（例如在部分虚拟机中）则放弃 TSC。
+         * 起点与 upTime() 相同，但两者的差会随时间单向累积：校准的频率误差通常约为每秒 1µs，
+         * 最坏约为每秒 50µs（运行一小时约 180ms）；此外 upTime() 的频率会被 NTP 微调，
+         * 最多 500ppm（每秒 500µs），TSC 则不会。因此只能用来计算同一时钟的时间差，
+         * 不要与 upTime()、Cycler::now() 等混用，消息系统中也不使用它。
+         */
+        static ns fastUpTime();
+
+        /**
+         * fastUpTime() 是否使用 TSC。
+         */
+        static bool isFastUpTimeTSC();
+
         static uint64_t upTimeMillis();
         static uint64_t upTimeMicros();
         static uint64_t upTimeNanos();